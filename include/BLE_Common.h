@@ -13,6 +13,13 @@
 #include <NimBLEDevice.h>
 #include <Arduino.h>
 #include <Main.h>
+#include <ConnectionManager.h>
+#include <LinkStats.h>
+#include <NotifyFanout.h>
+#include <NotifyScheduler.h>
+#include <PowerTable.h>
+#include <SPSCQueue.h>
+#include <sensors/SensorDataFactory.h>
 
 // macros to convert different types of bytes into int The naming here sucks and
 // should be fixed.
@@ -25,29 +32,78 @@
 // Setup
 void setupBLE();
 extern TaskHandle_t BLECommunicationTask;
+extern TaskHandle_t BLESensorProcessingTask;
 // ***********************Common**********************************
 void BLECommunications(void *pvParameters);
+// Drains spinBLEClient.notifyQueue and applies each packet as it arrives.
+void BLESensorProcessing(void *pvParameters);
+// Record every sensor notification to SENSOR_TRACE_FILENAME. See SensorTrace.h for the format.
+void startSensorTrace();
+void stopSensorTrace();
+bool isSensorTraceRecording();
+
+// Ask for the PHY and data length picked by ConnectionManager. Intervals are set by the caller,
+// centrals and peripherals negotiate them differently.
+void requestLinkLayerFeatures(uint16_t connHandle, const ConnectionParameters &parameters);
+
+// Stepper position x cadence -> watts, learned by BLESensorProcessing(). Other tasks read it without locking,
+// cells are updated in place so a lookup is at worst one sample behind.
+extern PowerTable powerTable;
+void loadPowerTable();
 
 // *****************************Server****************************
-extern int bleConnDesc;  // These all need re
-extern bool updateConnParametersFlag;
+
+// Outbound characteristics, as NotifyScheduler channels.
+struct ServerNotifyChannels {
+  enum Types : uint8_t { IndoorBikeData = 0, CyclingPowerMeasurement = 1, HeartRateMeasurement = 2 };
+};
+// Paces the outbound characteristics. Sent by BLECommunications().
+extern NotifyScheduler notifyScheduler;
+// Flag outbound characteristics as stale and wake BLECommunications() to send them.
+void notifyServerDataChanged(uint8_t channels);
 
 void startBLEServer();
-void computeERG(int, int);
-void computeCSC();
+// Pass a crank event of the upstream power meter through to our Cycling Power Measurement. Called by BLESensorProcessing().
+void passUpstreamCrankEvent(uint16_t revolutions, uint16_t time, uint32_t timestamp);
 void updateIndoorBikeDataChar();
 void updateCyclingPowerMesurementChar();
 void calculateInstPwrFromHR();
 void updateHeartRateMeasurementChar();
 int connectedClientCount();
+// Track new and lost clients and negotiate the links of new ones. Called by BLECommunications().
+void updateServerConnections();
+// Notification delivery to each client of our server, as JSON.
+String returnClientStatsJSON();
 
 class MyServerCallbacks : public BLEServerCallbacks {
   void onConnect(BLEServer *, ble_gap_conn_desc *desc);
-  void onDisconnect(BLEServer *);
+  void onDisconnect(BLEServer *, ble_gap_conn_desc *desc);
+};
+
+// Tracks which clients subscribed to an outbound characteristic.
+class MeasurementCallbacks : public BLECharacteristicCallbacks {
+ public:
+  explicit MeasurementCallbacks(uint8_t channel) : channel(channel) {}
+  void onSubscribe(BLECharacteristic *, ble_gap_conn_desc *desc, uint16_t subValue);
+
+ private:
+  uint8_t channel;  // ServerNotifyChannels
 };
 
+// Applies the FTMS control point writes queued by MyCallbacks.
+extern TaskHandle_t FTMSControlPointTask;
+void ftmsControlPointWorker(void *pvParameters);
+
+// Holds the ERG target from the control point, at ERG_UPDATE_RATE while ERG mode is on. Also applies grades,
+// which end ERG mode.
+extern TaskHandle_t ERGControllerTask;
+void ergControllerWorker(void *pvParameters);
+// Target tracking of the ERG controller, as JSON.
+String returnERGStatsJSON();
+
 class MyCallbacks : public BLECharacteristicCallbacks {
-  void onWrite(BLECharacteristic *);
+  void onWrite(BLECharacteristic *, ble_gap_conn_desc *desc);
+  void onStatus(BLECharacteristic *, Status s, int code);
 };
 
 // *****************************Client*****************************
@@ -75,6 +131,7 @@ class SpinBLEAdvertisedDevice {
   bool userSelectedCSC  = false;
   bool userSelectedCT   = false;
   bool doConnect        = false;
+  uint8_t sensorId      = SensorDataFactory::Types::Unknown;  // Interned charUUID
 
   void set(BLEAdvertisedDevice *device, int id = BLE_HS_CONN_HANDLE_NONE, BLEUUID inserviceUUID = (uint16_t)0x0000, BLEUUID incharUUID = (uint16_t)0x0000) {
     advertisedDevice  = device;
@@ -82,6 +139,7 @@ class SpinBLEAdvertisedDevice {
     connectedClientID = id;
     serviceUUID       = BLEUUID(inserviceUUID);
     charUUID          = BLEUUID(incharUUID);
+    sensorId          = SensorDataFactory::getSensorId(charUUID);
   }
 
   void reset() {
@@ -95,11 +153,25 @@ class SpinBLEAdvertisedDevice {
     userSelectedCSC   = false;  // Cycling Speed/Cadence
     userSelectedCT    = false;  // Controllable Trainer
     doConnect         = false;  // Initiate connection flag
+    sensorId          = SensorDataFactory::Types::Unknown;
   }
 
   void print();
 };
 
+// A raw notification as received from a connected sensor, or word that the sensor disconnected.
+struct NotifyPacket {
+  uint32_t timestamp;  // micros() at arrival
+  uint8_t sensorId;    // SensorDataFactory id of the characteristic
+  int8_t deviceIndex;  // myBLEDevices slot, -1 if the connection isn't registered yet
+  bool disconnected;   // No data, the sensor in deviceIndex went away
+  size_t length;
+  uint8_t data[NOTIFY_DATA_MAX_LENGTH];
+};
+
+// Registered with subscribe() for every sensor characteristic. Runs in the NimBLE host task.
+void notifyCallback(BLERemoteCharacteristic *pBLERemoteCharacteristic, uint8_t *pData, size_t length, bool isNotify);
+
 class SpinBLEClient {
  public:  // Not all of these need to be public. This should be cleaned up
           // later.
@@ -109,14 +181,18 @@ class SpinBLEClient {
   boolean doScan             = false;
   bool intentionalDisconnect = false;
   int noReadingIn            = 0;
-  int cscCumulativeCrankRev  = 0;
-  int cscLastCrankEvtTime    = 0;
 
   BLERemoteCharacteristic *pRemoteCharacteristic = nullptr;
 
   // BLEDevices myBLEDevices;
   SpinBLEAdvertisedDevice myBLEDevices[NUM_BLE_DEVICES];
 
+  // Filled by notifyCallback(), drained by BLESensorProcessing().
+  SPSCQueue<NotifyPacket, NOTIFY_QUEUE_LENGTH> notifyQueue;
+
+  // Delivery statistics of each myBLEDevices slot, updated by BLESensorProcessing().
+  LinkStats linkStats[NUM_BLE_DEVICES];
+
   void start();
   void serverScan(bool connectRequest);
   bool connectToServer();
@@ -129,6 +205,8 @@ class SpinBLEClient {
   // (false)
   void resetDevices();
   void postConnect(NimBLEClient *pClient);
+  // linkStats of every used slot.
+  String returnLinkStatsJSON();
 
  private:
   class MyAdvertisedDeviceCallback : public NimBLEAdvertisedDeviceCallbacks {
@@ -11,18 +11,33 @@
 #include "HTTP_Server_Basic.h"
 #include "SmartSpin_parameters.h"
 #include "BLE_Common.h"
+#include "LogRing.h"
+#include "MotionPlanner.h"
+#include "StepGenerator.h"
+#include "StepperMonitor.h"
+#include "StepperMotion.h"
+#include "StepReconciler.h"
 
 // Function Prototypes
 bool IRAM_ATTR deBounce();
 void IRAM_ATTR moveStepper(void* pvParameters);
+void IRAM_ATTR onStepTimer();
 void IRAM_ATTR shiftUp();
 void IRAM_ATTR shiftDown();
 void debugDirector(String, bool = true, bool = false);
+void logDrainWorker(void* pvParameters);
 void resetIfShiftersHeld();
 void scanIfShiftersHeld();
 void setupTMCStepperDriver();
 void updateStepperPower();
 void updateStealthchop();
+void applyStepperCurrent();
+void stepperMonitorWorker(void* pvParameters);
+String returnStepperStatsJSON();
+
+// Where the stepper is, and the part of its target that comes from the shifters. In steps.
+extern int stepperPosition;
+extern int shifterPosition;
 
 // Main program variable that stores most everything
 extern userParameters userConfig;
@@ -31,6 +46,51 @@ extern userParameters userConfig;
 // calculation)
 extern physicalWorkingCapacity userPWC;
 
+// Messages waiting for logDrainWorker() to print them to Serial and debugToHTML.
+extern LogRing logRing;
+
+// Queue a message to print. Costs no formatting or allocation here, so it is safe from any task or interrupt.
+// The format must be a literal. String arguments are copied.
+template <typename... Args>
+void IRAM_ATTR logMessage(uint8_t level, const char* format, Args... args) {
+  logRing.log(millis(), level, 0, format, args...);
+}
+
+// Levels for SS2K_LOG() and LOG_LEVEL_<category> in settings.h. The same as LogRing::Levels.
+#define LOG_LEVEL_NONE    -1
+#define LOG_LEVEL_ERROR   0
+#define LOG_LEVEL_WARNING 1
+#define LOG_LEVEL_INFO    2
+#define LOG_LEVEL_DEBUG   3
+#define LOG_LEVEL_VERBOSE 4
+
+// Categories for SS2K_LOG(), indexes into logLevels.
+#define LOG_CATEGORY_BLE_CLIENT 0
+#define LOG_CATEGORY_BLE_SERVER 1
+#define LOG_CATEGORY_ERG        2
+#define LOG_CATEGORY_STEPPER    3
+#define LOG_CATEGORY_HTTP       4
+#define LOG_CATEGORIES          5
+
+// The level each category logs at, set from /loglevels. Never above what LOG_LEVEL_<category> built in.
+extern int8_t logLevels[LOG_CATEGORIES];
+extern const char* const logCategoryNames[LOG_CATEGORIES];
+void setLogLevel(uint8_t category, int level);
+String returnLogLevelsJSON();
+
+// Whether SS2K_LOG(category, level, ...) would log, e.g. SS2K_LOG_ENABLED(BLE_CLIENT, VERBOSE). A constant
+// false when the level isn't built in, so whatever it guards is compiled out.
+#define SS2K_LOG_ENABLED(category, level) (LOG_LEVEL_##category >= LOG_LEVEL_##level && logLevels[LOG_CATEGORY_##category] >= LOG_LEVEL_##level)
+
+// Log through logMessage(), e.g. SS2K_LOG(ERG, DEBUG, "Target %d W", watts). The arguments are only evaluated
+// when the message is logged, and the whole statement is compiled out above the category's LOG_LEVEL_<category>.
+#define SS2K_LOG(category, level, format, ...)                                                                  \
+  do {                                                                                                          \
+    if (LOG_LEVEL_##category >= LOG_LEVEL_##level && logLevels[LOG_CATEGORY_##category] >= LOG_LEVEL_##level) { \
+      logMessage(LOG_LEVEL_##level, format, ##__VA_ARGS__);                                                     \
+    }                                                                                                           \
+  } while (0)
+
 // Variable that will store debugging information that will get appended and
 // then cleared once posted to HTML or a timer expires.
 extern String debugToHTML;
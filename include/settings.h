@@ -36,6 +36,34 @@
 // name of local file to save Physical Working Capacity in Spiffs
 #define userPWCFILENAME "/userPWC.txt"
 
+// name of local file raw sensor notifications are recorded to in SPIFFS
+#define SENSOR_TRACE_FILENAME "/sensortrace.bin"
+
+// Largest sensor trace recorded. Recording stops when it is full.
+// That is about 20 minutes of a 4 Hz power meter and a heart rate strap.
+#define SENSOR_TRACE_MAX_SIZE 100000
+
+// name of local file the learned stepper position x cadence -> watts map is saved to in SPIFFS
+#define POWER_TABLE_FILENAME "/powertable.bin"
+
+// Grid of the learned power map: stepper positions from POWER_TABLE_MIN_POSITION
+// in steps of POWER_TABLE_POSITION_SPACING, cadences from POWER_TABLE_MIN_CADENCE rpm
+// in steps of POWER_TABLE_CADENCE_SPACING. Changing these discards the saved map.
+#define POWER_TABLE_MIN_POSITION -6000
+#define POWER_TABLE_POSITION_SPACING 2000
+#define POWER_TABLE_MIN_CADENCE 50
+#define POWER_TABLE_CADENCE_SPACING 10
+
+// Milliseconds the stepper has to rest before power readings are learned, so the
+// power meter has caught up with the new resistance.
+#define POWER_TABLE_SETTLE_TIME 3000
+
+// Steps the stepper may wander while ERG trims and still count as resting.
+#define POWER_TABLE_REST_BAND 100
+
+// Milliseconds between saves of the learned power map while it is learning.
+#define POWER_TABLE_SAVE_INTERVAL 300000
+
 // Default Stepper Power
 #define STEPPER_POWER 1000
 
@@ -94,6 +122,79 @@
 // Number of devices that can be connected to the Client (myBLEDevices size)
 #define NUM_BLE_DEVICES 4
 
+// Number of raw sensor notifications buffered between the BLE host and the
+// sensor processing task. Must be a power of two.
+#define NOTIFY_QUEUE_LENGTH 16
+
+// Largest sensor notification payload kept. Longer packets are truncated.
+#define NOTIFY_DATA_MAX_LENGTH 40
+
+// Number of FTMS control point writes buffered between the BLE host and the
+// task that applies them.
+#define CONTROL_POINT_QUEUE_LENGTH 8
+
+// Number of connect, disconnect and subscribe events of our server's clients buffered
+// between the BLE host and the task that sends notifications. Must be a power of two.
+#define SERVER_LINK_EVENT_QUEUE_LENGTH 16
+
+// Number of crank events of the upstream power meter buffered until they are passed
+// through to our Cycling Power Measurement. Must be a power of two.
+#define UPSTREAM_CRANK_EVENT_QUEUE_LENGTH 8
+
+// Milliseconds a sensor reading is used for. A sensor that stays silent longer
+// stops counting and its metrics fall back to the next sensor, or 0.
+#define SENSOR_STALE_TIMEOUT 3000
+
+// Most notifications per second sent for each server characteristic. Sensor data
+// that arrives faster is coalesced into the next notification.
+#define INDOOR_BIKE_DATA_MAX_RATE 4
+#define CYCLING_POWER_MAX_RATE 4
+#define HEART_RATE_MAX_RATE 1
+
+// ERG controller loop speed in Hz, and the gains of its PID in incline units
+// (0.01 % grade) per W of error. Gains are scaled by 100 / (target + 100).
+// Check changes with the simulator: pio test -e native -f native_ergsim
+#define ERG_UPDATE_RATE 10
+#define ERG_PROPORTIONAL_GAIN 3   // per W
+#define ERG_INTEGRAL_GAIN 24      // per W s
+#define ERG_DERIVATIVE_GAIN 0     // per W/s of measured power
+#define ERG_FEED_FORWARD_GAIN 10  // per W of target change, applied at once
+// Incline range and fastest incline change (units/s) the ERG controller uses. The
+// stepper could go far faster; the power meter's lag is what limits the rate, as
+// faster changes overshoot before the readings catch up.
+#define ERG_MIN_INCLINE -2000
+#define ERG_MAX_INCLINE 4000
+#define ERG_MAX_INCLINE_RATE 500
+// Below this cadence ERG releases the resistance so the rider can get going again.
+#define ERG_MIN_CADENCE 50
+
+// Stepper motion limits in steps, steps/s (up to StepGenerator::MaxStepRate),
+// steps/s^2 and steps/s^3. A jerk of 0 gives trapezoidal moves.
+#define STEPPER_MAX_VELOCITY 20000
+#define STEPPER_MAX_ACCELERATION 100000
+#define STEPPER_MAX_JERK 2000000
+// ms of motion planned per step queue segment, and how many ms of segments are
+// queued ahead of the step timer. A new target is picked up after the queued ones.
+#define STEPPER_PLAN_INTERVAL 5
+#define STEPPER_LOOKAHEAD 20
+// Hardware timer (0-3) that times the step pulses.
+#define STEPPER_TIMER 0
+// ms at rest before the stepper driver is switched off while no app is connected.
+#define STEPPER_DISABLE_DELAY 300
+// ms between polls of the stepper driver's status over UART.
+#define STEPPER_TELEMETRY_INTERVAL 1000
+// While the driver warns of overtemperature its currents are cut by
+// STEPPER_THERMAL_STEP % every STEPPER_THERMAL_STEP_INTERVAL ms, to no less than
+// STEPPER_MIN_CURRENT %. They come back the same way once it has not warned for
+// STEPPER_COOL_DOWN_TIME ms.
+#define STEPPER_THERMAL_STEP 10
+#define STEPPER_THERMAL_STEP_INTERVAL 10000
+#define STEPPER_MIN_CURRENT 50
+#define STEPPER_COOL_DOWN_TIME 60000
+// Hold current, in %, once the stepper has been at rest for STEPPER_LONG_HOLD_TIME ms.
+#define STEPPER_LONG_HOLD_CURRENT 50
+#define STEPPER_LONG_HOLD_TIME 30000
+
 // loop speed for the Webserver
 #define WEBSERVER_DELAY 30
 
@@ -118,6 +219,36 @@
 // Max size of userconfig
 #define USERCONFIG_JSON_SIZE 768
 
+// Max size of the sensor link statistics
+#define LINKSTATS_JSON_SIZE 3072
+
+// Max size of the per client notification statistics
+#define CLIENTSTATS_JSON_SIZE 1024
+
+// Max size of the ERG controller statistics
+#define ERGSTATS_JSON_SIZE 512
+
+// Max size of the stepper driver statistics
+#define STEPPERSTATS_JSON_SIZE 512
+
+// Max size of the log levels
+#define LOGLEVELS_JSON_SIZE 384
+
+// ms between checks of the log ring for messages to print, and the most
+// characters of them kept for the web page's debug view.
+#define LOG_DRAIN_INTERVAL 50
+#define DEBUG_HTML_SIZE 500
+
+// Most detailed log level built in for each category, LOG_LEVEL_NONE to
+// LOG_LEVEL_VERBOSE. More detailed messages are compiled out, arguments and all,
+// and /loglevels can only lower them at runtime. VERBOSE logs every sensor packet,
+// notification and control point write.
+#define LOG_LEVEL_BLE_CLIENT LOG_LEVEL_INFO
+#define LOG_LEVEL_BLE_SERVER LOG_LEVEL_INFO
+#define LOG_LEVEL_ERG LOG_LEVEL_INFO
+#define LOG_LEVEL_STEPPER LOG_LEVEL_INFO
+#define LOG_LEVEL_HTTP LOG_LEVEL_INFO
+
 // Uncomment to enable sending Telegram debug messages back to the chat
 // specified in telegram_token.h
 #define USE_TELEGRAM
@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief What to ask of one BLE link, in the units of the HCI.
+ */
+struct ConnectionParameters {
+  uint16_t minInterval;         // 1.25 ms
+  uint16_t maxInterval;         // 1.25 ms
+  uint16_t latency;             // Connection events the peripheral may skip
+  uint16_t supervisionTimeout;  // 10 ms
+  bool prefer2M;                // Ask for the 2M PHY. Refused by controllers without it.
+  uint16_t dataLength;          // Link layer payload to ask for, 0 when the default 27 bytes fit.
+};
+
+/**
+ * @brief Picks connection parameters for each link by its role and tracks the links still to be negotiated.
+ * @details Links carrying power (sensor to us) or control (app to us) get short intervals, the ERG loop waits
+ * on both. Heart rate gets a relaxed interval. addLink(), removeLink() and takePending() must be called from
+ * one task. Times are in microseconds.
+ */
+class ConnectionManager {
+ public:
+  enum Roles : uint8_t {
+    PowerUplink,   // A power meter or trainer we subscribe to
+    SensorUplink,  // A sensor we subscribe to for anything else, heart rate
+    AppDownlink    // An app connected to our server
+  };
+
+  static constexpr uint8_t MaxLinks        = 8;
+  static constexpr uint16_t NoConnection   = 0xFFFF;
+  static constexpr uint32_t SettleTime     = 100000;  // Let a new peer finish discovery before renegotiating
+  static constexpr uint16_t DefaultPayload = 27;      // Link layer payload every controller supports
+
+  struct Link {
+    uint16_t connHandle;  // NoConnection when the slot is free
+    uint8_t role;
+    bool pending;  // Not negotiated yet
+    uint32_t connectedAt;
+  };
+
+  ConnectionManager();
+
+  /**
+   * @brief Parameters for a link.
+   * @param [in] role One of Roles.
+   * @param [in] notifyRate The fastest rate data is sent over the link, in Hz. The interval is kept to
+   * at most half its period. 0 to use the role's interval alone.
+   * @param [in] largestPayload The largest ATT value sent over the link, in bytes.
+   */
+  static ConnectionParameters getParameters(uint8_t role, float notifyRate, size_t largestPayload);
+
+  /**
+   * @brief Track a new connection, to be negotiated once SettleTime has passed.
+   * @return False if MaxLinks connections are already tracked.
+   */
+  bool addLink(uint16_t connHandle, uint8_t role, uint32_t now);
+
+  /**
+   * @brief Stop tracking a connection.
+   */
+  void removeLink(uint16_t connHandle);
+
+  /**
+   * @brief Take the next link that is due for negotiation.
+   * @param [in] now The current time.
+   * @param [out] link The link. It is not pending anymore.
+   * @return False if no link is due.
+   */
+  bool takePending(uint32_t now, Link *link);
+
+ private:
+  Link links[MaxLinks];
+
+  Link *find(uint16_t connHandle);
+};
@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * @brief Produces the Crank Revolution Data we advertise: cumulative revolutions and the time of the last
+ * revolution in 1/1024 s, both rolling over at 16 bits.
+ * @details Cadence is integrated over the time that actually passed, and each event is stamped with the
+ * moment its revolution completed, so the data is right whatever the notification rate. While the upstream
+ * power meter sends its own crank events they are passed through instead. Times are in microseconds.
+ */
+class CrankSynthesizer {
+ public:
+  static constexpr uint32_t PassthroughTimeout = 3000000;  // Synthesize again when the power meter has sent no crank event for this long
+
+  CrankSynthesizer();
+
+  /**
+   * @brief Advance the synthesized crank to a time.
+   * @param [in] cadence The cadence since the last update, in rpm. 0 or NAN while the crank is stopped.
+   * @param [in] now The current time.
+   */
+  void update(float cadence, uint32_t now);
+
+  /**
+   * @brief A crank event from the upstream power meter.
+   * @details The first event, and the first after PassthroughTimeout, only set the baseline. The ones after
+   * it advance our counters by as much as the power meter's did.
+   * @param [in] revolutions The power meter's cumulative crank revolutions.
+   * @param [in] time The power meter's last crank event time, in 1/1024 s.
+   * @param [in] now When the event was received.
+   */
+  void passthrough(uint16_t revolutions, uint16_t time, uint32_t now);
+
+  /**
+   * @brief Whether upstream crank events are being passed through.
+   */
+  bool isPassthrough(uint32_t now) const;
+
+  uint16_t getRevolutions() const { return this->revolutions; }
+
+  uint16_t getEventTime() const { return this->eventTime; }
+
+ private:
+  uint16_t revolutions         = 0;
+  uint16_t eventTime           = 0;  // 1/1024 s
+  float phase                  = 0;  // Part of the current revolution done, [0, 1)
+  bool started                 = false;
+  uint32_t lastUpdate          = 0;
+  uint32_t lastEventAt         = 0;  // The time eventTime stands for
+  uint32_t tickRemainder       = 0;  // us * 1024 not yet counted in eventTime
+  bool passing                 = false;
+  uint16_t upstreamRevolutions = 0;
+  uint16_t upstreamTime        = 0;
+  uint32_t upstreamAt          = 0;  // The last upstream event that moved the crank
+
+  void setEventAt(uint32_t at);
+};
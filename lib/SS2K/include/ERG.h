@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+
+/**
+ * @brief Closed-loop ERG control of the incline, run at a fixed rate off the latest power sample.
+ * @details A PID on the power error with feed-forward, all in incline units (0.01 % grade) per W. Gains are scaled
+ * down by 100 / (target + 100), as resistance changes more watts at heavier targets. A target change moves the
+ * incline by the feed-forward, or to a predicted incline, at once and the PID trims from there. The integral only
+ * grows while the output is neither clamped nor slew limited. Below the minimum cadence the incline is released
+ * to 0, so the rider can get going again. Times are in microseconds.
+ */
+class ERGController {
+ public:
+  struct Gains {
+    float proportional;  // per W
+    float integral;      // per W s
+    float derivative;    // per W/s, of the measured power so target changes don't kick
+    float feedForward;   // per W of target change
+  };
+
+  struct Limits {
+    float minIncline;
+    float maxIncline;
+    float maxRate;  // incline units/s
+    float minCadence;
+  };
+
+  /**
+   * @brief How the controller tracked its targets.
+   * @details A step is settled once power stays within SettleBand of the target for SettleHold.
+   */
+  struct Metrics {
+    int32_t target;
+    bool settled;            // The current target
+    uint32_t settlingTime;   // Of the last settled step, from the target change to entering the band for good
+    float overshoot;         // Of the last settled step, W past the target
+    float currentOvershoot;  // Of the current step so far
+    uint32_t steps;          // Target changes
+    uint32_t updates;
+    uint32_t gatedUpdates;  // Below the minimum cadence
+    uint32_t saturatedUpdates;
+  };
+
+  static constexpr float SettleBand    = 0.05f;  // Of the target
+  static constexpr float MinSettleBand = 10;     // W
+  static constexpr uint32_t SettleHold = 2000000;
+
+  ERGController(const Gains &gains, const Limits &limits);
+
+  /**
+   * @brief Start tracking a new target.
+   * @param [in] watts The target power.
+   * @param [in] incline The incline right now, which the controller continues from.
+   * @param [in] now The current time.
+   * @param [in] predictedIncline The incline expected to give the target, jumped to instead of the feed-forward.
+   * NAN if there is no prediction.
+   */
+  void setTarget(int32_t watts, float incline, uint32_t now, float predictedIncline = NAN);
+
+  /**
+   * @brief One control step.
+   * @param [in] watts The latest power sample.
+   * @param [in] cadence The latest cadence in rpm.
+   * @param [in] now The current time.
+   * @return The new incline.
+   */
+  float update(float watts, float cadence, uint32_t now);
+
+  const Metrics &getMetrics() const { return this->metrics; }
+
+ private:
+  Gains gains;
+  Limits limits;
+  Metrics metrics;
+  float output         = 0;
+  float bias           = 0;  // Incline at the last target change, plus the feed-forward
+  float predicted      = NAN;
+  float integral       = 0;
+  float lastWatts      = NAN;
+  bool gated           = true;
+  bool started         = false;
+  uint32_t lastUpdate  = 0;
+  uint32_t stepStart   = 0;
+  uint32_t inBandSince = 0;
+  bool inBand          = false;
+  float stepDirection  = 0;
+
+  float getSchedule() const { return 100.0f / (this->metrics.target > 0 ? this->metrics.target + 100.0f : 100.0f); }
+  void rebase(float watts);
+  void updateMetrics(float watts, uint32_t now);
+};
@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// https://www.bluetooth.com/specifications/specs/fitness-machine-service-1-0/ (4.16 Fitness Machine Control Point)
+class FTMSControlPoint {
+ public:
+  enum OpCodes : uint8_t {
+    RequestControl                    = 0x00,
+    Reset                             = 0x01,
+    SetTargetSpeed                    = 0x02,
+    SetTargetInclination              = 0x03,
+    SetTargetResistanceLevel          = 0x04,
+    SetTargetPower                    = 0x05,
+    SetTargetHeartRate                = 0x06,
+    StartOrResume                     = 0x07,
+    StopOrPause                       = 0x08,
+    SetIndoorBikeSimulationParameters = 0x11,
+    ResponseCode                      = 0x80
+  };
+
+  enum ResultCodes : uint8_t { Success = 0x01, OpCodeNotSupported = 0x02, InvalidParameter = 0x03, OperationFailed = 0x04, ControlNotPermitted = 0x05 };
+
+  static constexpr size_t MaxLength    = 20;
+  static constexpr size_t ResponseSize = 3;
+
+  /**
+   * @brief One write to the control point, as received.
+   */
+  struct Command {
+    uint16_t connHandle;  // The client that wrote it, and gets the response
+    uint8_t length;
+    uint8_t data[MaxLength];
+
+    uint8_t getOpCode() const { return this->length > 0 ? static_cast<uint8_t>(this->data[0]) : static_cast<uint8_t>(ResponseCode); }
+  };
+
+  /**
+   * @brief Check a command against the op codes we support and their parameter lengths.
+   * @return Success if the command can be applied, else the result code to respond with.
+   */
+  static uint8_t validate(const Command &command);
+
+  /**
+   * @brief Whether applying a command can be skipped because a later one of a batch overrides it.
+   * @details Only runs of Indoor Bike Simulation Parameters collapse, to the last one. Superseded
+   * commands still get a response.
+   * @param [in] batch Commands in the order they were written.
+   * @param [in] count The number of commands in batch.
+   * @param [in] index The command to check.
+   */
+  static bool isSuperseded(const Command *batch, size_t count, size_t index);
+
+  /**
+   * @brief The response indication for a command.
+   * @param [out] out At least ResponseSize bytes.
+   * @return The number of bytes written.
+   */
+  static size_t encodeResponse(uint8_t *out, uint8_t opCode, uint8_t result);
+};
@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Delivery statistics of one connected sensor.
+ * @details Timestamps and durations are in microseconds. Nothing here allocates, so it is cheap to update per packet.
+ */
+class LinkStats {
+ public:
+  static constexpr uint8_t HistogramBins = 8;
+
+  /**
+   * @brief Upper bounds of the inter-arrival histogram bins in ms. The last bin takes everything longer.
+   */
+  static const uint16_t HistogramLimits[HistogramBins - 1];
+
+  LinkStats() { this->reset(); }
+
+  void reset();
+
+  /**
+   * @brief Count a packet arriving.
+   * @param [in] timestamp micros() at arrival.
+   * @param [in] length The length of the packet in bytes.
+   */
+  void recordPacket(uint32_t timestamp, size_t length);
+
+  /**
+   * @brief Count a decode.
+   * @param [in] duration How long decoding took.
+   * @param [in] decoded False if the packet held nothing we could use.
+   */
+  void recordDecode(uint32_t duration, bool decoded);
+
+  uint32_t getPackets() const { return this->packets; }
+  uint32_t getBytes() const { return this->bytes; }
+  uint32_t getDecodeFailures() const { return this->decodeFailures; }
+  uint32_t getMaxGap() const { return this->maxGap; }
+  uint32_t getMaxDecodeTime() const { return this->maxDecodeTime; }
+  uint32_t getHistogramCount(uint8_t bin) const { return bin < HistogramBins ? this->histogram[bin] : 0; }
+
+  /**
+   * @brief Age of the last packet.
+   * @param [in] now micros() now.
+   * @return The age, or UINT32_MAX if there has been no packet.
+   */
+  uint32_t getLastPacketAge(uint32_t now) const { return this->packets > 0 ? now - this->lastTimestamp : UINT32_MAX; }
+
+  /**
+   * @brief Mean packets per second, from the time between packets.
+   */
+  float getRate() const;
+
+  /**
+   * @brief Mean time between packets.
+   */
+  float getMeanGap() const;
+
+  /**
+   * @brief Standard deviation of the time between packets.
+   */
+  float getJitter() const;
+
+  /**
+   * @brief Mean decode time.
+   */
+  float getMeanDecodeTime() const;
+
+ private:
+  uint32_t packets;
+  uint32_t bytes;
+  uint32_t decodeFailures;
+  uint32_t decodes;
+  uint32_t lastTimestamp;
+  uint32_t maxGap;
+  uint64_t gapSum;        // us
+  uint64_t gapSquareSum;  // ms^2, so hours of multi-second gaps still fit
+  uint64_t decodeTimeSum;
+  uint32_t maxDecodeTime;
+  uint32_t histogram[HistogramBins];
+};
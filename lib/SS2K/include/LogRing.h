@@ -0,0 +1,157 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#ifdef ARDUINO
+#include <esp_attr.h>
+#else
+#define IRAM_ATTR
+#endif
+
+/**
+ * @brief Bounded, lock-free ring of binary log records, formatted later by whoever drains it.
+ * @details A record keeps the time, level, a pointer to the printf style format and the raw arguments. Nothing
+ * is formatted and nothing allocates until a record is read, so log() costs a compare-and-swap and a few copies.
+ * Any number of tasks and interrupts may call log() at once. Exactly one task may call read(). When the ring is
+ * full the new record is dropped and counted in getDropped().
+ *
+ * The format must outlive the record, so it is normally a literal, and log() doesn't read it. String arguments
+ * are copied into the record, and cut short if they don't fit.
+ */
+class LogRing {
+ public:
+  enum Levels : uint8_t { Error = 0, Warning = 1, Info = 2, Debug = 3, Verbose = 4 };
+
+  static constexpr size_t Capacity    = 64;   // Records, a power of two
+  static constexpr size_t PayloadSize = 112;  // Bytes of arguments in a record
+
+  static constexpr uint8_t NoNewline = 0x01;  // Record flags. The next record continues the line
+  static constexpr uint8_t Truncated = 0x02;  // Set by log() when the arguments didn't fit
+
+  struct Record {
+    uint32_t time;
+    const char *format;
+    uint8_t level;
+    uint8_t flags;
+    uint8_t size;  // Payload bytes used
+    uint8_t payload[PayloadSize];
+  };
+
+  /**
+   * @brief An argument to log as hex bytes, "0a 1b ", whatever the conversion. Copied like strings.
+   */
+  struct Hex {
+    Hex(const uint8_t *data, size_t length) : data(data), length(length) {}
+    const uint8_t *data;
+    size_t length;
+  };
+
+  LogRing();
+
+  /**
+   * @brief Queue a message.
+   * @param [in] time The time to stamp it with.
+   * @param [in] level One of Levels.
+   * @param [in] flags NoNewline, or 0.
+   * @param [in] format A printf style format. Integers, floating point numbers, strings, pointers and Hex
+   * are supported, and are printed as the argument's type whatever the conversion says.
+   * @return False if the ring was full and the message was dropped.
+   */
+  template <typename... Args>
+  bool IRAM_ATTR log(uint32_t time, uint8_t level, uint8_t flags, const char *format, Args... args) {
+    uint32_t position;
+    Record *record = this->claim(position);
+    if (record == nullptr) {
+      return false;
+    }
+    record->time   = time;
+    record->format = format;
+    record->level  = level;
+    record->flags  = flags;
+    record->size   = 0;
+    pack(*record, args...);
+    this->publish(position);
+    return true;
+  }
+
+  /**
+   * @brief Queue text that isn't a literal, split over as many records as it takes.
+   * @return False if a part was dropped.
+   */
+  bool logText(uint32_t time, uint8_t level, uint8_t flags, const char *text);
+
+  /**
+   * @brief Copy the oldest record out of the ring.
+   * @param [out] record Receives the record.
+   * @return False if there was none.
+   */
+  bool read(Record &record);
+
+  /**
+   * @brief Format a record's message.
+   * @param [in] record The record to format.
+   * @param [out] text Receives the message, always terminated.
+   * @param [in] size The size of text.
+   * @return The length of the message written to text.
+   */
+  static size_t format(const Record &record, char *text, size_t size);
+
+  /**
+   * @brief Get the number of records dropped because the ring was full.
+   */
+  uint32_t getDropped() const { return this->dropped.load(std::memory_order_relaxed); }
+
+ private:
+  enum Types : uint8_t { Int = 1, UnsignedInt = 2, LongLong = 3, UnsignedLongLong = 4, Double = 5, Text = 6, Pointer = 7, Bytes = 8 };
+
+  struct Slot {
+    std::atomic<uint32_t> sequence;  // position while free, position + 1 once written
+    Record record;
+  };
+
+  Slot slots[Capacity];
+  std::atomic<uint32_t> writePosition;
+  std::atomic<uint32_t> dropped;
+  uint32_t readPosition = 0;  // Owned by read()
+
+  Record *IRAM_ATTR claim(uint32_t &position);
+  void IRAM_ATTR publish(uint32_t position);
+
+  static void IRAM_ATTR put(Record &record, uint8_t type, const void *value, size_t size);
+  static void IRAM_ATTR putString(Record &record, const char *value);
+  static void IRAM_ATTR putBytes(Record &record, const Hex &value);
+
+  static void pack(Record &) {}
+
+  template <typename T, typename U, typename... Args>
+  static void IRAM_ATTR pack(Record &record, T first, U second, Args... args) {
+    pack(record, first);
+    pack(record, second, args...);
+  }
+
+  static void IRAM_ATTR pack(Record &record, int value) { put(record, Int, &value, sizeof(value)); }
+  static void IRAM_ATTR pack(Record &record, unsigned int value) { put(record, UnsignedInt, &value, sizeof(value)); }
+  static void IRAM_ATTR pack(Record &record, long value) {
+    const long long widened = value;
+    put(record, LongLong, &widened, sizeof(widened));
+  }
+  static void IRAM_ATTR pack(Record &record, unsigned long value) {
+    const unsigned long long widened = value;
+    put(record, UnsignedLongLong, &widened, sizeof(widened));
+  }
+  static void IRAM_ATTR pack(Record &record, long long value) { put(record, LongLong, &value, sizeof(value)); }
+  static void IRAM_ATTR pack(Record &record, unsigned long long value) { put(record, UnsignedLongLong, &value, sizeof(value)); }
+  static void IRAM_ATTR pack(Record &record, double value) { put(record, Double, &value, sizeof(value)); }
+  static void IRAM_ATTR pack(Record &record, const char *value) { putString(record, value); }
+  static void IRAM_ATTR pack(Record &record, const void *value) { put(record, Pointer, &value, sizeof(value)); }
+  static void IRAM_ATTR pack(Record &record, const Hex &value) { putBytes(record, value); }
+};
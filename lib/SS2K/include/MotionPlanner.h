@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * @brief Plans the stepper's motion towards a target that may change at any time, limiting velocity,
+ * acceleration and jerk.
+ * @details Each update takes the strongest acceleration towards the target that still lets the stepper stop
+ * on it, braking as hard as the limits allow. Nothing is planned further ahead than that, so a target change
+ * mid-move just blends into a new trajectory: the stepper keeps going, slows down early or turns round
+ * without stopping first. It only runs past a target that moved closer than it can stop. With maxJerk 0 the
+ * profile is trapezoidal. Positions are in steps and times in seconds.
+ */
+class MotionPlanner {
+ public:
+  struct Limits {
+    float maxVelocity;      // steps/s
+    float maxAcceleration;  // steps/s^2
+    float maxJerk;          // steps/s^3, 0 for no limit
+  };
+
+  static constexpr float MaxTimeStep = 0.001f;  // Longer updates are done in steps of this
+
+  explicit MotionPlanner(const Limits &limits);
+
+  /**
+   * @brief Set where to go. Takes effect from the next update.
+   */
+  void setTarget(int32_t target) { this->target = target; }
+
+  /**
+   * @brief Stop at a position, dropping the motion in progress.
+   */
+  void reset(int32_t position);
+
+  /**
+   * @brief Advance the motion. It snaps onto the target once within half a step and nearly stopped.
+   * @param [in] dt The time step.
+   */
+  void update(float dt);
+
+  /**
+   * @brief Whether the motion is at rest on the target.
+   */
+  bool isSettled() const { return this->velocity == 0 && this->acceleration == 0 && this->position == this->target; }
+
+  int32_t getTarget() const { return this->target; }
+
+  float getPosition() const { return this->position; }
+
+  float getVelocity() const { return this->velocity; }
+
+  float getAcceleration() const { return this->acceleration; }
+
+ private:
+  Limits limits;
+  int32_t target     = 0;
+  float position     = 0;
+  float velocity     = 0;
+  float acceleration = 0;
+
+  float stoppingDistance(float velocity, float acceleration) const;
+  void advance(float dt);
+};
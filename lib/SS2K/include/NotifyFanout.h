@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Tracks notification delivery to each client connected to our server.
+ * @details A client whose notifications fail (typically because the host ran out of mbufs while its
+ * link is congested) is backed off: it is skipped for MinBackoff, doubling with every further failure
+ * up to MaxBackoff, while the other clients keep getting every update. Skipped updates are coalesced,
+ * a recovered client simply gets the current values. Not thread safe, use from the sending task only.
+ * Times are in microseconds.
+ */
+class NotifyFanout {
+ public:
+  static constexpr uint8_t MaxPeers      = 8;
+  static constexpr uint8_t MaxChannels   = 8;
+  static constexpr uint32_t MinBackoff   = 100000;
+  static constexpr uint32_t MaxBackoff   = 2000000;
+  static constexpr uint16_t NoConnection = 0xFFFF;
+
+  struct Peer {
+    uint16_t connHandle;  // NoConnection when the slot is free
+    uint8_t subscribed;   // Channel bits
+    uint8_t failureStreak;
+    uint32_t retryAt;  // Skipped until then while failureStreak > 0
+    uint32_t sent;
+    uint32_t failed;
+    uint32_t skipped;
+  };
+
+  NotifyFanout();
+
+  /**
+   * @brief Start tracking a connection. Its counters start at 0.
+   * @return False if MaxPeers connections are already tracked.
+   */
+  bool addPeer(uint16_t connHandle);
+
+  /**
+   * @brief Stop tracking a connection.
+   */
+  void removePeer(uint16_t connHandle);
+
+  /**
+   * @brief Record whether a connection subscribed to a channel. Unknown connections are added.
+   */
+  void setSubscribed(uint16_t connHandle, uint8_t channel, bool subscribed);
+
+  /**
+   * @brief The connections to send a channel to now.
+   * @details Subscribed connections that are backed off are left out and counted as skipped.
+   * @param [in] channel The channel about to be sent.
+   * @param [in] now The current time.
+   * @param [out] connHandles At least MaxPeers entries.
+   * @return The number of connections written to connHandles.
+   */
+  uint8_t getRecipients(uint8_t channel, uint32_t now, uint16_t *connHandles);
+
+  /**
+   * @brief Record the outcome of a notification handed to the host.
+   */
+  void recordResult(uint16_t connHandle, bool delivered, uint32_t now);
+
+  /**
+   * @brief A tracked connection, or one of the free slots.
+   * @param [in] slot Below MaxPeers.
+   */
+  const Peer &getPeer(uint8_t slot) const { return this->peers[slot]; }
+
+ private:
+  Peer peers[MaxPeers];
+
+  Peer *find(uint16_t connHandle);
+};
@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+
+/**
+ * @brief Decides when each outbound characteristic is sent.
+ * @details A channel is sent as soon as it has fresh data, but no more often than its maximum rate.
+ * Data that arrives faster is coalesced into the next send. markDirty() may be called from any task,
+ * takeDue() and getTimeUntilDue() only from the task that sends. Times are in microseconds.
+ */
+class NotifyScheduler {
+ public:
+  static constexpr uint8_t MaxChannels = 8;
+
+  NotifyScheduler() : pending(0), minInterval(), lastSent(), sent(0) {}
+
+  /**
+   * @brief The bit of a channel in the masks taken and returned below.
+   */
+  static constexpr uint8_t bit(uint8_t channel) { return 1 << channel; }
+
+  /**
+   * @brief Limit how often a channel is sent.
+   * @param [in] channel The channel, below MaxChannels.
+   * @param [in] maxRate Sends per second. 0 for no limit.
+   */
+  void setMaxRate(uint8_t channel, float maxRate);
+
+  /**
+   * @brief Flag channels as having fresh data.
+   * @param [in] channels A bit mask, bit n for channel n.
+   */
+  void markDirty(uint8_t channels) { this->pending.fetch_or(channels, std::memory_order_release); }
+
+  /**
+   * @brief Take the channels that have fresh data and may be sent now.
+   * @param [in] now The current time.
+   * @return A bit mask of the channels to send. They are considered sent at now.
+   */
+  uint8_t takeDue(uint32_t now);
+
+  /**
+   * @brief How long until the next dirty channel may be sent.
+   * @param [in] now The current time.
+   * @return 0 if one may be sent now, UINT32_MAX if no channel is dirty.
+   */
+  uint32_t getTimeUntilDue(uint32_t now) const;
+
+ private:
+  std::atomic<uint8_t> pending;
+  uint32_t minInterval[MaxChannels];
+  uint32_t lastSent[MaxChannels];
+  uint8_t sent;  // Channels that have a lastSent
+
+  uint32_t timeUntilAllowed(uint8_t channel, uint32_t now) const;
+};
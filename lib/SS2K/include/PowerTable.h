@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief A learned map of stepper position and cadence to watts.
+ * @details A PositionBins x CadenceBins grid, read by bilinear interpolation. Each measured sample moves the
+ * four cells around it towards the measurement, by their interpolation weight and a rate that falls as a cell
+ * collects samples. Adding a sample and looking up watts touch four cells, looking up a position scans one
+ * cadence row, so all are constant time.
+ *
+ * Positions are counted from wherever the stepper was at power up, so a table loaded from flash, or one
+ * learned before the knob was turned by hand, may be off by an unknown number of steps. A loaded table is
+ * untrusted: it learns nothing and getPosition() answers nothing until MatchSamples samples in a row agree
+ * with it. MatchSamples samples in a row that disagree with a table, trusted or not, mean the origin moved,
+ * and it starts over.
+ */
+class PowerTable {
+ public:
+  static constexpr uint8_t PositionBins  = 16;
+  static constexpr uint8_t CadenceBins   = 8;
+  static constexpr uint32_t Magic        = 0x31545053;  // "SPT1"
+  static constexpr size_t HeaderSize     = 16;
+  static constexpr size_t SerializedSize = HeaderSize + PositionBins * CadenceBins * 3;  // 0.1 W and a sample count per cell
+  static constexpr float MinLearningRate = 0.05f;                                         // Keeps following a trainer that drifts as it warms up
+  static constexpr uint8_t MatchSamples  = 4;                                             // In a row, to trust or discard the table
+  static constexpr float MatchTolerance  = 0.2f;                                          // Of the expected watts, for a sample to agree
+  static constexpr float MatchMinWatts   = 25;                                            // The least difference that disagrees
+
+  /**
+   * @param [in] minPosition The stepper position of the first position bin.
+   * @param [in] positionSpacing Steps between position bins.
+   * @param [in] minCadence The cadence of the first cadence bin, in rpm.
+   * @param [in] cadenceSpacing rpm between cadence bins.
+   */
+  PowerTable(int32_t minPosition, int32_t positionSpacing, uint8_t minCadence, uint8_t cadenceSpacing);
+
+  /**
+   * @brief Learn from a measurement taken with the stepper at rest.
+   * @details Samples outside the position range are dropped, cadences outside the range count for the edge bins.
+   * While the table is untrusted, samples are only compared with it.
+   */
+  void addSample(int32_t position, float cadence, float watts);
+
+  /**
+   * @brief The watts expected at a position and cadence.
+   * @return False if the cells around it have not learned anything yet.
+   */
+  bool getWatts(int32_t position, float cadence, float *watts) const;
+
+  /**
+   * @brief The lowest position expected to give a power at a cadence.
+   * @details Only spans between learned cells where watts rise with position are used.
+   * @return False if no learned span covers the power, or the table is untrusted.
+   */
+  bool getPosition(float watts, float cadence, int32_t *position) const;
+
+  /**
+   * @brief Forget everything learned. An empty table is trusted.
+   */
+  void clear();
+
+  /**
+   * @brief Write the table in its flash format.
+   * @param [out] out At least SerializedSize bytes.
+   * @return The number of bytes written, 0 if out is too small.
+   */
+  size_t serialize(uint8_t *out, size_t size) const;
+
+  /**
+   * @brief Read a table written by serialize().
+   * @details The table is left as it was if the data is not a table of the same grid. A loaded table is
+   * untrusted until samples agree with it.
+   * @return False if the data was not used.
+   */
+  bool deserialize(const uint8_t *data, size_t length);
+
+  // Samples added since construction, clear() or deserialize().
+  uint32_t getSamples() const { return this->samples; }
+
+  // Whether the table has been learned, or checked, at the current position origin.
+  bool isTrusted() const { return this->trusted; }
+
+  // Times the table started over because samples kept disagreeing with it.
+  uint32_t getDiscarded() const { return this->discarded; }
+
+ private:
+  struct Cell {
+    float watts;
+    uint8_t samples;
+  };
+
+  // Where a position and cadence fall in the grid: the lower cell and the fractions towards the next one.
+  struct Location {
+    uint8_t position;
+    uint8_t cadence;
+    float positionFraction;
+    float cadenceFraction;
+  };
+
+  int32_t minPosition;
+  int32_t positionSpacing;
+  uint8_t minCadence;
+  uint8_t cadenceSpacing;
+  uint32_t samples      = 0;
+  uint32_t discarded    = 0;
+  bool trusted          = true;
+  uint8_t agreements    = 0;  // Samples in a row that matched what the table expected
+  uint8_t disagreements = 0;  // And that didn't
+  Cell cells[PositionBins][CadenceBins];
+
+  bool locate(int32_t position, float cadence, Location *location) const;
+  bool getRowWatts(uint8_t position, const Location &location, float *watts) const;
+};
@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Bounded, lock-free, single-producer/single-consumer queue.
+ * @details Exactly one task may call push() and exactly one task may call pop(). Neither call
+ * blocks or allocates, so push() is safe to use from the NimBLE host task. When the queue is
+ * full the new item is rejected and counted in getDropped().
+ * @tparam T The item type. Items are copied in and out.
+ * @tparam Capacity The number of slots. Must be a power of two.
+ */
+template <typename T, size_t Capacity>
+class SPSCQueue {
+  static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+ public:
+  SPSCQueue() : head(0), tail(0), dropped(0) {}
+
+  /**
+   * @brief Copy an item into the queue.
+   * @param [in] item The item to enqueue.
+   * @return False if the queue was full and the item was dropped.
+   */
+  bool push(const T &item) {
+    const size_t currentTail = this->tail.load(std::memory_order_relaxed);
+    if (currentTail - this->head.load(std::memory_order_acquire) >= Capacity) {
+      this->dropped.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    this->items[currentTail & (Capacity - 1)] = item;
+    this->tail.store(currentTail + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * @brief Copy the oldest item out of the queue.
+   * @param [out] item Receives the dequeued item.
+   * @return False if the queue was empty.
+   */
+  bool pop(T &item) {
+    const size_t currentHead = this->head.load(std::memory_order_relaxed);
+    if (currentHead == this->tail.load(std::memory_order_acquire)) {
+      return false;
+    }
+    item = this->items[currentHead & (Capacity - 1)];
+    this->head.store(currentHead + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * @brief Get the number of queued items.
+   * @details Only a snapshot; the other side may change it concurrently.
+   */
+  size_t size() const { return this->tail.load(std::memory_order_acquire) - this->head.load(std::memory_order_acquire); }
+
+  /**
+   * @brief Get the number of items rejected because the queue was full.
+   */
+  uint32_t getDropped() const { return this->dropped.load(std::memory_order_relaxed); }
+
+ private:
+  T items[Capacity];
+  std::atomic<size_t> head;
+  std::atomic<size_t> tail;
+  std::atomic<uint32_t> dropped;
+};
@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#pragma once
+
+#include <functional>
+#include <stddef.h>
+#include <stdint.h>
+#include <NimBLEUUID.h>
+
+// A sensor trace is a recording of raw sensor notifications, in arrival order.
+//
+//   Header:     'S' 'S' '2' 'T' version
+//   Channel:    'C' channel uuidSize uuid[uuidSize]                 Binds a channel to a characteristic UUID (LSB first).
+//   Notify:     'N' channel timestamp[4] length payload[length]     Timestamp is micros() at arrival, little endian.
+//
+// A channel record is written the first time a characteristic is seen, so a notification costs 8 bytes plus its payload.
+
+class SensorTraceWriter {
+ public:
+  static constexpr uint8_t Version       = 1;
+  static constexpr size_t HeaderSize     = 5;
+  static constexpr uint8_t MaxChannels   = 8;
+  static constexpr size_t MaxPayloadSize = 255;
+  static constexpr size_t MaxRecordSize  = (3 + 16) + (7 + MaxPayloadSize);  // A channel record followed by a notify record
+
+  SensorTraceWriter() : channelCount(0) {}
+
+  /**
+   * @brief Start a new trace.
+   * @param [out] out Where to write the header.
+   * @param [in] capacity The size of out, at least HeaderSize.
+   * @return The number of bytes written, 0 if out is too small.
+   */
+  size_t writeHeader(uint8_t *out, size_t capacity);
+
+  /**
+   * @brief Encode one notification.
+   * @details Does not allocate. Emits a channel record first when charUUID has not been seen since writeHeader().
+   * @param [out] out Where to write the records.
+   * @param [in] capacity The size of out. MaxRecordSize always fits.
+   * @param [in] timestamp micros() at arrival.
+   * @param [in] charUUID The UUID of the notifying characteristic.
+   * @param [in] data The payload.
+   * @param [in] length The length of the payload. Longer payloads are truncated to MaxPayloadSize.
+   * @return The number of bytes written, 0 if the records don't fit or there are more than MaxChannels characteristics.
+   */
+  size_t writePacket(uint8_t *out, size_t capacity, uint32_t timestamp, const NimBLEUUID &charUUID, const uint8_t *data, size_t length);
+
+ private:
+  NimBLEUUID channels[MaxChannels];
+  uint8_t channelCount;
+};
+
+/**
+ * @brief One notification read back from a sensor trace.
+ */
+struct SensorTracePacket {
+  uint32_t timestamp;
+  NimBLEUUID charUUID;
+  uint8_t sensorId;  // SensorDataFactory id of charUUID
+  uint8_t length;
+  uint8_t data[SensorTraceWriter::MaxPayloadSize];
+};
+
+class SensorTraceReader {
+ public:
+  /**
+   * @param [in] trace A complete trace, header included. Must outlive the reader.
+   * @param [in] length The length of the trace in bytes.
+   */
+  SensorTraceReader(const uint8_t *trace, size_t length);
+
+  /**
+   * @brief Whether the trace starts with a header this reader understands.
+   */
+  bool isValid() const { return this->valid; }
+
+  /**
+   * @brief Read the next notification.
+   * @return False at the end of the trace, or at the first truncated or malformed record.
+   */
+  bool next(SensorTracePacket *packet);
+
+  /**
+   * @brief Go back to the first notification.
+   */
+  void rewind();
+
+ private:
+  struct Channel {
+    NimBLEUUID charUUID;
+    uint8_t sensorId;
+  };
+
+  const uint8_t *trace;
+  size_t length;
+  size_t position;
+  bool valid;
+  Channel channels[SensorTraceWriter::MaxChannels];
+  bool channelDefined[SensorTraceWriter::MaxChannels];
+};
+
+class SensorTraceReplay {
+ public:
+  typedef std::function<void(SensorTracePacket &)> PacketHandler;
+  typedef std::function<void(uint32_t)> SleepFunction;  // Sleep for a number of microseconds.
+
+  SensorTraceReplay(const uint8_t *trace, size_t length) : reader(trace, length) {}
+
+  /**
+   * @brief Feed every notification of the trace to a handler.
+   * @details With a speed and a sleep function the original spacing of the notifications is kept,
+   * scaled down by speed (1000 replays an hour of riding in 3.6 seconds). Without them the trace
+   * is replayed as fast as the handler allows.
+   * @param [in] onPacket Called for every notification, in order.
+   * @param [in] speed How many times faster than real time to replay. 0 for no pacing.
+   * @param [in] sleep Used to pace the replay when speed is not 0.
+   * @return The number of notifications replayed.
+   */
+  size_t run(const PacketHandler &onPacket, float speed = 0, const SleepFunction &sleep = nullptr);
+
+  /**
+   * @brief The time between the first and the last notification of the last run(), in microseconds.
+   */
+  uint64_t getTraceDuration() const { return this->traceDuration; }
+
+ private:
+  SensorTraceReader reader;
+  uint64_t traceDuration = 0;
+};
@@ -0,0 +1,237 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "sensors/FitnessMachineIndoorBikeData.h"
+
+// Byte layouts of the characteristics our BLE server notifies.
+//
+// A layout lists every field a characteristic can carry, in the order the spec puts them:
+//
+//   static constexpr uint8_t FlagsSize;       Bytes of the flags field that starts the packet.
+//   static constexpr uint8_t FieldCount;
+//   static constexpr Field Fields[];          flagBit, presentWhen and byteSize of each field.
+//
+// CharacteristicEncoder picks the fields to send at compile time and derives the flags from them.
+
+/**
+ * @brief Layout of one field of a server characteristic.
+ * @details The field is sent when its flag bit equals presentWhen. Mandatory fields have no flag bit.
+ */
+struct ServerField {
+  static constexpr uint8_t AlwaysPresent = 0xFF;
+
+  uint8_t flagBit;
+  uint8_t presentWhen;
+  uint8_t byteSize;
+};
+
+// Shares the table the decoder reads Indoor Bike Data with.
+struct IndoorBikeDataLayout {
+  typedef FitnessMachineIndoorBikeData::Types Types;
+
+  static constexpr uint8_t FlagsSize                             = 2;
+  static constexpr uint8_t FieldCount                            = FitnessMachineIndoorBikeData::FieldCount;
+  static constexpr const FitnessMachineIndoorBikeData::Field *Fields = FitnessMachineIndoorBikeData::Fields;
+};
+
+struct CyclingPowerMeasurementLayout {
+  enum Types : uint8_t {
+    InstantaneousPower         = 0,
+    PedalPowerBalance          = 1,
+    AccumulatedTorque          = 2,
+    CumulativeWheelRevolutions = 3,
+    LastWheelEventTime         = 4,
+    CumulativeCrankRevolutions = 5,
+    LastCrankEventTime         = 6,
+    MaximumForceMagnitude      = 7,
+    MinimumForceMagnitude      = 8,
+    MaximumTorqueMagnitude     = 9,
+    MinimumTorqueMagnitude     = 10,
+    ExtremeAngles              = 11,
+    TopDeadSpotAngle           = 12,
+    BottomDeadSpotAngle        = 13,
+    AccumulatedEnergy          = 14
+  };
+
+  // A flag that doesn't announce a field: the pedal power balance is that of the left pedal.
+  static constexpr uint32_t PedalPowerBalanceLeft = 0x02;
+
+  static constexpr uint8_t FlagsSize  = 2;
+  static constexpr uint8_t FieldCount = Types::AccumulatedEnergy + 1;
+
+  // https://github.com/oesmith/gatt-xml/blob/master/org.bluetooth.characteristic.cycling_power_measurement.xml
+  static constexpr ServerField Fields[FieldCount] = {
+      {ServerField::AlwaysPresent, 1, 2},  // InstantaneousPower         W
+      {0, 1, 1},                           // PedalPowerBalance          0.5 %
+      {2, 1, 2},                           // AccumulatedTorque          1/32 Nm
+      {4, 1, 4},                           // CumulativeWheelRevolutions
+      {4, 1, 2},                           // LastWheelEventTime         1/2048 s
+      {5, 1, 2},                           // CumulativeCrankRevolutions
+      {5, 1, 2},                           // LastCrankEventTime         1/1024 s
+      {6, 1, 2},                           // MaximumForceMagnitude      N
+      {6, 1, 2},                           // MinimumForceMagnitude      N
+      {7, 1, 2},                           // MaximumTorqueMagnitude     1/32 Nm
+      {7, 1, 2},                           // MinimumTorqueMagnitude     1/32 Nm
+      {8, 1, 3},                           // ExtremeAngles              two 12 bit angles
+      {9, 1, 2},                           // TopDeadSpotAngle           degrees
+      {10, 1, 2},                          // BottomDeadSpotAngle        degrees
+      {11, 1, 2},                          // AccumulatedEnergy          kJ
+  };
+};
+
+struct HeartRateMeasurementLayout {
+  enum Types : uint8_t { HeartRate8 = 0, HeartRate16 = 1, EnergyExpended = 2, RRInterval = 3 };
+
+  static constexpr uint8_t FlagsSize  = 1;
+  static constexpr uint8_t FieldCount = Types::RRInterval + 1;
+
+  // https://github.com/oesmith/gatt-xml/blob/master/org.bluetooth.characteristic.heart_rate_measurement.xml
+  static constexpr ServerField Fields[FieldCount] = {
+      {0, 0, 1},  // HeartRate8      bpm
+      {0, 1, 2},  // HeartRate16     bpm
+      {3, 1, 2},  // EnergyExpended  kJ
+      {4, 1, 2},  // RRInterval      1/1024 s, only the first one
+  };
+};
+
+// Compile-time facts about the fields an encoder sends.
+template <typename Layout, uint8_t... Present>
+struct CharacteristicFields;
+
+template <typename Layout>
+struct CharacteristicFields<Layout> {
+  static constexpr bool contains(uint8_t) { return false; }
+  static constexpr bool ordered(int) { return true; }
+  static constexpr size_t size() { return 0; }
+  static constexpr size_t offsetOf(uint8_t) { return Layout::FlagsSize; }
+  static constexpr uint32_t presentFlags() { return 0; }
+};
+
+template <typename Layout, uint8_t First, uint8_t... Rest>
+struct CharacteristicFields<Layout, First, Rest...> {
+  typedef CharacteristicFields<Layout, Rest...> Tail;
+
+  static constexpr bool contains(uint8_t type) { return type == First || Tail::contains(type); }
+  static constexpr bool ordered(int previous) { return First < Layout::FieldCount && First > previous && Tail::ordered(First); }
+  static constexpr size_t size() { return Layout::Fields[First].byteSize + Tail::size(); }
+  // The flags are followed by every sent field that precedes type.
+  static constexpr size_t offsetOf(uint8_t type) { return (First < type ? Layout::Fields[First].byteSize : 0) + Tail::offsetOf(type); }
+  // Flag bits set by sending a field.
+  static constexpr uint32_t presentFlags() {
+    return (Layout::Fields[First].flagBit != ServerField::AlwaysPresent && Layout::Fields[First].presentWhen ? 1ul << Layout::Fields[First].flagBit : 0) | Tail::presentFlags();
+  }
+};
+
+// The flags of a set of fields, and whether those fields can be sent together.
+template <typename Layout, typename Fields>
+struct CharacteristicFlags {
+  // Flag bits set by not sending a field that is present when its flag is 0.
+  static constexpr uint32_t absentFlags(uint8_t type) {
+    return type == Layout::FieldCount ? 0
+                                      : (Layout::Fields[type].flagBit != ServerField::AlwaysPresent && !Layout::Fields[type].presentWhen && !Fields::contains(type)
+                                             ? 1ul << Layout::Fields[type].flagBit
+                                             : 0) |
+                                            absentFlags(type + 1);
+  }
+
+  static constexpr uint32_t flags() { return Fields::presentFlags() | absentFlags(0); }
+
+  // Every field of the layout is sent exactly when flags() announces it.
+  static constexpr bool consistent(uint8_t type) {
+    return type == Layout::FieldCount ||
+           ((Layout::Fields[type].flagBit == ServerField::AlwaysPresent ? Fields::contains(type)
+                                                                        : Fields::contains(type) == (((flags() >> Layout::Fields[type].flagBit) & 0x01) == Layout::Fields[type].presentWhen)) &&
+            consistent(type + 1));
+  }
+};
+
+/**
+ * @brief Writes one characteristic packet with a fixed set of fields.
+ * @details Size, field offsets and flags are worked out at compile time, so encoding is a single pass of stores
+ * straight into the packet. Present lists the fields to send, in layout order. Fields that share a flag must be
+ * sent together, and mandatory fields always. Both are checked at compile time.
+ *
+ *   typedef CharacteristicEncoder<HeartRateMeasurementLayout, HeartRateMeasurementLayout::HeartRate8> Encoder;
+ *   uint8_t packet[Encoder::Size];
+ *   Encoder(packet).set<HeartRateMeasurementLayout::HeartRate8>(heartRate);
+ */
+template <typename Layout, uint8_t... Present>
+class CharacteristicEncoder {
+  typedef CharacteristicFields<Layout, Present...> Fields;
+  typedef CharacteristicFlags<Layout, Fields> FieldFlags;
+
+  static_assert(Fields::ordered(-1), "Fields must be listed once each, in layout order");
+  static_assert(FieldFlags::consistent(0), "Fields that share a flag must be sent together, mandatory fields always");
+
+ public:
+  static constexpr uint32_t Flags = FieldFlags::flags();
+  static constexpr size_t Size    = Layout::FlagsSize + Fields::size();
+
+  /**
+   * @brief Start a packet by writing its flags.
+   * @param [out] out At least Size bytes. Every field in Present must be set() before it is sent.
+   * @param [in] extraFlags Flags that don't announce a field, ORed into Flags.
+   */
+  explicit CharacteristicEncoder(uint8_t *out, uint32_t extraFlags = 0) : out(out) { write(out, Layout::FlagsSize, Flags | extraFlags); }
+
+  /**
+   * @brief Write a field.
+   * @tparam Type The field, one of Present.
+   * @param [in] raw The value in the unit of the spec, truncated to the size of the field.
+   */
+  template <uint8_t Type>
+  CharacteristicEncoder &set(int32_t raw) {
+    static_assert(Fields::contains(Type), "Field is not part of this encoder");
+    write(&this->out[Fields::offsetOf(Type)], Layout::Fields[Type].byteSize, raw);
+    return *this;
+  }
+
+ private:
+  uint8_t *out;
+
+  static void write(uint8_t *data, uint8_t byteSize, uint32_t value) {
+    for (uint8_t i = 0; i < byteSize; i++) {
+      data[i] = static_cast<uint8_t>(value >> (i * 8));
+    }
+  }
+};
+
+template <typename Layout, uint8_t... Present>
+constexpr uint32_t CharacteristicEncoder<Layout, Present...>::Flags;
+template <typename Layout, uint8_t... Present>
+constexpr size_t CharacteristicEncoder<Layout, Present...>::Size;
+
+// What our server sends.
+typedef CharacteristicEncoder<IndoorBikeDataLayout, IndoorBikeDataLayout::Types::InstantaneousSpeed, IndoorBikeDataLayout::Types::InstantaneousCadence,
+                              IndoorBikeDataLayout::Types::InstantaneousPower, IndoorBikeDataLayout::Types::HeartRate>
+    IndoorBikeDataEncoder;
+typedef CharacteristicEncoder<CyclingPowerMeasurementLayout, CyclingPowerMeasurementLayout::InstantaneousPower, CyclingPowerMeasurementLayout::PedalPowerBalance,
+                              CyclingPowerMeasurementLayout::CumulativeCrankRevolutions, CyclingPowerMeasurementLayout::LastCrankEventTime>
+    CyclingPowerMeasurementEncoder;
+typedef CharacteristicEncoder<HeartRateMeasurementLayout, HeartRateMeasurementLayout::HeartRate8> HeartRateMeasurementEncoder;
+
+// Each writes a packet of the matching encoder's Size to out and returns that size.
+
+/**
+ * @brief FTMS Indoor Bike Data with speed, cadence, power and heart rate.
+ * @details Speed is estimated from cadence when it is not known (speed <= 0).
+ */
+size_t encodeIndoorBikeData(uint8_t *out, float cadence, int watts, int heartRate, float speed);
+
+/**
+ * @brief Cycling Power Measurement with power and crank revolution data.
+ */
+size_t encodeCyclingPowerMeasurement(uint8_t *out, int watts, int cumulativeCrankRevolutions, int lastCrankEventTime);
+
+/**
+ * @brief Heart Rate Measurement with an 8 bit heart rate.
+ */
+size_t encodeHeartRateMeasurement(uint8_t *out, int heartRate);
@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#ifdef ARDUINO
+#include <esp_attr.h>
+#else
+#define IRAM_ATTR
+#endif
+
+/**
+ * @brief Turns queued moves into step and direction pin levels, one timer tick at a time.
+ * @details A task pushes segments of steps at a constant rate, and a hardware timer interrupt calls tick()
+ * TickRate times a second while there is work. Each tick adds the segment's rate to a 32 bit phase, and
+ * a step is sent whenever the phase wraps, so the average rate is exact and each edge lands on a tick.
+ * Segments follow each other without a gap and the phase carries over, so speed changes are smooth.
+ * A step pulse is high for one tick. Direction changes wait one tick before the next step.
+ *
+ * Exactly one task may call push() and only the timer interrupt may call tick(). tick() calls nothing that
+ * lives in flash, so it keeps running while SPIFFS is written.
+ */
+class StepGenerator {
+ public:
+  static constexpr uint32_t TickRate    = 50000;         // Hz
+  static constexpr uint32_t MaxStepRate = TickRate / 2;  // steps/s, a pulse needs a high and a low tick
+  static constexpr size_t QueueLength   = 8;             // Segments, a power of two
+
+  static constexpr uint8_t StepPin      = 0x01;  // Bits of tick()'s result
+  static constexpr uint8_t DirectionPin = 0x02;  // Set while moving to higher positions
+
+  StepGenerator();
+
+  /**
+   * @brief Queue a move at a constant rate after the ones already queued.
+   * @param [in] steps The steps to move, negative towards lower positions.
+   * @param [in] rate The step rate in steps/s. Limited to MaxStepRate.
+   * @return False if the queue was full and nothing was queued.
+   */
+  bool push(int32_t steps, uint32_t rate);
+
+  /**
+   * @brief Advance by one timer tick.
+   * @return The levels to drive the step and direction pins to, StepPin and DirectionPin set for high.
+   */
+  uint8_t IRAM_ATTR tick();
+
+  /**
+   * @brief Whether a segment is being stepped or waits in the queue.
+   */
+  bool isBusy() const { return this->running.load(std::memory_order_acquire) || this->getQueued() > 0; }
+
+  /**
+   * @brief Get the number of segments waiting in the queue.
+   */
+  size_t getQueued() const { return this->tail.load(std::memory_order_acquire) - this->head.load(std::memory_order_acquire); }
+
+  /**
+   * @brief Get the position after the steps sent so far.
+   */
+  int32_t getPosition() const { return this->position.load(std::memory_order_relaxed); }
+
+  /**
+   * @brief Move the position without stepping, to correct it. Only while not busy, as tick() updates it too.
+   */
+  void shiftPosition(int32_t steps) { this->position.fetch_add(steps, std::memory_order_relaxed); }
+
+ private:
+  struct Segment {
+    uint32_t steps;
+    uint32_t increment;  // Phase added per tick, 2^32 for a step every tick
+    bool direction;
+  };
+
+  Segment segments[QueueLength];
+  std::atomic<size_t> head;
+  std::atomic<size_t> tail;
+  std::atomic<bool> running;
+  std::atomic<int32_t> position;
+
+  // Owned by tick()
+  uint32_t remaining = 0;
+  uint32_t increment = 0;
+  uint32_t phase     = 0;
+  bool direction     = true;
+  bool pulseHigh     = false;
+};
@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * @brief Checks the stepper position we count against the TMC2208's microstep counter, MSCNT.
+ * @details MSCNT moves round its 1024 counts by 256 / microsteps per step the driver takes, so between two
+ * readings at rest it tells how far the driver really went, give or take whole turns of the counter. Which
+ * way it counts depends on the wiring, so that is worked out from the first move long enough to tell. Each
+ * reading becomes the reference for the next, so drift is reported once. It can't see steps the motor skips
+ * under load, as the driver counts those too.
+ */
+class StepReconciler {
+ public:
+  static constexpr uint16_t CounterRange      = 1024;
+  static constexpr uint16_t CalibrationCounts = 64;  // Counts moved before the counting direction is trusted
+
+  struct Metrics {
+    uint32_t checks;
+    uint32_t skipped;  // Readings taken while the stepper moved
+    uint32_t corrections;
+    int32_t lastDrift;    // steps
+    uint32_t totalDrift;  // steps either way
+    int8_t direction;     // MSCNT counts per step sign, 0 until known
+  };
+
+  explicit StepReconciler(uint16_t countsPerStep = 1);
+
+  /**
+   * @brief Set the MSCNT counts per step, 256 / microsteps. Starts over.
+   */
+  void setCountsPerStep(uint16_t countsPerStep);
+
+  /**
+   * @brief Compare a reading taken at rest with the position.
+   * @param [in] mscnt The driver's MSCNT.
+   * @param [in] position The position after the steps sent so far.
+   * @return How many steps further the driver went than the position says, to be added to it.
+   */
+  int32_t update(uint16_t mscnt, int32_t position);
+
+  /**
+   * @brief Compare a reading with the positions read just before and after it.
+   * @details A move that starts between reading the position and MSCNT leaves steps in MSCNT that the
+   * position doesn't have, and they would look like drift. Unless both positions agree and the stepper
+   * was idle throughout, the reading is counted in skipped and otherwise ignored.
+   * @param [in] mscnt The driver's MSCNT.
+   * @param [in] before The position read before MSCNT.
+   * @param [in] after The position read after MSCNT.
+   * @param [in] busy Whether the stepper was busy at either position read.
+   * @return How many steps further the driver went than the position says, to be added to it.
+   */
+  int32_t update(uint16_t mscnt, int32_t before, int32_t after, bool busy);
+
+  const Metrics &getMetrics() const { return this->metrics; }
+
+ private:
+  uint16_t countsPerStep;
+  Metrics metrics           = {};
+  bool referenced           = false;
+  uint16_t referenceCount   = 0;
+  int32_t referencePosition = 0;
+
+  int32_t countsOff(uint16_t mscnt, int32_t moved, int8_t direction) const;
+};
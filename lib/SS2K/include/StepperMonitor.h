@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * @brief Watches the TMC2208 stepper driver through its DRV_STATUS register and schedules its current.
+ * @details The run and hold currents are given as a percentage of the configured ones. While the driver warns
+ * of overtemperature both are cut a step at a time, and they come back a step at a time once it has been cool
+ * for a while. After a long hold the hold current alone is cut further, and it is restored as soon as the
+ * stepper moves. Times are in milliseconds.
+ */
+class StepperMonitor {
+ public:
+  struct Limits {
+    uint8_t thermalStep;           // % of current cut or restored at a time
+    uint32_t thermalStepInterval;  // Between steps
+    uint8_t minCurrent;            // % the thermal cuts stop at
+    uint32_t coolDownTime;         // Without a warning before the current is restored
+    uint8_t longHoldCurrent;       // % of the hold current after a long hold
+    uint32_t longHoldTime;
+  };
+
+  /**
+   * @brief The flags and current scale in DRV_STATUS.
+   */
+  struct Status {
+    bool overtemperatureWarning;  // Above 120 C, or the driver's pre-warning
+    bool overtemperature;         // Shut down until it cools
+    bool shortToGround;
+    bool shortToSupply;
+    bool openLoad;  // Only meaningful while moving
+    bool standstill;
+    uint8_t currentScale;  // CS_ACTUAL, 0-31
+    uint8_t temperature;   // Highest threshold passed: 0, 120, 143, 150 or 157 C
+  };
+
+  struct Metrics {
+    uint32_t polls;
+    uint32_t failedPolls;  // UART errors
+    uint32_t warnings;     // Polls with an overtemperature warning
+    uint32_t overtemperatures;
+    uint32_t shorts;
+    uint32_t openLoads;  // While moving
+    uint32_t thermalCuts;
+    uint32_t lastStatus;  // Raw DRV_STATUS
+    uint8_t runCurrent;   // % of the configured current
+    uint8_t holdCurrent;
+  };
+
+  explicit StepperMonitor(const Limits &limits);
+
+  /**
+   * @brief Decode DRV_STATUS.
+   */
+  static Status decode(uint32_t drvStatus);
+
+  /**
+   * @brief Take in a DRV_STATUS reading.
+   * @param [in] drvStatus The register.
+   * @param [in] moving Whether the stepper has been moving since the last poll.
+   * @param [in] now The current time.
+   * @return True if the currents to use changed.
+   */
+  bool update(uint32_t drvStatus, bool moving, uint32_t now);
+
+  /**
+   * @brief Count a poll that failed.
+   */
+  void pollFailed() { this->metrics.failedPolls++; }
+
+  /**
+   * @brief Get the run current to use, in % of the configured one.
+   */
+  uint8_t getRunCurrent() const { return this->metrics.runCurrent; }
+
+  /**
+   * @brief Get the hold current to use, in % of the configured one.
+   */
+  uint8_t getHoldCurrent() const { return this->metrics.holdCurrent; }
+
+  const Metrics &getMetrics() const { return this->metrics; }
+
+ private:
+  Limits limits;
+  Metrics metrics   = {};
+  uint8_t thermal   = 100;  // % allowed by temperature
+  bool started      = false;
+  uint32_t lastCut  = 0;  // Or restore
+  uint32_t lastWarm = 0;  // Last warning
+  uint32_t lastMove = 0;
+};
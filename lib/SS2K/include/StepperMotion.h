@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "MotionPlanner.h"
+#include "StepGenerator.h"
+
+/**
+ * @brief The stepper's enable pin and step timer, which StepperMotion drives.
+ * @details While started, the timer calls StepGenerator::tick() StepGenerator::TickRate times a second and
+ * writes the step and direction pins from it.
+ */
+class StepperDriver {
+ public:
+  virtual ~StepperDriver() {}
+
+  /**
+   * @brief Switch the driver's output stage on or off. Off lets the motor cool, but it no longer holds.
+   */
+  virtual void setEnabled(bool enabled) = 0;
+
+  virtual void startTimer() = 0;
+
+  virtual void stopTimer() = 0;
+};
+
+/**
+ * @brief Moves the stepper to a target: plans the motion and queues its steps on the step timer.
+ * @details update() is called every planInterval. It plans the motion a planInterval at a time and queues the
+ * steps of each one as a segment, keeping lookahead ahead of the timer, so a new target is picked up after the
+ * queued segments. The timer only runs while there are steps to send, and the driver is switched off after
+ * disableDelay at rest unless something needs it to hold. Times are in milliseconds.
+ */
+class StepperMotion {
+ public:
+  StepperMotion(StepGenerator &generator, StepperDriver &driver, const MotionPlanner::Limits &limits, uint32_t planInterval, uint32_t lookahead,
+                uint32_t disableDelay);
+
+  /**
+   * @brief Correct the position by some steps, once at rest.
+   */
+  void correct(int32_t steps) { this->drift += steps; }
+
+  /**
+   * @brief Run one planning cycle.
+   * @param [in] target The position to move to.
+   * @param [in] now The current time.
+   * @param [in] hold Whether to keep the driver on at rest.
+   */
+  void update(int32_t target, uint32_t now, bool hold);
+
+  /**
+   * @brief Whether the stepper is at rest on its target with nothing left to send.
+   */
+  bool isSettled() const { return this->planner.isSettled() && !this->generator.isBusy(); }
+
+  const MotionPlanner &getPlanner() const { return this->planner; }
+
+ private:
+  StepGenerator &generator;
+  StepperDriver &driver;
+  MotionPlanner planner;
+  const uint32_t planInterval;
+  const uint32_t lookahead;
+  const uint32_t disableDelay;
+  int32_t commanded     = 0;  // Where the queued steps end
+  uint32_t plannedUntil = 0;
+  uint32_t restingSince = 0;
+  bool started          = false;
+  bool timerRunning     = false;
+  bool enabled          = false;
+  int32_t drift         = 0;  // Correction waiting for the stepper to come to rest
+
+  void setEnabled(bool enabled);
+};
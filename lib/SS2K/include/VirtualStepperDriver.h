@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include "StepperMotion.h"
+
+/**
+ * @brief A StepperDriver for the native build: runs the step timer in virtual time and records the steps.
+ * @details advance() ticks the generator as the hardware timer would, and records each step pulse with the
+ * virtual time of its rising edge. Times are in microseconds.
+ */
+class VirtualStepperDriver : public StepperDriver {
+ public:
+  struct Step {
+    uint32_t time;
+    int8_t direction;  // 1 towards higher positions
+  };
+
+  static constexpr uint32_t PeakWindow = 10000;  // Long enough to average out the timer's tick
+
+  explicit VirtualStepperDriver(StepGenerator &generator) : generator(generator) {}
+
+  void setEnabled(bool enabled) override;
+
+  void startTimer() override { this->timerRunning = true; }
+
+  void stopTimer() override { this->timerRunning = false; }
+
+  /**
+   * @brief Run the step timer up to a time.
+   */
+  void advance(uint32_t until);
+
+  bool isEnabled() const { return this->enabled; }
+
+  const std::vector<Step> &getSteps() const { return this->steps; }
+
+  /**
+   * @brief Get the highest step rate over any PeakWindow, in steps/s.
+   */
+  float getPeakStepRate() const { return this->peakSteps * 1000000.0f / PeakWindow; }
+
+  /**
+   * @brief Get how often consecutive steps changed direction.
+   */
+  uint32_t getReversals() const { return this->reversals; }
+
+  /**
+   * @brief Get how long the timer ran for.
+   */
+  uint64_t getTimerTime() const { return this->timerTime; }
+
+  /**
+   * @brief Get how often the driver was switched on.
+   */
+  uint32_t getEnables() const { return this->enables; }
+
+ private:
+  StepGenerator &generator;
+  std::vector<Step> steps;
+  uint32_t now         = 0;
+  size_t windowStart   = 0;  // First step in the PeakWindow up to the latest
+  uint32_t peakSteps   = 0;
+  uint32_t reversals   = 0;
+  uint32_t enables     = 0;
+  uint64_t timerTime   = 0;
+  bool timerRunning    = false;
+  bool enabled         = false;
+  bool stepHigh        = false;
+};
@@ -11,7 +11,7 @@
 
 class CyclePowerData : public SensorData {
  public:
-  CyclePowerData() : SensorData("CPS"), power() {}
+  CyclePowerData() : SensorData("CPS"), power(), crankEvents(), lastCrankEvent() {}
 
   bool hasHeartRate();
   bool hasCadence();
@@ -23,12 +23,36 @@ class CyclePowerData : public SensorData {
   float getSpeed();
   void decode(uint8_t *data, size_t length);
 
+  /**
+   * @brief The Crank Revolution Data of the last decoded packet, as the power meter sent it.
+   * @param [out] revolutions Cumulative crank revolutions.
+   * @param [out] time Last crank event time, in 1/1024 s.
+   * @return False if the packet had no Crank Revolution Data.
+   */
+  bool getCrankEvent(uint16_t *revolutions, uint16_t *time);
+
  private:
-  int power                   = INT_MIN;
-  float cadence               = nanf("");
-  uint16_t crankRev           = 0;
-  uint16_t lastCrankRev       = 0;
-  uint16_t lastCrankEventTime = 0;
-  uint16_t crankEventTime     = 0;
-  uint8_t missedReadingCount  = 0;
+  /**
+   * @brief A Crank Revolution Data sample. Both counters roll over at 16 bits.
+   */
+  struct CrankEvent {
+    uint16_t revolutions;
+    uint16_t time;  // 1/1024 s
+  };
+
+  static constexpr uint8_t CrankHistorySize      = 8;     // Must be a power of two
+  static constexpr uint16_t CrankWindow          = 2048;  // Cadence is averaged over up to 2 s of events
+  static constexpr uint8_t MissedEventsUntilStop = 2;     // Notifications without a new revolution, on top of one crank period
+  static constexpr float MaxCadence              = 200;
+
+  int power     = INT_MIN;
+  float cadence = nanf("");
+  CrankEvent crankEvents[CrankHistorySize];
+  uint8_t crankEventCount    = 0;
+  uint8_t newestCrankEvent   = 0;
+  uint8_t missedReadingCount = 0;
+  bool hasCrankEvent         = false;
+  CrankEvent lastCrankEvent;
+
+  void addCrankEvent(uint16_t revolutions, uint16_t time);
 };
@@ -27,4 +27,22 @@ class EchelonData : public SensorData {
   float cadence  = nanf("");
   int resistance = INT_MIN;
   int power      = INT_MIN;
+
+  /**
+   * @brief Echelon's power model, power = 7.228958 * 1.090112^resistance * 1.015343^cadence, as two factor tables.
+   * @details Filled once at startup so decode() is two lookups and a multiply instead of two double pow() calls.
+   */
+  struct PowerTable {
+    static constexpr int MaxResistance = 32;
+    static constexpr int MaxCadence    = 255;
+    float resistanceFactor[MaxResistance + 1];
+    float cadenceFactor[MaxCadence + 1];
+
+    PowerTable();
+    static float resistanceTerm(int resistance);
+    static float cadenceTerm(int cadence);
+    int getPower(int resistance, int cadence) const;
+  };
+
+  static const PowerTable powerTable;
 };
@@ -11,11 +11,7 @@
 
 class FitnessMachineIndoorBikeData : public SensorData {
  public:
-  FitnessMachineIndoorBikeData() : SensorData("FTMS") {
-    for (int i = 0; i < FieldCount; i++) {
-      this->values[i] = nan("");
-    }
-  }
+  FitnessMachineIndoorBikeData() : SensorData("FTMS"), values(), presentFields(0) {}
 
   bool hasHeartRate();
   bool hasCadence();
@@ -47,15 +43,95 @@ class FitnessMachineIndoorBikeData : public SensorData {
 
   static constexpr uint8_t FieldCount = Types::RemainingTime + 1;
 
- private:
-  double_t values[FieldCount];
+  /**
+   * @brief Layout of one Indoor Bike Data field.
+   * @details Fields appear in Types order, each only when its flag bit equals presentWhen.
+   */
+  struct Field {
+    uint8_t flagBit;
+    uint8_t presentWhen;
+    uint8_t byteSize;
+    bool isSigned;
+    uint8_t divisor;  // raw / divisor is the value in the unit of the spec (km/h, rpm, W, bpm, ...)
+  };
 
   // https://github.com/oesmith/gatt-xml/blob/master/org.bluetooth.characteristic.indoor_bike_data.xml
-  static uint8_t const flagBitIndices[];
-  static uint8_t const flagEnabledValues[];
-  static size_t const byteSizes[];
-  static uint8_t const signedFlags[];
-  static double_t const resolutions[];
+  static constexpr Field Fields[FieldCount] = {
+      {0, 0, 2, false, 100},  // InstantaneousSpeed   0.01 km/h
+      {1, 1, 2, false, 100},  // AverageSpeed         0.01 km/h
+      {2, 1, 2, false, 2},    // InstantaneousCadence 0.5 rpm
+      {3, 1, 2, false, 2},    // AverageCadence       0.5 rpm
+      {4, 1, 3, false, 1},    // TotalDistance        m
+      {5, 1, 2, true, 1},     // ResistanceLevel
+      {6, 1, 2, true, 1},     // InstantaneousPower   W
+      {7, 1, 2, true, 1},     // AveragePower         W
+      {8, 1, 2, false, 1},    // TotalEnergy          kcal
+      {8, 1, 2, false, 1},    // EnergyPerHour        kcal
+      {8, 1, 1, false, 1},    // EnergyPerMinute      kcal
+      {9, 1, 1, false, 1},    // HeartRate            bpm
+      {10, 1, 1, false, 10},  // MetabolicEquivalent  0.1
+      {11, 1, 2, false, 1},   // ElapsedTime          s
+      {12, 1, 2, false, 1},   // RemainingTime        s
+  };
+
+  /**
+   * @brief Read a single field straight out of an Indoor Bike Data packet.
+   * @details Only the flags and the bytes of the requested field are touched. Reads are bounds checked against length.
+   * @tparam Type The field to read.
+   * @param [in] data The Indoor Bike Data packet.
+   * @param [in] length The length of the packet in bytes.
+   * @param [out] value The raw fixed-point value. Divide by Fields[Type].divisor for the value in spec units.
+   * @return False if the field is not present or the packet is too short to hold it.
+   */
+  template <uint8_t Type>
+  static bool extract(const uint8_t *data, size_t length, int32_t *value) {
+    static_assert(Type < FieldCount, "Unknown Indoor Bike Data field");
+    if (length < 2) {
+      return false;
+    }
+    const uint16_t flags = data[0] | (data[1] << 8);
+    if (!isPresent(flags, Type)) {
+      return false;
+    }
+    const size_t offset = offsetOf(flags, Type);
+    if (offset + Fields[Type].byteSize > length) {
+      return false;
+    }
+    *value = read(&data[offset], Fields[Type].byteSize, Fields[Type].isSigned);
+    return true;
+  }
+
+ private:
+  // Raw fixed-point values, valid where the matching presentFields bit is set.
+  int32_t values[FieldCount];
+  uint16_t presentFields;
+
+  static constexpr bool isPresent(uint16_t flags, uint8_t type) { return ((flags >> Fields[type].flagBit) & 0x01) == Fields[type].presentWhen; }
+
+  // The flags word is followed by every present field that precedes type.
+  static constexpr size_t offsetOf(uint16_t flags, uint8_t type) {
+    return type == 0 ? 2 : offsetOf(flags, type - 1) + (isPresent(flags, type - 1) ? Fields[type - 1].byteSize : 0);
+  }
+
+  static int32_t read(const uint8_t *data, uint8_t byteSize, bool isSigned) {
+    uint32_t value = 0;
+    for (uint8_t i = 0; i < byteSize; i++) {
+      value |= static_cast<uint32_t>(data[i]) << (i * 8);
+    }
+    if (isSigned && ((value >> (byteSize * 8 - 1)) & 0x01)) {
+      value |= ~0u << (byteSize * 8);  // sign extend
+    }
+    return static_cast<int32_t>(value);
+  }
+
+  template <uint8_t Type>
+  void decodeField(const uint8_t *data, size_t length) {
+    if (extract<Type>(data, length, &this->values[Type])) {
+      this->presentFields |= (1 << Type);
+    } else {
+      this->presentFields &= ~(1 << Type);
+    }
+  }
 
-  static int convert(int value, size_t length, uint8_t isSigned);
+  bool isDecoded(uint8_t type) { return (this->presentFields >> type) & 0x01; }
 };
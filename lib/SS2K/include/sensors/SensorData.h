@@ -23,7 +23,7 @@ class SensorData {
    * @brief Get the Id.
    * @return The unique identifier of the sensor.
    */
-  std::string getId();
+  const std::string &getId();
 
   /**
    * @brief Does this sensor have Heartrate data?
@@ -7,29 +7,50 @@
 
 #pragma once
 
-#include <memory>
 #include <NimBLEUUID.h>
-#include <vector>
 #include "sensors/SensorData.h"
+#include "sensors/CyclePowerData.h"
+#include "sensors/EchelonData.h"
+#include "sensors/FitnessMachineIndoorBikeData.h"
+#include "sensors/FlywheelData.h"
+#include "sensors/HeartRateData.h"
 
 class SensorDataFactory {
  public:
   SensorDataFactory() {}
 
-  std::shared_ptr<SensorData> getSensorData(NimBLEUUID characteristicUUID, uint8_t *data, size_t length);
+  /**
+   * @brief The interned identifiers of the sensor characteristics we can decode.
+   */
+  enum Types : uint8_t { CyclePower = 0, HeartRate = 1, FitnessMachineIndoorBike = 2, Flywheel = 3, Echelon = 4, Unknown = 5 };
 
- private:
-  class KnownDevice {
-   public:
-    KnownDevice(NimBLEUUID uuid, std::shared_ptr<SensorData> sensorData) : uuid(uuid), sensorData(sensorData) {}
-    NimBLEUUID getUUID();
-    std::shared_ptr<SensorData> decode(uint8_t *data, size_t length);
+  static constexpr uint8_t TypeCount = Types::Unknown;
 
-   private:
-    NimBLEUUID uuid;
-    std::shared_ptr<SensorData> sensorData;
-  };
+  /**
+   * @brief Map a characteristic UUID to its sensor id.
+   * @details This compares full UUIDs, so call it once per subscription and keep the result.
+   * @param [in] characteristicUUID The UUID of the notifying characteristic.
+   * @return The sensor id, or Types::Unknown if there is no decoder for the characteristic.
+   */
+  static uint8_t getSensorId(const NimBLEUUID &characteristicUUID);
+
+  /**
+   * @brief Decode a packet with the decoder registered for a sensor id.
+   * @details Does not allocate. Unknown ids decode to a sensor that reports no data.
+   * @param [in] sensorId An id returned by getSensorId().
+   * @param [in] data The sensor data.
+   * @param [in] length The length of the data in bytes.
+   * @return The decoder, holding the decoded values until its next packet.
+   */
+  SensorData &getSensorData(uint8_t sensorId, uint8_t *data, size_t length);
 
+  /**
+   * @brief Decode a packet for a characteristic UUID.
+   * @details Convenience for callers that have not interned the UUID. Prefer the sensor id overload on hot paths.
+   */
+  SensorData &getSensorData(const NimBLEUUID &characteristicUUID, uint8_t *data, size_t length);
+
+ private:
   class NullData : public SensorData {
    public:
     NullData() : SensorData("Null") {}
@@ -45,6 +66,13 @@ class SensorDataFactory {
     virtual void decode(uint8_t *data, size_t length);
   };
 
-  std::vector<KnownDevice *> knownDevices;
-  static std::shared_ptr<SensorData> NULL_SENSOR_DATA;
+  CyclePowerData cyclePowerData;
+  HeartRateData heartRateData;
+  FitnessMachineIndoorBikeData fitnessMachineIndoorBikeData;
+  FlywheelData flywheelData;
+  EchelonData echelonData;
+  NullData nullData;
+
+  // Indexed by sensor id.
+  SensorData *const decoders[TypeCount] = {&cyclePowerData, &heartRateData, &fitnessMachineIndoorBikeData, &flywheelData, &echelonData};
 };
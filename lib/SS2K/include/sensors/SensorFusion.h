@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "sensors/SensorDataFactory.h"
+
+/**
+ * @brief Picks one value per metric out of every connected sensor.
+ * @details Each source (a connected sensor) keeps its own latest reading of every metric it reports.
+ * A metric's value comes from the highest-priority source that has reported within the stale timeout,
+ * the freshest one if several share that priority. Sources that go silent expire on their own.
+ */
+class SensorFusion {
+ public:
+  enum Metric : uint8_t { Power = 0, Cadence = 1, HeartRate = 2, Speed = 3 };
+
+  static constexpr uint8_t MetricCount = Metric::Speed + 1;
+  static constexpr uint8_t MaxSources  = 8;
+
+  /**
+   * @param [in] staleTimeout How long a reading is used for, in microseconds.
+   */
+  explicit SensorFusion(uint32_t staleTimeout) : staleTimeout(staleTimeout), readings() {}
+
+  /**
+   * @brief How much a sensor type is trusted for a metric. Higher wins.
+   * @details A crank power meter beats a trainer's power and cadence, a strap beats a trainer's heart rate.
+   */
+  static uint8_t getPriority(uint8_t sensorId, Metric metric);
+
+  /**
+   * @brief Record a reading.
+   * @param [in] source The source, below MaxSources. Usually the client slot of the sensor.
+   * @param [in] sensorId The SensorDataFactory id of the source, which sets its priority.
+   * @param [in] metric The metric read.
+   * @param [in] value The value read.
+   * @param [in] timestamp When it was read, in microseconds.
+   */
+  void update(uint8_t source, uint8_t sensorId, Metric metric, float value, uint32_t timestamp);
+
+  /**
+   * @brief Get the value of a metric.
+   * @param [in] metric The metric.
+   * @param [in] now The current time, in microseconds.
+   * @param [out] value The fused value.
+   * @param [out] source The source the value came from. May be nullptr.
+   * @return False if no source has reported the metric within the stale timeout.
+   */
+  bool get(Metric metric, uint32_t now, float *value, uint8_t *source = nullptr);
+
+  /**
+   * @brief Forget every reading of a source, e.g. when it disconnects.
+   */
+  void removeSource(uint8_t source);
+
+ private:
+  struct Reading {
+    float value;
+    uint32_t timestamp;
+    uint8_t priority;
+    bool valid;
+  };
+
+  uint32_t staleTimeout;
+  Reading readings[MaxSources][MetricCount];
+};
@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "ConnectionManager.h"
+
+// Per role: interval range, latency, supervision timeout and whether 2M PHY is worth asking for.
+// 15 ms is the shortest interval iOS accepts.
+static const ConnectionParameters RoleParameters[] = {
+    {12, 24, 0, 400, true, 0},   // PowerUplink   15-30 ms
+    {40, 80, 0, 400, false, 0},  // SensorUplink  50-100 ms, 1M PHY for range
+    {12, 24, 0, 400, true, 0},   // AppDownlink   15-30 ms
+};
+
+static const size_t AttOverhead     = 3;     // Op code and handle of a notification
+static const size_t L2capOverhead   = 4;     // Length and channel id
+static const uint16_t MaxDataLength = 251;   // Largest link layer payload
+static const uint16_t MinInterval   = 6;     // 7.5 ms
+static const uint16_t MaxTimeout    = 3200;  // 32 s
+
+ConnectionManager::ConnectionManager() : links() {
+  for (Link &link : this->links) {
+    link.connHandle = NoConnection;
+  }
+}
+
+ConnectionParameters ConnectionManager::getParameters(uint8_t role, float notifyRate, size_t largestPayload) {
+  ConnectionParameters parameters = RoleParameters[role <= Roles::AppDownlink ? role : static_cast<uint8_t>(Roles::SensorUplink)];
+
+  if (notifyRate > 0) {
+    // At least two connection events per update, so one lost packet doesn't delay it a whole period.
+    const float rateLimited = 1000.0f / 1.25f / (2 * notifyRate);
+    if (rateLimited < parameters.maxInterval) {
+      parameters.maxInterval = rateLimited > MinInterval ? static_cast<uint16_t>(rateLimited) : MinInterval;
+    }
+    if (parameters.minInterval > parameters.maxInterval) {
+      parameters.minInterval = parameters.maxInterval;
+    }
+  }
+
+  // The spec requires the timeout to exceed (1 + latency) * interval * 2.
+  const uint32_t minimumTimeout = (1 + parameters.latency) * parameters.maxInterval * 125 * 2 / 1000 + 1;
+  if (parameters.supervisionTimeout < minimumTimeout) {
+    parameters.supervisionTimeout = minimumTimeout < MaxTimeout ? minimumTimeout : MaxTimeout;
+  }
+
+  const size_t pdu = largestPayload + AttOverhead + L2capOverhead;
+  if (pdu > DefaultPayload) {
+    parameters.dataLength = pdu < MaxDataLength ? pdu : MaxDataLength;
+  }
+  return parameters;
+}
+
+ConnectionManager::Link *ConnectionManager::find(uint16_t connHandle) {
+  for (Link &link : this->links) {
+    if (link.connHandle == connHandle) {
+      return &link;
+    }
+  }
+  return nullptr;
+}
+
+bool ConnectionManager::addLink(uint16_t connHandle, uint8_t role, uint32_t now) {
+  if (connHandle == NoConnection) {
+    return false;
+  }
+  Link *link = this->find(connHandle);
+  if (link == nullptr) {
+    link = this->find(NoConnection);
+    if (link == nullptr) {
+      return false;
+    }
+  }
+  link->connHandle  = connHandle;
+  link->role        = role;
+  link->pending     = true;
+  link->connectedAt = now;
+  return true;
+}
+
+void ConnectionManager::removeLink(uint16_t connHandle) {
+  Link *link = this->find(connHandle);
+  if (link != nullptr && connHandle != NoConnection) {
+    link->connHandle = NoConnection;
+    link->pending    = false;
+  }
+}
+
+bool ConnectionManager::takePending(uint32_t now, Link *link) {
+  for (Link &candidate : this->links) {
+    if (candidate.connHandle != NoConnection && candidate.pending && now - candidate.connectedAt >= SettleTime) {
+      candidate.pending = false;
+      *link             = candidate;
+      return true;
+    }
+  }
+  return false;
+}
@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "CrankSynthesizer.h"
+#include <math.h>
+
+constexpr uint32_t CrankSynthesizer::PassthroughTimeout;
+
+static const float MicrosPerMinute    = 60000000.0f;
+static const uint32_t MicrosPerSecond = 1000000;
+
+CrankSynthesizer::CrankSynthesizer() {}
+
+// Moves eventTime on to a new time. The remainder carries the fractions of a tick, so many short steps
+// add up to the same time as one long one.
+void CrankSynthesizer::setEventAt(uint32_t at) {
+  const uint64_t scaled = static_cast<uint64_t>(at - this->lastEventAt) * 1024 + this->tickRemainder;
+  this->eventTime += static_cast<uint16_t>(scaled / MicrosPerSecond);
+  this->tickRemainder = scaled % MicrosPerSecond;
+  this->lastEventAt   = at;
+}
+
+void CrankSynthesizer::update(float cadence, uint32_t now) {
+  if (!this->started) {
+    this->started     = true;
+    this->lastUpdate  = now;
+    this->lastEventAt = now;
+    return;
+  }
+  const uint32_t elapsed = now - this->lastUpdate;
+  this->lastUpdate       = now;
+  if (this->isPassthrough(now) || isnan(cadence) || cadence <= 0) {
+    return;
+  }
+
+  this->phase += cadence * elapsed / MicrosPerMinute;
+  if (this->phase < 1) {
+    return;
+  }
+  // Any number of revolutions at once, the last one completed phase revolutions ago.
+  const uint32_t completed = static_cast<uint32_t>(this->phase);
+  this->phase -= completed;
+  uint32_t sinceEvent = static_cast<uint32_t>(this->phase * MicrosPerMinute / cadence);
+  if (sinceEvent > elapsed) {  // Rounding
+    sinceEvent = elapsed;
+  }
+  this->revolutions += completed;
+  this->setEventAt(now - sinceEvent);
+}
+
+void CrankSynthesizer::passthrough(uint16_t revolutions, uint16_t time, uint32_t now) {
+  const bool continuing     = this->isPassthrough(now);
+  this->passing             = true;
+  const uint16_t revs       = revolutions - this->upstreamRevolutions;
+  const uint16_t ticks      = time - this->upstreamTime;
+  this->upstreamRevolutions = revolutions;
+  this->upstreamTime        = time;
+  if (!continuing) {
+    this->upstreamAt = now;
+    return;
+  }
+  if (revs == 0) {  // Repeated event
+    return;
+  }
+  this->upstreamAt = now;
+  this->revolutions += revs;
+  this->eventTime += ticks;
+  // Should the power meter stop sending events, synthesis picks up from here.
+  this->phase         = 0;
+  this->lastEventAt   = now;
+  this->tickRemainder = 0;
+}
+
+bool CrankSynthesizer::isPassthrough(uint32_t now) const { return this->passing && now - this->upstreamAt < PassthroughTimeout; }
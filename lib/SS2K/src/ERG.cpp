@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "ERG.h"
+
+constexpr float ERGController::SettleBand;
+constexpr float ERGController::MinSettleBand;
+constexpr uint32_t ERGController::SettleHold;
+
+ERGController::ERGController(const Gains &gains, const Limits &limits) : gains(gains), limits(limits), metrics() {}
+
+// Continue from the predicted incline, or from the current output moved by the feed-forward towards the target.
+void ERGController::rebase(float watts) {
+  this->integral = 0;
+  this->bias     = this->output;
+  if (!isnan(this->predicted)) {
+    this->bias = fminf(fmaxf(this->predicted, this->limits.minIncline), this->limits.maxIncline);
+  } else if (!isnan(watts)) {
+    this->bias += this->gains.feedForward * this->getSchedule() * (this->metrics.target - watts);
+  }
+}
+
+void ERGController::setTarget(int32_t watts, float incline, uint32_t now, float predictedIncline) {
+  this->metrics.target           = watts;
+  this->metrics.settled          = false;
+  this->metrics.currentOvershoot = 0;
+  this->metrics.steps++;
+  this->stepStart     = now;
+  this->inBand        = false;
+  this->stepDirection = isnan(this->lastWatts) ? 0 : (watts > this->lastWatts ? 1 : -1);
+  this->output        = incline;
+  this->predicted     = predictedIncline;
+  if (!this->gated) {
+    this->rebase(this->lastWatts);
+  }
+}
+
+float ERGController::update(float watts, float cadence, uint32_t now) {
+  const float dt   = this->started ? (now - this->lastUpdate) / 1000000.0f : 0;
+  this->started    = true;
+  this->lastUpdate = now;
+  this->metrics.updates++;
+
+  if (isnan(watts) || isnan(cadence) || cadence < this->limits.minCadence) {
+    this->metrics.gatedUpdates++;
+    this->gated     = true;
+    this->integral  = 0;
+    this->output    = 0;
+    this->lastWatts = watts;
+    return this->output;
+  }
+  if (this->gated) {
+    this->gated     = false;
+    this->lastWatts = watts;  // No derivative kick from the gap
+    this->rebase(watts);
+  }
+
+  const float schedule   = this->getSchedule();
+  const float error      = this->metrics.target - watts;
+  const float derivative = dt > 0 ? (watts - this->lastWatts) / dt : 0;
+  const float integral   = this->integral + this->gains.integral * schedule * error * dt;
+  const float unlimited  = this->bias + this->gains.proportional * schedule * error + integral - this->gains.derivative * schedule * derivative;
+
+  float next          = fminf(fmaxf(unlimited, this->limits.minIncline), this->limits.maxIncline);
+  const float maxStep = this->limits.maxRate * dt;
+  next                = fminf(fmaxf(next, this->output - maxStep), this->output + maxStep);
+  if (next != unlimited) {
+    this->metrics.saturatedUpdates++;
+    // Anti-windup: only integrate what pulls the output back from the limit.
+    if ((unlimited > next) != (error > 0)) {
+      this->integral = integral;
+    }
+  } else {
+    this->integral = integral;
+  }
+
+  this->output    = next;
+  this->lastWatts = watts;
+  this->updateMetrics(watts, now);
+  return this->output;
+}
+
+void ERGController::updateMetrics(float watts, uint32_t now) {
+  if (this->metrics.steps == 0 || this->metrics.settled) {
+    return;
+  }
+  const float past = (watts - this->metrics.target) * this->stepDirection;
+  if (past > this->metrics.currentOvershoot) {
+    this->metrics.currentOvershoot = past;
+  }
+  const float band = fmaxf(MinSettleBand, SettleBand * this->metrics.target);
+  if (fabsf(watts - this->metrics.target) > band) {
+    this->inBand = false;
+    return;
+  }
+  if (!this->inBand) {
+    this->inBand      = true;
+    this->inBandSince = now;
+  }
+  if (now - this->inBandSince >= SettleHold) {
+    this->metrics.settled      = true;
+    this->metrics.settlingTime = this->inBandSince - this->stepStart;
+    this->metrics.overshoot    = this->metrics.currentOvershoot;
+  }
+}
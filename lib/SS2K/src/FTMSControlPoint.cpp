@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "FTMSControlPoint.h"
+
+constexpr size_t FTMSControlPoint::MaxLength;
+constexpr size_t FTMSControlPoint::ResponseSize;
+
+uint8_t FTMSControlPoint::validate(const Command &command) {
+  size_t parameterLength;
+  switch (command.getOpCode()) {
+    case OpCodes::RequestControl:
+    case OpCodes::Reset:
+    case OpCodes::StartOrResume:
+      parameterLength = 0;
+      break;
+    case OpCodes::StopOrPause:
+      parameterLength = 1;  // Stop or pause
+      break;
+    case OpCodes::SetTargetPower:
+      parameterLength = 2;  // sint16 W
+      break;
+    case OpCodes::SetIndoorBikeSimulationParameters:
+      parameterLength = 6;  // Wind speed, grade, crr, cw
+      break;
+    default:
+      return ResultCodes::OpCodeNotSupported;
+  }
+  // Longer is tolerated, some apps pad their writes.
+  return command.length >= 1 + parameterLength ? ResultCodes::Success : ResultCodes::InvalidParameter;
+}
+
+bool FTMSControlPoint::isSuperseded(const Command *batch, size_t count, size_t index) {
+  return batch[index].getOpCode() == OpCodes::SetIndoorBikeSimulationParameters && index + 1 < count &&
+         batch[index + 1].getOpCode() == OpCodes::SetIndoorBikeSimulationParameters && validate(batch[index + 1]) == ResultCodes::Success;
+}
+
+size_t FTMSControlPoint::encodeResponse(uint8_t *out, uint8_t opCode, uint8_t result) {
+  out[0] = OpCodes::ResponseCode;
+  out[1] = opCode;
+  out[2] = result;
+  return ResponseSize;
+}
@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "LinkStats.h"
+
+#include <math.h>
+#include <string.h>
+
+// 4 Hz and 1 Hz sensors land in the 250 and 1000 bins, their misses in the next ones.
+const uint16_t LinkStats::HistogramLimits[HistogramBins - 1] = {100, 250, 500, 1000, 1500, 2500, 5000};
+
+void LinkStats::reset() {
+  this->packets        = 0;
+  this->bytes          = 0;
+  this->decodeFailures = 0;
+  this->decodes        = 0;
+  this->lastTimestamp  = 0;
+  this->maxGap         = 0;
+  this->gapSum         = 0;
+  this->gapSquareSum   = 0;
+  this->decodeTimeSum  = 0;
+  this->maxDecodeTime  = 0;
+  memset(this->histogram, 0, sizeof(this->histogram));
+}
+
+void LinkStats::recordPacket(uint32_t timestamp, size_t length) {
+  if (this->packets > 0) {
+    const uint32_t gap = timestamp - this->lastTimestamp;  // Unsigned, so micros() rollover is fine
+    const uint32_t ms  = gap / 1000;
+    uint8_t bin        = 0;
+    while (bin < HistogramBins - 1 && ms > HistogramLimits[bin]) {
+      bin++;
+    }
+    this->histogram[bin]++;
+    this->gapSum += gap;
+    this->gapSquareSum += static_cast<uint64_t>(ms) * ms;
+    if (gap > this->maxGap) {
+      this->maxGap = gap;
+    }
+  }
+  this->lastTimestamp = timestamp;
+  this->packets++;
+  this->bytes += length;
+}
+
+void LinkStats::recordDecode(uint32_t duration, bool decoded) {
+  this->decodes++;
+  this->decodeTimeSum += duration;
+  if (duration > this->maxDecodeTime) {
+    this->maxDecodeTime = duration;
+  }
+  if (!decoded) {
+    this->decodeFailures++;
+  }
+}
+
+float LinkStats::getMeanGap() const { return this->packets > 1 ? static_cast<float>(this->gapSum) / (this->packets - 1) : 0; }
+
+float LinkStats::getRate() const {
+  const float meanGap = this->getMeanGap();
+  return meanGap > 0 ? 1000000 / meanGap : 0;
+}
+
+float LinkStats::getJitter() const {
+  if (this->packets < 2) {
+    return 0;
+  }
+  const float meanMs   = this->getMeanGap() / 1000;
+  const float variance = static_cast<float>(this->gapSquareSum) / (this->packets - 1) - meanMs * meanMs;
+  return variance > 0 ? sqrtf(variance) * 1000 : 0;
+}
+
+float LinkStats::getMeanDecodeTime() const { return this->decodes > 0 ? static_cast<float>(this->decodeTimeSum) / this->decodes : 0; }
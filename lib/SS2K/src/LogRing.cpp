@@ -0,0 +1,249 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "LogRing.h"
+#include <stdio.h>
+#include <string.h>
+
+constexpr size_t LogRing::Capacity;
+constexpr size_t LogRing::PayloadSize;
+constexpr uint8_t LogRing::NoNewline;
+constexpr uint8_t LogRing::Truncated;
+
+static const char *const IntegerConversions = "diouxXc";
+static const char *const FloatConversions   = "fFeEgGaA";
+
+LogRing::LogRing() : writePosition(0), dropped(0) {
+  for (size_t i = 0; i < Capacity; i++) {
+    this->slots[i].sequence.store(i, std::memory_order_relaxed);
+  }
+}
+
+// Each slot's sequence says whose turn it is: a writer claims position when the slot's sequence is position,
+// and the reader takes it once the writer has set it to position + 1. A writer that finds the sequence behind
+// its position has lapped the reader, so the ring is full.
+LogRing::Record *IRAM_ATTR LogRing::claim(uint32_t &position) {
+  position = this->writePosition.load(std::memory_order_relaxed);
+  while (true) {
+    Slot &slot               = this->slots[position & (Capacity - 1)];
+    const int32_t difference = static_cast<int32_t>(slot.sequence.load(std::memory_order_acquire) - position);
+    if (difference == 0) {
+      if (this->writePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+        return &slot.record;
+      }
+    } else if (difference < 0) {
+      this->dropped.fetch_add(1, std::memory_order_relaxed);
+      return nullptr;
+    } else {
+      position = this->writePosition.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+void IRAM_ATTR LogRing::publish(uint32_t position) { this->slots[position & (Capacity - 1)].sequence.store(position + 1, std::memory_order_release); }
+
+bool LogRing::read(Record &record) {
+  Slot &slot = this->slots[this->readPosition & (Capacity - 1)];
+  if (slot.sequence.load(std::memory_order_acquire) != this->readPosition + 1) {
+    return false;
+  }
+  record = slot.record;
+  slot.sequence.store(this->readPosition + Capacity, std::memory_order_release);
+  this->readPosition++;
+  return true;
+}
+
+bool LogRing::logText(uint32_t time, uint8_t level, uint8_t flags, const char *text) {
+  static const size_t ChunkSize = PayloadSize - 2;  // Less the type and terminator
+  const size_t length           = strlen(text);
+  size_t offset                 = 0;
+  bool queued                   = true;
+  do {
+    char chunk[ChunkSize + 1];
+    const size_t chunkLength = length - offset < ChunkSize ? length - offset : ChunkSize;
+    memcpy(chunk, text + offset, chunkLength);
+    chunk[chunkLength] = '\0';
+    offset += chunkLength;
+    if (!this->log(time, level, offset < length ? NoNewline : flags, "%s", chunk)) {
+      queued = false;
+    }
+  } while (offset < length);
+  return queued;
+}
+
+void IRAM_ATTR LogRing::put(Record &record, uint8_t type, const void *value, size_t size) {
+  // Once an argument is left out the rest are too, so they still line up with the format.
+  if ((record.flags & Truncated) || record.size + 1 + size > PayloadSize) {
+    record.flags |= Truncated;
+    return;
+  }
+  const uint8_t *bytes          = static_cast<const uint8_t *>(value);
+  record.payload[record.size++] = type;
+  for (size_t i = 0; i < size; i++) {
+    record.payload[record.size++] = bytes[i];
+  }
+}
+
+void IRAM_ATTR LogRing::putString(Record &record, const char *value) {
+  if ((record.flags & Truncated) || record.size + 2u > PayloadSize) {
+    record.flags |= Truncated;
+    return;
+  }
+  if (value == nullptr) {
+    value = "(null)";
+  }
+  record.payload[record.size++] = Text;
+  while (*value != '\0' && record.size < PayloadSize - 1) {
+    record.payload[record.size++] = *value++;
+  }
+  record.payload[record.size++] = '\0';
+  if (*value != '\0') {
+    record.flags |= Truncated;
+  }
+}
+
+void IRAM_ATTR LogRing::putBytes(Record &record, const Hex &value) {
+  if ((record.flags & Truncated) || record.size + 2u > PayloadSize) {
+    record.flags |= Truncated;
+    return;
+  }
+  size_t length = PayloadSize - record.size - 2;  // Less the type and length
+  if (value.length > length) {
+    record.flags |= Truncated;
+  } else {
+    length = value.length;
+  }
+  record.payload[record.size++] = Bytes;
+  record.payload[record.size++] = length;
+  for (size_t i = 0; i < length; i++) {
+    record.payload[record.size++] = value.data[i];
+  }
+}
+
+size_t LogRing::format(const Record &record, char *text, size_t size) {
+  if (size == 0) {
+    return 0;
+  }
+  size_t length      = 0;
+  size_t offset      = 0;  // Into the payload
+  const char *cursor = record.format != nullptr ? record.format : "";
+  while (*cursor != '\0' && length + 1 < size) {
+    if (*cursor != '%') {
+      text[length++] = *cursor++;
+      continue;
+    }
+    if (cursor[1] == '%') {
+      text[length++] = '%';
+      cursor += 2;
+      continue;
+    }
+
+    // The flags, width and precision are kept. The length and conversion follow the argument's type.
+    const char *start = cursor++;
+    char spec[24]     = "%";
+    size_t specLength = 1;
+    while (*cursor != '\0' && (strchr("-+ #0.", *cursor) != nullptr || (*cursor >= '0' && *cursor <= '9')) && specLength < sizeof(spec) - 4) {
+      spec[specLength++] = *cursor++;
+    }
+    while (*cursor != '\0' && strchr("hlLqjzt", *cursor) != nullptr) {
+      cursor++;
+    }
+    char conversion = *cursor;
+    if (conversion != '\0') {
+      cursor++;
+    }
+    if (offset >= record.size) {
+      // No argument for it. Print the conversion as written.
+      while (start < cursor && length + 1 < size) {
+        text[length++] = *start++;
+      }
+      continue;
+    }
+
+    const bool integer = conversion != '\0' && strchr(IntegerConversions, conversion) != nullptr;
+    char *out          = text + length;
+    const size_t space = size - length;
+    int written        = 0;
+    switch (record.payload[offset++]) {
+      case Int: {
+        int32_t value;
+        memcpy(&value, record.payload + offset, sizeof(value));
+        offset += sizeof(value);
+        spec[specLength++] = integer ? conversion : 'd';
+        spec[specLength]   = '\0';
+        written            = snprintf(out, space, spec, static_cast<int>(value));
+        break;
+      }
+      case UnsignedInt: {
+        uint32_t value;
+        memcpy(&value, record.payload + offset, sizeof(value));
+        offset += sizeof(value);
+        spec[specLength++] = integer ? conversion : 'u';
+        spec[specLength]   = '\0';
+        written            = snprintf(out, space, spec, static_cast<unsigned int>(value));
+        break;
+      }
+      case LongLong:
+      case UnsignedLongLong: {
+        const bool isSigned = record.payload[offset - 1] == LongLong;
+        long long value;
+        memcpy(&value, record.payload + offset, sizeof(value));
+        offset += sizeof(value);
+        spec[specLength++] = 'l';
+        spec[specLength++] = 'l';
+        spec[specLength++] = integer && conversion != 'c' ? conversion : (isSigned ? 'd' : 'u');
+        spec[specLength]   = '\0';
+        written            = snprintf(out, space, spec, value);
+        break;
+      }
+      case Double: {
+        double value;
+        memcpy(&value, record.payload + offset, sizeof(value));
+        offset += sizeof(value);
+        spec[specLength++] = (conversion != '\0' && strchr(FloatConversions, conversion) != nullptr) ? conversion : 'g';
+        spec[specLength]   = '\0';
+        written            = snprintf(out, space, spec, value);
+        break;
+      }
+      case Text: {
+        const char *value = reinterpret_cast<const char *>(record.payload + offset);
+        offset += strnlen(value, record.size - offset) + 1;
+        spec[specLength++] = 's';
+        spec[specLength]   = '\0';
+        written            = snprintf(out, space, spec, value);
+        break;
+      }
+      case Pointer: {
+        const void *value;
+        memcpy(&value, record.payload + offset, sizeof(value));
+        offset += sizeof(value);
+        written = snprintf(out, space, "%p", value);
+        break;
+      }
+      case Bytes: {
+        const size_t count = record.payload[offset++];
+        for (size_t i = 0; i < count && written >= 0 && static_cast<size_t>(written) < space; i++) {
+          written += snprintf(out + written, space - written, "%02x ", record.payload[offset + i]);
+        }
+        offset += count;
+        break;
+      }
+      default:
+        offset = record.size;  // Can't tell where the next one starts
+        break;
+    }
+    if (written > 0) {
+      length += static_cast<size_t>(written) < space ? written : space - 1;
+    }
+  }
+  if ((record.flags & Truncated) && length + 4 < size) {
+    memcpy(text + length, "...", 3);
+    length += 3;
+  }
+  text[length] = '\0';
+  return length;
+}
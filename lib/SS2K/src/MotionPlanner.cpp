@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "MotionPlanner.h"
+#include <math.h>
+
+static const float ArriveDistance = 0.5f;  // steps
+
+constexpr float MotionPlanner::MaxTimeStep;
+
+MotionPlanner::MotionPlanner(const Limits &limits) : limits(limits) {}
+
+void MotionPlanner::reset(int32_t position) {
+  this->target       = position;
+  this->position     = position;
+  this->velocity     = 0;
+  this->acceleration = 0;
+}
+
+// How far ahead of us a full stop ends, braking as hard as the limits allow from a velocity and acceleration
+// towards the target. Without a jerk limit that's v^2 / 2a. With it the deceleration ramps to a1, held at
+// -maxAcceleration if a1 is beyond it, and back to 0 just as the velocity reaches 0.
+float MotionPlanner::stoppingDistance(float v, float a) const {
+  const float maxAcceleration = this->limits.maxAcceleration;
+  const float j               = this->limits.maxJerk;
+  if (j <= 0) {
+    return v > 0 ? v * v / (2 * maxAcceleration) : 0;
+  }
+
+  float distance = 0;
+  if (v < 0) {
+    // Moving away. Only comes back towards the target if the acceleration towards it outlasts the velocity.
+    if (a <= 0 || v + a * a / (2 * j) <= 0) {
+      return 0;
+    }
+    const float t = (a - sqrtf(a * a + 2 * j * v)) / j;  // Until the velocity turns round
+    distance      = v * t + a * t * t / 2 - j * t * t * t / 6;
+    a -= j * t;
+    v = 0;
+  }
+
+  const float a1 = -sqrtf(j * v + a * a / 2);
+  if (a1 > a) {
+    // Braking harder than needed already. Easing off straight away still stops early.
+    const float t = (-a - sqrtf(fmaxf(0, a * a - 2 * j * v))) / j;
+    return distance + v * t + a * t * t / 2 + j * t * t * t / 6;
+  }
+  const float peak = fmaxf(a1, -maxAcceleration);
+  const float t1   = (a - peak) / j;
+  distance += v * t1 + a * t1 * t1 / 2 - j * t1 * t1 * t1 / 6;
+  v += a * t1 - j * t1 * t1 / 2;
+  if (a1 < -maxAcceleration) {
+    const float t2 = (v - maxAcceleration * maxAcceleration / (2 * j)) / maxAcceleration;
+    distance += v * t2 - maxAcceleration * t2 * t2 / 2;
+    v -= maxAcceleration * t2;
+  }
+  const float t3 = -peak / j;
+  return distance + v * t3 + peak * t3 * t3 / 2 + j * t3 * t3 * t3 / 6;
+}
+
+void MotionPlanner::update(float dt) {
+  while (dt > 0 && !this->isSettled()) {
+    const float step = fminf(dt, MaxTimeStep);
+    this->advance(step);
+    dt -= step;
+  }
+}
+
+// Takes the strongest acceleration towards the target after which we can still stop on it and stay under the
+// maximum velocity, found by bisection as both get harder to meet the more we accelerate.
+void MotionPlanner::advance(float dt) {
+  const float error = this->target - this->position;
+  if (fabsf(error) <= ArriveDistance && fabsf(this->velocity) <= this->limits.maxAcceleration * dt) {
+    this->reset(this->target);
+    return;
+  }
+
+  // Worked out as if the target were ahead.
+  const float direction = error >= 0 ? 1 : -1;
+  const float distance  = error * direction;
+  const float v         = this->velocity * direction;
+  const float a         = this->acceleration * direction;
+  const float j         = this->limits.maxJerk;
+  const float reach     = j > 0 ? j * dt : 2 * this->limits.maxAcceleration;
+
+  // Nothing past what takes the velocity to its limit, so the search resolution isn't spent out there.
+  const float vReach = 2 * this->limits.maxVelocity / dt;
+  float low          = fmaxf(fmaxf(-this->limits.maxAcceleration, a - reach), -vReach);
+  float high         = fminf(fminf(this->limits.maxAcceleration, a + reach), vReach);
+  float nextV     = 0;
+  float travelled = 0;
+  auto feasible   = [&](float next) {
+    // The acceleration ramps to next over the step with a jerk limit, and jumps to it without.
+    const float start = j > 0 ? a : next;
+    nextV             = v + (start + next) / 2 * dt;
+    travelled         = v * dt + (2 * start + next) / 6 * dt * dt;
+    const float peakV = nextV + (j > 0 && next > 0 ? next * next / (2 * j) : 0);
+    return peakV <= this->limits.maxVelocity && travelled + this->stoppingDistance(nextV, next) <= distance;
+  };
+  float next = high;
+  if (!feasible(high)) {
+    for (int i = 0; i < 16; i++) {
+      const float middle = (low + high) / 2;
+      if (feasible(middle)) {
+        low = middle;
+      } else {
+        high = middle;
+      }
+    }
+    next = low;
+    feasible(next);
+  }
+
+  this->acceleration = next * direction;
+  this->velocity     = nextV * direction;
+  this->position += travelled * direction;
+}
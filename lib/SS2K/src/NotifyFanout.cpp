@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "NotifyFanout.h"
+
+NotifyFanout::NotifyFanout() : peers() {
+  for (Peer &peer : this->peers) {
+    peer.connHandle = NoConnection;
+  }
+}
+
+NotifyFanout::Peer *NotifyFanout::find(uint16_t connHandle) {
+  for (Peer &peer : this->peers) {
+    if (peer.connHandle == connHandle) {
+      return &peer;
+    }
+  }
+  return nullptr;
+}
+
+bool NotifyFanout::addPeer(uint16_t connHandle) {
+  if (connHandle == NoConnection) {
+    return false;
+  }
+  Peer *peer = this->find(connHandle);
+  if (peer == nullptr) {
+    peer = this->find(NoConnection);
+    if (peer == nullptr) {
+      return false;
+    }
+  }
+  *peer            = Peer();
+  peer->connHandle = connHandle;
+  return true;
+}
+
+void NotifyFanout::removePeer(uint16_t connHandle) {
+  Peer *peer = this->find(connHandle);
+  if (peer != nullptr && connHandle != NoConnection) {
+    peer->connHandle = NoConnection;
+  }
+}
+
+void NotifyFanout::setSubscribed(uint16_t connHandle, uint8_t channel, bool subscribed) {
+  if (channel >= MaxChannels) {
+    return;
+  }
+  Peer *peer = this->find(connHandle);
+  if (peer == nullptr) {
+    if (!this->addPeer(connHandle)) {
+      return;
+    }
+    peer = this->find(connHandle);
+  }
+  if (subscribed) {
+    peer->subscribed |= 1 << channel;
+  } else {
+    peer->subscribed &= ~(1 << channel);
+  }
+}
+
+uint8_t NotifyFanout::getRecipients(uint8_t channel, uint32_t now, uint16_t *connHandles) {
+  uint8_t count = 0;
+  for (Peer &peer : this->peers) {
+    if (peer.connHandle == NoConnection || channel >= MaxChannels || !((peer.subscribed >> channel) & 0x01)) {
+      continue;
+    }
+    // Signed difference keeps this right across the micros() rollover.
+    if (peer.failureStreak > 0 && static_cast<int32_t>(now - peer.retryAt) < 0) {
+      peer.skipped++;
+      continue;
+    }
+    connHandles[count++] = peer.connHandle;
+  }
+  return count;
+}
+
+void NotifyFanout::recordResult(uint16_t connHandle, bool delivered, uint32_t now) {
+  Peer *peer = this->find(connHandle);
+  if (peer == nullptr || connHandle == NoConnection) {
+    return;
+  }
+  if (delivered) {
+    peer->sent++;
+    peer->failureStreak = 0;
+    return;
+  }
+  peer->failed++;
+  if (peer->failureStreak < UINT8_MAX) {
+    peer->failureStreak++;
+  }
+  uint32_t backoff = MinBackoff;
+  for (uint8_t i = 1; i < peer->failureStreak && backoff < MaxBackoff; i++) {
+    backoff *= 2;
+  }
+  peer->retryAt = now + (backoff < MaxBackoff ? backoff : MaxBackoff);
+}
@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "NotifyScheduler.h"
+
+void NotifyScheduler::setMaxRate(uint8_t channel, float maxRate) {
+  if (channel < MaxChannels) {
+    this->minInterval[channel] = maxRate > 0 ? static_cast<uint32_t>(1000000 / maxRate) : 0;
+  }
+}
+
+uint32_t NotifyScheduler::timeUntilAllowed(uint8_t channel, uint32_t now) const {
+  if (!((this->sent >> channel) & 0x01)) {
+    return 0;
+  }
+  const uint32_t elapsed = now - this->lastSent[channel];
+  return elapsed >= this->minInterval[channel] ? 0 : this->minInterval[channel] - elapsed;
+}
+
+uint8_t NotifyScheduler::takeDue(uint32_t now) {
+  const uint8_t dirty = this->pending.load(std::memory_order_acquire);
+  uint8_t due         = 0;
+  for (uint8_t channel = 0; channel < MaxChannels; channel++) {
+    if (((dirty >> channel) & 0x01) && this->timeUntilAllowed(channel, now) == 0) {
+      due |= 1 << channel;
+      this->lastSent[channel] = now;
+    }
+  }
+  this->sent |= due;
+  // Only clear what we take. A channel marked again since the load is still covered, its send reads the latest values.
+  this->pending.fetch_and(~due, std::memory_order_acq_rel);
+  return due;
+}
+
+uint32_t NotifyScheduler::getTimeUntilDue(uint32_t now) const {
+  const uint8_t dirty = this->pending.load(std::memory_order_acquire);
+  uint32_t wait       = UINT32_MAX;
+  for (uint8_t channel = 0; channel < MaxChannels; channel++) {
+    if ((dirty >> channel) & 0x01) {
+      const uint32_t channelWait = this->timeUntilAllowed(channel, now);
+      if (channelWait < wait) {
+        wait = channelWait;
+      }
+    }
+  }
+  return wait;
+}
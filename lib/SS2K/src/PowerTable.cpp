@@ -0,0 +1,195 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "PowerTable.h"
+#include <math.h>
+#include <os/endian.h>
+
+constexpr uint8_t PowerTable::PositionBins;
+constexpr uint8_t PowerTable::CadenceBins;
+constexpr size_t PowerTable::SerializedSize;
+constexpr uint8_t PowerTable::MatchSamples;
+constexpr float PowerTable::MatchTolerance;
+constexpr float PowerTable::MatchMinWatts;
+
+static const float MinLearnedWeight = 0.5f;   // Of the cells around a lookup that must have learned something
+static const float MinSampleWeight  = 0.25f;  // For a sample to count towards a cell
+
+PowerTable::PowerTable(int32_t minPosition, int32_t positionSpacing, uint8_t minCadence, uint8_t cadenceSpacing)
+    : minPosition(minPosition), positionSpacing(positionSpacing), minCadence(minCadence), cadenceSpacing(cadenceSpacing) {
+  this->clear();
+}
+
+void PowerTable::clear() {
+  for (auto &row : this->cells) {
+    for (Cell &cell : row) {
+      cell = {0, 0};
+    }
+  }
+  this->samples       = 0;
+  this->trusted       = true;
+  this->agreements    = 0;
+  this->disagreements = 0;
+}
+
+bool PowerTable::locate(int32_t position, float cadence, Location *location) const {
+  if (isnan(cadence)) {
+    return false;
+  }
+  const float p = static_cast<float>(position - this->minPosition) / this->positionSpacing;
+  if (p < 0 || p > PositionBins - 1) {
+    return false;
+  }
+  const float c              = fminf(fmaxf((cadence - this->minCadence) / this->cadenceSpacing, 0), CadenceBins - 1);
+  location->position         = p < PositionBins - 2 ? static_cast<uint8_t>(p) : PositionBins - 2;
+  location->cadence          = c < CadenceBins - 2 ? static_cast<uint8_t>(c) : CadenceBins - 2;
+  location->positionFraction = p - location->position;
+  location->cadenceFraction  = c - location->cadence;
+  return true;
+}
+
+// Interpolates one position row across cadence, over the cells that have learned something.
+bool PowerTable::getRowWatts(uint8_t position, const Location &location, float *watts) const {
+  const Cell &low   = this->cells[position][location.cadence];
+  const Cell &high  = this->cells[position][location.cadence + 1];
+  const float lowW  = low.samples > 0 ? 1 - location.cadenceFraction : 0;
+  const float highW = high.samples > 0 ? location.cadenceFraction : 0;
+  if (lowW + highW < MinLearnedWeight) {
+    return false;
+  }
+  *watts = (low.watts * lowW + high.watts * highW) / (lowW + highW);
+  return true;
+}
+
+bool PowerTable::getWatts(int32_t position, float cadence, float *watts) const {
+  Location location;
+  if (!this->locate(position, cadence, &location)) {
+    return false;
+  }
+  float low, high;
+  const bool hasLow  = this->getRowWatts(location.position, location, &low);
+  const bool hasHigh = this->getRowWatts(location.position + 1, location, &high);
+  const float lowW   = hasLow ? 1 - location.positionFraction : 0;
+  const float highW  = hasHigh ? location.positionFraction : 0;
+  if (lowW + highW < MinLearnedWeight) {
+    return false;
+  }
+  *watts = ((hasLow ? low * lowW : 0) + (hasHigh ? high * highW : 0)) / (lowW + highW);
+  return true;
+}
+
+void PowerTable::addSample(int32_t position, float cadence, float watts) {
+  Location location;
+  if (isnan(watts) || !this->locate(position, cadence, &location)) {
+    return;
+  }
+  float predicted;
+  bool hasPrediction = this->getWatts(position, cadence, &predicted);
+  float error        = hasPrediction ? watts - predicted : 0;
+
+  // Check the table's position origin against the sample.
+  if (hasPrediction) {
+    if (fabsf(error) > fmaxf(MatchTolerance * predicted, MatchMinWatts)) {
+      this->agreements = 0;
+      if (++this->disagreements >= MatchSamples) {
+        this->clear();  // Learned somewhere else. Start over from this sample
+        this->discarded++;
+        hasPrediction = false;
+        error         = 0;
+      }
+    } else {
+      this->disagreements = 0;
+      if (++this->agreements >= MatchSamples) {
+        this->trusted = true;
+      }
+    }
+  }
+  if (!this->trusted) {
+    return;
+  }
+
+  for (uint8_t i = 0; i < 4; i++) {
+    const uint8_t dp   = i & 0x01;
+    const uint8_t dc   = i >> 1;
+    Cell &cell         = this->cells[location.position + dp][location.cadence + dc];
+    const float weight   = (dp ? location.positionFraction : 1 - location.positionFraction) * (dc ? location.cadenceFraction : 1 - location.cadenceFraction);
+    if (cell.samples == 0) {
+      if (weight >= MinSampleWeight) {  // First estimate of a cell
+        cell = {watts, 1};
+      }
+      continue;
+    }
+    const float rate = fmaxf(1.0f / (cell.samples + 1), MinLearningRate);
+    cell.watts += rate * weight * error;
+    if (weight >= MinSampleWeight && cell.samples < UINT8_MAX) {
+      cell.samples++;
+    }
+  }
+  this->samples++;
+}
+
+bool PowerTable::getPosition(float watts, float cadence, int32_t *position) const {
+  Location location;
+  if (!this->trusted || isnan(watts) || !this->locate(this->minPosition, cadence, &location)) {
+    return false;
+  }
+  float low;
+  bool hasLow = this->getRowWatts(0, location, &low);
+  for (uint8_t i = 1; i < PositionBins; i++) {
+    float high;
+    const bool hasHigh = this->getRowWatts(i, location, &high);
+    if (hasLow && hasHigh && high > low && watts >= low && watts <= high) {
+      *position = this->minPosition + static_cast<int32_t>(this->positionSpacing * (i - 1 + (watts - low) / (high - low)));
+      return true;
+    }
+    low    = high;
+    hasLow = hasHigh;
+  }
+  return false;
+}
+
+size_t PowerTable::serialize(uint8_t *out, size_t size) const {
+  if (size < SerializedSize) {
+    return 0;
+  }
+  put_le32(&out[0], Magic);
+  put_le32(&out[4], this->minPosition);
+  put_le32(&out[8], this->positionSpacing);
+  out[12]    = this->minCadence;
+  out[13]    = this->cadenceSpacing;
+  out[14]    = PositionBins;
+  out[15]    = CadenceBins;
+  uint8_t *p = &out[HeaderSize];
+  for (const auto &row : this->cells) {
+    for (const Cell &cell : row) {
+      put_le16(p, static_cast<uint16_t>(fminf(fmaxf(cell.watts * 10, 0), UINT16_MAX)));
+      p[2] = cell.samples;
+      p += 3;
+    }
+  }
+  return SerializedSize;
+}
+
+bool PowerTable::deserialize(const uint8_t *data, size_t length) {
+  if (length < SerializedSize || get_le32(&data[0]) != Magic || static_cast<int32_t>(get_le32(&data[4])) != this->minPosition ||
+      static_cast<int32_t>(get_le32(&data[8])) != this->positionSpacing || data[12] != this->minCadence || data[13] != this->cadenceSpacing ||
+      data[14] != PositionBins || data[15] != CadenceBins) {
+    return false;
+  }
+  const uint8_t *p = &data[HeaderSize];
+  for (auto &row : this->cells) {
+    for (Cell &cell : row) {
+      cell = {get_le16(p) / 10.0f, p[2]};
+      p += 3;
+    }
+  }
+  this->samples       = 0;
+  this->trusted       = false;
+  this->agreements    = 0;
+  this->disagreements = 0;
+  return true;
+}
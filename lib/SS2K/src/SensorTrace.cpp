@@ -0,0 +1,166 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "SensorTrace.h"
+
+#include <string.h>
+#include "sensors/SensorDataFactory.h"
+
+static const uint8_t TraceMagic[4] = {'S', 'S', '2', 'T'};
+static const uint8_t ChannelRecord = 'C';
+static const uint8_t NotifyRecord  = 'N';
+
+// Points at the UUID bytes, LSB first, and returns their count.
+static uint8_t uuidBytes(const NimBLEUUID &uuid, const uint8_t **bytes) {
+  const ble_uuid_any_t *native = uuid.getNative();
+  if (native == nullptr) {
+    return 0;
+  }
+  switch (native->u.type) {
+    case BLE_UUID_TYPE_16:
+      *bytes = reinterpret_cast<const uint8_t *>(&native->u16.value);
+      return 2;
+    case BLE_UUID_TYPE_32:
+      *bytes = reinterpret_cast<const uint8_t *>(&native->u32.value);
+      return 4;
+    case BLE_UUID_TYPE_128:
+      *bytes = native->u128.value;
+      return 16;
+    default:
+      return 0;
+  }
+}
+
+size_t SensorTraceWriter::writeHeader(uint8_t *out, size_t capacity) {
+  if (capacity < HeaderSize) {
+    return 0;
+  }
+  memcpy(out, TraceMagic, sizeof(TraceMagic));
+  out[4]             = Version;
+  this->channelCount = 0;
+  return HeaderSize;
+}
+
+size_t SensorTraceWriter::writePacket(uint8_t *out, size_t capacity, uint32_t timestamp, const NimBLEUUID &charUUID, const uint8_t *data, size_t length) {
+  if (length > MaxPayloadSize) {
+    length = MaxPayloadSize;
+  }
+
+  uint8_t channel = 0;
+  while (channel < this->channelCount && this->channels[channel] != charUUID) {
+    channel++;
+  }
+
+  size_t size = 0;
+  if (channel == this->channelCount) {
+    const uint8_t *bytes = nullptr;
+    uint8_t uuidSize     = uuidBytes(charUUID, &bytes);
+    if (uuidSize == 0 || channel == MaxChannels || capacity < 3 + uuidSize + 7 + length) {
+      return 0;
+    }
+    out[size++] = ChannelRecord;
+    out[size++] = channel;
+    out[size++] = uuidSize;
+    memcpy(&out[size], bytes, uuidSize);
+    size += uuidSize;
+    this->channels[this->channelCount++] = charUUID;
+  } else if (capacity < 7 + length) {
+    return 0;
+  }
+
+  out[size++] = NotifyRecord;
+  out[size++] = channel;
+  out[size++] = static_cast<uint8_t>(timestamp);
+  out[size++] = static_cast<uint8_t>(timestamp >> 8);
+  out[size++] = static_cast<uint8_t>(timestamp >> 16);
+  out[size++] = static_cast<uint8_t>(timestamp >> 24);
+  out[size++] = static_cast<uint8_t>(length);
+  memcpy(&out[size], data, length);
+  return size + length;
+}
+
+SensorTraceReader::SensorTraceReader(const uint8_t *trace, size_t length) : trace(trace), length(length) {
+  this->valid = length >= SensorTraceWriter::HeaderSize && memcmp(trace, TraceMagic, sizeof(TraceMagic)) == 0 && trace[4] == SensorTraceWriter::Version;
+  this->rewind();
+}
+
+void SensorTraceReader::rewind() {
+  this->position = SensorTraceWriter::HeaderSize;
+  memset(this->channelDefined, 0, sizeof(this->channelDefined));
+}
+
+bool SensorTraceReader::next(SensorTracePacket *packet) {
+  if (!this->valid) {
+    return false;
+  }
+  while (this->position + 2 <= this->length) {
+    const uint8_t *record  = &this->trace[this->position];
+    const size_t remaining = this->length - this->position;
+    const uint8_t type     = record[0];
+    const uint8_t channel  = record[1];
+    if (channel >= SensorTraceWriter::MaxChannels) {
+      return false;
+    }
+
+    if (type == ChannelRecord) {
+      if (remaining < 3 || remaining < 3u + record[2]) {
+        return false;
+      }
+      NimBLEUUID uuid(&record[3], record[2], false);
+      if (uuid.bitSize() == 0) {
+        return false;
+      }
+      this->channels[channel].charUUID = uuid;
+      this->channels[channel].sensorId = SensorDataFactory::getSensorId(uuid);
+      this->channelDefined[channel]    = true;
+      this->position += 3 + record[2];
+      continue;
+    }
+
+    if (type != NotifyRecord || !this->channelDefined[channel] || remaining < 7 || remaining < 7u + record[6]) {
+      return false;
+    }
+    packet->timestamp = record[2] | (record[3] << 8) | (record[4] << 16) | (static_cast<uint32_t>(record[5]) << 24);
+    packet->charUUID  = this->channels[channel].charUUID;
+    packet->sensorId  = this->channels[channel].sensorId;
+    packet->length    = record[6];
+    memcpy(packet->data, &record[7], packet->length);
+    this->position += 7 + packet->length;
+    return true;
+  }
+  return false;
+}
+
+size_t SensorTraceReplay::run(const PacketHandler &onPacket, float speed, const SleepFunction &sleep) {
+  SensorTracePacket packet;
+  size_t count            = 0;
+  uint32_t lastTimestamp  = 0;
+  double owedMicroseconds = 0;
+  const bool paced        = speed > 0 && sleep;
+  this->traceDuration     = 0;
+
+  this->reader.rewind();
+  while (this->reader.next(&packet)) {
+    if (count > 0) {
+      // Unsigned subtraction keeps this right across the 71 minute micros() rollover.
+      const uint32_t gap = packet.timestamp - lastTimestamp;
+      this->traceDuration += gap;
+      if (paced) {
+        owedMicroseconds += gap / speed;
+        if (owedMicroseconds >= 1) {
+          const uint32_t wait = static_cast<uint32_t>(owedMicroseconds);
+          sleep(wait);
+          owedMicroseconds -= wait;
+        }
+      }
+    }
+    lastTimestamp = packet.timestamp;
+    onPacket(packet);
+    count++;
+  }
+  return count;
+}
@@ -0,0 +1,44 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "ServerEncoders.h"
+
+constexpr const FitnessMachineIndoorBikeData::Field *IndoorBikeDataLayout::Fields;
+constexpr ServerField CyclingPowerMeasurementLayout::Fields[];
+constexpr ServerField HeartRateMeasurementLayout::Fields[];
+
+size_t encodeIndoorBikeData(uint8_t *out, float cadence, int watts, int heartRate, float speed) {
+  int cad = static_cast<int>(cadence * 2);
+
+  int speedRaw = 0;
+  if (speed <= 0) {
+    float gearRatio = 1;
+    speedRaw        = ((cad * 2.75 * 2.08 * 60 * gearRatio) / 10);
+  } else {
+    speedRaw = static_cast<int>(speed * 100);
+  }
+  IndoorBikeDataEncoder(out)
+      .set<IndoorBikeDataLayout::Types::InstantaneousSpeed>(speedRaw)
+      .set<IndoorBikeDataLayout::Types::InstantaneousCadence>(cad)
+      .set<IndoorBikeDataLayout::Types::InstantaneousPower>(watts)
+      .set<IndoorBikeDataLayout::Types::HeartRate>(heartRate);
+  return IndoorBikeDataEncoder::Size;
+}
+
+size_t encodeCyclingPowerMeasurement(uint8_t *out, int watts, int cumulativeCrankRevolutions, int lastCrankEventTime) {
+  CyclingPowerMeasurementEncoder(out, CyclingPowerMeasurementLayout::PedalPowerBalanceLeft)
+      .set<CyclingPowerMeasurementLayout::InstantaneousPower>(watts)
+      .set<CyclingPowerMeasurementLayout::PedalPowerBalance>(0)
+      .set<CyclingPowerMeasurementLayout::CumulativeCrankRevolutions>(cumulativeCrankRevolutions)
+      .set<CyclingPowerMeasurementLayout::LastCrankEventTime>(lastCrankEventTime);
+  return CyclingPowerMeasurementEncoder::Size;
+}
+
+size_t encodeHeartRateMeasurement(uint8_t *out, int heartRate) {
+  HeartRateMeasurementEncoder(out).set<HeartRateMeasurementLayout::HeartRate8>(heartRate);
+  return HeartRateMeasurementEncoder::Size;
+}
@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "StepGenerator.h"
+
+constexpr uint32_t StepGenerator::TickRate;
+constexpr uint32_t StepGenerator::MaxStepRate;
+constexpr size_t StepGenerator::QueueLength;
+constexpr uint8_t StepGenerator::StepPin;
+constexpr uint8_t StepGenerator::DirectionPin;
+
+static_assert((StepGenerator::QueueLength & (StepGenerator::QueueLength - 1)) == 0, "QueueLength must be a power of two");
+
+StepGenerator::StepGenerator() : head(0), tail(0), running(false), position(0) {}
+
+bool StepGenerator::push(int32_t steps, uint32_t rate) {
+  if (steps == 0 || rate == 0) {
+    return true;
+  }
+  const size_t currentTail = this->tail.load(std::memory_order_relaxed);
+  if (currentTail - this->head.load(std::memory_order_acquire) >= QueueLength) {
+    return false;
+  }
+  if (rate > MaxStepRate) {
+    rate = MaxStepRate;
+  }
+  Segment &segment  = this->segments[currentTail & (QueueLength - 1)];
+  segment.steps     = steps < 0 ? -steps : steps;
+  segment.increment = static_cast<uint32_t>((static_cast<uint64_t>(rate) << 32) / TickRate);
+  segment.direction = steps > 0;
+  this->tail.store(currentTail + 1, std::memory_order_release);
+  return true;
+}
+
+uint8_t IRAM_ATTR StepGenerator::tick() {
+  if (this->remaining == 0) {
+    const size_t currentHead = this->head.load(std::memory_order_relaxed);
+    if (currentHead == this->tail.load(std::memory_order_acquire)) {
+      // Out of work. The next move starts a whole step period from now.
+      this->pulseHigh = false;
+      this->phase     = 0;
+      this->running.store(false, std::memory_order_release);
+      return this->direction ? DirectionPin : 0;
+    }
+    const Segment &segment = this->segments[currentHead & (QueueLength - 1)];
+    const bool turning     = segment.direction != this->direction;
+    this->remaining        = segment.steps;
+    this->increment        = segment.increment;
+    this->direction        = segment.direction;
+    this->running.store(true, std::memory_order_release);
+    this->head.store(currentHead + 1, std::memory_order_release);
+    if (turning) {
+      this->pulseHigh = false;
+      this->phase     = 0;
+      return this->direction ? DirectionPin : 0;
+    }
+  }
+
+  const uint8_t pins  = this->direction ? DirectionPin : 0;
+  const uint32_t last = this->phase;
+  this->phase += this->increment;
+  // The phase can't wrap on the tick after a step, as increment is at most 2^31.
+  if (this->pulseHigh) {
+    this->pulseHigh = false;
+    return pins;
+  }
+  if (this->phase >= last) {
+    return pins;
+  }
+  this->pulseHigh = true;
+  this->remaining--;
+  this->position.store(this->position.load(std::memory_order_relaxed) + (this->direction ? 1 : -1), std::memory_order_relaxed);
+  return pins | StepPin;
+}
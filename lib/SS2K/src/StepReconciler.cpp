@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "StepReconciler.h"
+#include <stdlib.h>
+
+constexpr uint16_t StepReconciler::CounterRange;
+constexpr uint16_t StepReconciler::CalibrationCounts;
+
+StepReconciler::StepReconciler(uint16_t countsPerStep) : countsPerStep(countsPerStep) {}
+
+void StepReconciler::setCountsPerStep(uint16_t countsPerStep) {
+  this->countsPerStep = countsPerStep;
+  this->referenced    = false;
+  this->metrics       = {};
+}
+
+// How far MSCNT is from where moving the driver by moved steps from the reference should have left it, in
+// counts from -512 to 511.
+int32_t StepReconciler::countsOff(uint16_t mscnt, int32_t moved, int8_t direction) const {
+  const int32_t expected = this->referenceCount + direction * moved * static_cast<int32_t>(this->countsPerStep);
+  int32_t off            = (static_cast<int32_t>(mscnt) - expected) % CounterRange;
+  if (off < 0) {
+    off += CounterRange;
+  }
+  return off >= CounterRange / 2 ? off - CounterRange : off;
+}
+
+int32_t StepReconciler::update(uint16_t mscnt, int32_t position) {
+  this->metrics.checks++;
+  const int32_t moved = position - this->referencePosition;
+  if (this->referenced && this->metrics.direction == 0) {
+    if (static_cast<uint32_t>(abs(moved)) * this->countsPerStep < CalibrationCounts) {
+      return 0;  // Keep the reference until there's enough of a move
+    }
+    const bool forward  = abs(this->countsOff(mscnt, moved, 1)) < this->countsPerStep;
+    const bool backward = abs(this->countsOff(mscnt, moved, -1)) < this->countsPerStep;
+    if (forward != backward) {
+      this->metrics.direction = forward ? 1 : -1;
+    }
+  }
+  if (!this->referenced || this->metrics.direction == 0) {
+    this->referenced        = true;
+    this->referenceCount    = mscnt;
+    this->referencePosition = position;
+    return 0;
+  }
+
+  // Rounded to whole steps, in the direction positions count.
+  const int32_t off   = this->countsOff(mscnt, moved, this->metrics.direction) * this->metrics.direction;
+  const int32_t half  = this->countsPerStep / 2;
+  const int32_t drift = (off >= 0 ? off + half : off - half) / static_cast<int32_t>(this->countsPerStep);
+  this->referenceCount    = mscnt;
+  this->referencePosition = position + drift;
+  if (drift != 0) {
+    this->metrics.corrections++;
+    this->metrics.lastDrift = drift;
+    this->metrics.totalDrift += abs(drift);
+  }
+  return drift;
+}
+
+int32_t StepReconciler::update(uint16_t mscnt, int32_t before, int32_t after, bool busy) {
+  if (busy || before != after) {
+    this->metrics.skipped++;
+    return 0;
+  }
+  return this->update(mscnt, after);
+}
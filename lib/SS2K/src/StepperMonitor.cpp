@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "StepperMonitor.h"
+
+// DRV_STATUS bits, TMC2208 datasheet section 5.5.3.
+static const uint32_t OvertemperatureWarning = 1UL << 0;
+static const uint32_t Overtemperature        = 1UL << 1;
+static const uint32_t ShortToGroundA         = 1UL << 2;
+static const uint32_t ShortToGroundB         = 1UL << 3;
+static const uint32_t ShortToSupplyA         = 1UL << 4;
+static const uint32_t ShortToSupplyB         = 1UL << 5;
+static const uint32_t OpenLoadA              = 1UL << 6;
+static const uint32_t OpenLoadB              = 1UL << 7;
+static const uint32_t Above120               = 1UL << 8;
+static const uint32_t Above143               = 1UL << 9;
+static const uint32_t Above150               = 1UL << 10;
+static const uint32_t Above157               = 1UL << 11;
+static const uint8_t CurrentScaleShift       = 16;
+static const uint32_t CurrentScaleMask       = 0x1F;
+static const uint32_t Standstill             = 1UL << 31;
+
+StepperMonitor::StepperMonitor(const Limits &limits) : limits(limits) {
+  this->metrics.runCurrent  = 100;
+  this->metrics.holdCurrent = 100;
+}
+
+StepperMonitor::Status StepperMonitor::decode(uint32_t drvStatus) {
+  Status status;
+  status.overtemperatureWarning = drvStatus & (OvertemperatureWarning | Above120);
+  status.overtemperature        = drvStatus & Overtemperature;
+  status.shortToGround          = drvStatus & (ShortToGroundA | ShortToGroundB);
+  status.shortToSupply          = drvStatus & (ShortToSupplyA | ShortToSupplyB);
+  status.openLoad               = drvStatus & (OpenLoadA | OpenLoadB);
+  status.standstill             = drvStatus & Standstill;
+  status.currentScale           = (drvStatus >> CurrentScaleShift) & CurrentScaleMask;
+  status.temperature            = drvStatus & Above157 ? 157 : drvStatus & Above150 ? 150 : drvStatus & Above143 ? 143 : drvStatus & Above120 ? 120 : 0;
+  return status;
+}
+
+bool StepperMonitor::update(uint32_t drvStatus, bool moving, uint32_t now) {
+  const Status status = decode(drvStatus);
+  this->metrics.polls++;
+  this->metrics.lastStatus = drvStatus;
+  if (!this->started) {
+    this->started  = true;
+    this->lastCut  = now;
+    this->lastWarm = now;
+    this->lastMove = now;
+  }
+  if (status.shortToGround || status.shortToSupply) {
+    this->metrics.shorts++;
+  }
+  if (status.openLoad && moving) {
+    this->metrics.openLoads++;
+  }
+  if (status.overtemperature) {
+    this->metrics.overtemperatures++;
+  }
+  if (moving) {
+    this->lastMove = now;
+  }
+
+  // Cut while warm, restore once it has been cool for coolDownTime. A step at most every thermalStepInterval.
+  const bool warm = status.overtemperatureWarning || status.overtemperature;
+  if (warm) {
+    this->metrics.warnings++;
+    this->lastWarm = now;
+  }
+  if (now - this->lastCut >= this->limits.thermalStepInterval) {
+    if (warm && this->thermal > this->limits.minCurrent) {
+      this->thermal = this->thermal - this->limits.minCurrent > this->limits.thermalStep ? this->thermal - this->limits.thermalStep : this->limits.minCurrent;
+      this->lastCut = now;
+      this->metrics.thermalCuts++;
+    } else if (!warm && this->thermal < 100 && now - this->lastWarm >= this->limits.coolDownTime) {
+      this->thermal = 100 - this->thermal > this->limits.thermalStep ? this->thermal + this->limits.thermalStep : 100;
+      this->lastCut = now;
+    }
+  }
+
+  const bool longHold       = now - this->lastMove >= this->limits.longHoldTime;
+  const uint8_t hold        = longHold ? this->thermal * this->limits.longHoldCurrent / 100 : this->thermal;
+  const bool changed        = this->metrics.runCurrent != this->thermal || this->metrics.holdCurrent != hold;
+  this->metrics.runCurrent  = this->thermal;
+  this->metrics.holdCurrent = hold;
+  return changed;
+}
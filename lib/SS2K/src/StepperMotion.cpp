@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "StepperMotion.h"
+#include <math.h>
+#include <stdlib.h>
+
+StepperMotion::StepperMotion(StepGenerator &generator, StepperDriver &driver, const MotionPlanner::Limits &limits, uint32_t planInterval, uint32_t lookahead,
+                             uint32_t disableDelay)
+    : generator(generator), driver(driver), planner(limits), planInterval(planInterval), lookahead(lookahead), disableDelay(disableDelay) {}
+
+void StepperMotion::setEnabled(bool enabled) {
+  if (enabled != this->enabled) {
+    this->enabled = enabled;
+    this->driver.setEnabled(enabled);
+  }
+}
+
+void StepperMotion::update(int32_t target, uint32_t now, bool hold) {
+  if (!this->started) {
+    this->started      = true;
+    this->commanded    = this->generator.getPosition();
+    this->plannedUntil = now;
+    this->restingSince = now;
+    this->planner.reset(this->commanded);
+  }
+  this->planner.setTarget(target);
+
+  if (this->planner.isSettled()) {
+    this->plannedUntil = now;
+    if (this->generator.isBusy()) {
+      return;
+    }
+    if (this->drift != 0) {
+      // Where the driver really is. The planner takes it to the target from there.
+      this->generator.shiftPosition(this->drift);
+      this->commanded += this->drift;
+      this->planner.reset(this->commanded);
+      this->planner.setTarget(target);
+      this->drift = 0;
+    } else {
+      if (this->timerRunning) {
+        this->driver.stopTimer();
+        this->timerRunning = false;
+        this->restingSince = now;
+      }
+      if (!hold && now - this->restingSince > this->disableDelay) {
+        this->setEnabled(false);  // So the stepper can cool
+      }
+      return;
+    }
+  }
+
+  this->setEnabled(true);
+  if (static_cast<int32_t>(this->plannedUntil - now) < 0) {
+    this->plannedUntil = now;  // Starting off, or we fell behind
+  }
+  while (this->plannedUntil - now < this->lookahead && !this->planner.isSettled()) {
+    this->planner.update(this->planInterval / 1000.0f);
+    const int32_t planned = lroundf(this->planner.getPosition());
+    const int32_t steps   = planned - this->commanded;
+    if (this->generator.push(steps, abs(steps) * 1000 / this->planInterval)) {
+      this->commanded = planned;
+    }
+    this->plannedUntil += this->planInterval;
+  }
+  if (!this->timerRunning) {
+    this->driver.startTimer();
+    this->timerRunning = true;
+  }
+}
@@ -0,0 +1,45 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "VirtualStepperDriver.h"
+
+constexpr uint32_t VirtualStepperDriver::PeakWindow;
+
+static const uint32_t TickPeriod = 1000000 / StepGenerator::TickRate;
+
+void VirtualStepperDriver::setEnabled(bool enabled) {
+  if (enabled && !this->enabled) {
+    this->enables++;
+  }
+  this->enabled = enabled;
+}
+
+void VirtualStepperDriver::advance(uint32_t until) {
+  if (!this->timerRunning) {
+    this->now = until;
+    return;
+  }
+  for (; static_cast<int32_t>(until - this->now) > 0; this->now += TickPeriod) {
+    this->timerTime += TickPeriod;
+    const uint8_t pins = this->generator.tick();
+    const bool high    = pins & StepGenerator::StepPin;
+    if (high && !this->stepHigh) {
+      const Step step = {this->now, static_cast<int8_t>(pins & StepGenerator::DirectionPin ? 1 : -1)};
+      if (!this->steps.empty() && step.direction != this->steps.back().direction) {
+        this->reversals++;
+      }
+      this->steps.push_back(step);
+      while (step.time - this->steps[this->windowStart].time >= PeakWindow) {
+        this->windowStart++;
+      }
+      if (this->steps.size() - this->windowStart > this->peakSteps) {
+        this->peakSteps = this->steps.size() - this->windowStart;
+      }
+    }
+    this->stepHigh = high;
+  }
+}
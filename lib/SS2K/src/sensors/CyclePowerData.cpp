@@ -6,6 +6,7 @@
  */
 
 #include "Data.h"
+#include <algorithm>
 #include <os/endian.h>
 #include "sensors/CyclePowerData.h"
 
@@ -25,9 +26,18 @@ int CyclePowerData::getPower() { return this->power; }
 
 float CyclePowerData::getSpeed() { return nanf(""); }
 
+bool CyclePowerData::getCrankEvent(uint16_t *revolutions, uint16_t *time) {
+  if (this->hasCrankEvent) {
+    *revolutions = this->lastCrankEvent.revolutions;
+    *time        = this->lastCrankEvent.time;
+  }
+  return this->hasCrankEvent;
+}
+
 void CyclePowerData::decode(uint8_t *data, size_t length) {
-  uint8_t flags = data[0];
-  int cPos      = 2;  // lowest position cadence could ever be
+  uint8_t flags       = data[0];
+  int cPos            = 2;  // lowest position cadence could ever be
+  this->hasCrankEvent = false;
   // Instanious power is always present. Do that first.
   // first calculate which fields are present. Power is always 2 & 3, cadence
   // can move depending on the flags.
@@ -57,28 +67,62 @@ void CyclePowerData::decode(uint8_t *data, size_t length) {
   }
   if (bitRead(flags, 5)) {
     // Crank Revolution data present, lets process it.
-    this->lastCrankRev       = this->crankRev;
-    this->crankRev           = get_le16(&data[cPos]);
-    this->lastCrankEventTime = this->crankEventTime;
-    this->crankEventTime     = get_le16(&data[cPos + 2]);
-    if (this->crankRev > this->lastCrankRev && this->crankEventTime != this->lastCrankEventTime) {
-      const float crankChange = std::abs(this->crankRev - this->lastCrankRev) * 1024;
-      const float timeElapsed = std::abs(this->crankEventTime - this->lastCrankEventTime);
-      float cadence           = (crankChange / timeElapsed) * 60;
-      if (cadence > 1) {
-        if (cadence > 200) {  // Cadence Error
-          cadence = 0;
-        }
-        this->cadence            = cadence;
-        this->missedReadingCount = 0;
-      } else {
-        this->missedReadingCount++;
-      }
-    } else {                               // the crank rev probably didn't update
-      if (this->missedReadingCount > 2) {  // Require three consecutive readings before setting 0 cadence
-        this->cadence = 0;
-      }
+    this->lastCrankEvent = {get_le16(&data[cPos]), get_le16(&data[cPos + 2])};
+    this->hasCrankEvent  = true;
+    this->addCrankEvent(this->lastCrankEvent.revolutions, this->lastCrankEvent.time);
+  }
+}
+
+// Keeps the last few crank events and averages cadence over the ones within CrankWindow of the newest.
+// All differences are taken in uint16_t, so counter rollover is just another step.
+void CyclePowerData::addCrankEvent(uint16_t revolutions, uint16_t time) {
+  if (this->crankEventCount > 0) {
+    const CrankEvent &newest = this->crankEvents[this->newestCrankEvent];
+    const uint16_t revs      = revolutions - newest.revolutions;
+    const uint16_t ticks     = time - newest.time;
+    if (revs == 0 || ticks == 0) {  // the crank rev probably didn't update
       this->missedReadingCount++;
+      // Allow one crank period (assuming 4 notifications a second) before calling it a stop.
+      const uint8_t allowed = MissedEventsUntilStop + (this->cadence > 0 ? static_cast<uint8_t>(std::min(240 / this->cadence, 240.0f)) : 0);
+      if (this->missedReadingCount > allowed) {
+        this->cadence         = 0;
+        this->crankEventCount = 0;  // The next pedal stroke starts a new history
+      }
+      return;
     }
   }
+
+  this->newestCrankEvent                    = (this->newestCrankEvent + 1) & (CrankHistorySize - 1);
+  this->crankEvents[this->newestCrankEvent] = {revolutions, time};
+  if (this->crankEventCount < CrankHistorySize) {
+    this->crankEventCount++;
+  }
+  this->missedReadingCount = 0;
+  if (this->crankEventCount < 2) {
+    return;
+  }
+
+  // Walk back from the newest event, always taking at least the previous one.
+  const CrankEvent &newest = this->crankEvents[this->newestCrankEvent];
+  uint16_t revs            = 0;
+  uint16_t ticks           = 0;
+  for (uint8_t i = 1; i < this->crankEventCount; i++) {
+    const CrankEvent &older = this->crankEvents[(this->newestCrankEvent - i) & (CrankHistorySize - 1)];
+    const uint16_t span     = newest.time - older.time;
+    if (i > 1 && (span > CrankWindow || span <= ticks)) {  // Outside the window, or so old its time wrapped
+      break;
+    }
+    revs  = newest.revolutions - older.revolutions;
+    ticks = span;
+  }
+
+  const float cadence = revs * (1024.0f * 60) / ticks;
+  if (cadence > MaxCadence) {  // Cadence Error
+    this->cadence          = 0;
+    this->crankEvents[0]   = newest;
+    this->newestCrankEvent = 0;
+    this->crankEventCount  = 1;
+    return;
+  }
+  this->cadence = cadence;
 }
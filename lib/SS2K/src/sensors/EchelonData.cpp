@@ -7,6 +7,28 @@
 
 #include "sensors/EchelonData.h"
 
+const EchelonData::PowerTable EchelonData::powerTable;
+
+float EchelonData::PowerTable::resistanceTerm(int resistance) { return 7.228958f * powf(1.090112f, resistance); }
+
+float EchelonData::PowerTable::cadenceTerm(int cadence) { return powf(1.015343f, cadence); }
+
+EchelonData::PowerTable::PowerTable() {
+  for (int r = 0; r <= MaxResistance; r++) {
+    this->resistanceFactor[r] = resistanceTerm(r);
+  }
+  for (int c = 0; c <= MaxCadence; c++) {
+    this->cadenceFactor[c] = cadenceTerm(c);
+  }
+}
+
+// Values past the tables are computed, they don't happen on a real bike.
+int EchelonData::PowerTable::getPower(int resistance, int cadence) const {
+  const float r = resistance <= MaxResistance ? this->resistanceFactor[resistance] : resistanceTerm(resistance);
+  const float c = cadence <= MaxCadence ? this->cadenceFactor[cadence] : cadenceTerm(cadence);
+  return static_cast<int>(r * c);
+}
+
 bool EchelonData::hasHeartRate() { return false; }
 
 bool EchelonData::hasCadence() { return !std::isnan(this->cadence); }
@@ -40,6 +62,6 @@ void EchelonData::decode(uint8_t *data, size_t length) {
   if (this->cadence == 0 || this->resistance == 0) {
     power = 0;
   } else {
-    power = pow(1.090112, resistance) * pow(1.015343, cadence) * 7.228958;
+    power = powerTable.getPower(this->resistance, static_cast<int>(this->cadence));
   }
 }
@@ -7,4 +7,4 @@
 
 #include "sensors/SensorData.h"
 
-std::string SensorData::getId() { return this->id; }
+const std::string &SensorData::getId() { return this->id; }
@@ -8,44 +8,30 @@
 #include <cmath>
 #include "Constants.h"
 #include "sensors/SensorDataFactory.h"
-#include "sensors/CyclePowerData.h"
-#include "sensors/FlywheelData.h"
-#include "sensors/FitnessMachineIndoorBikeData.h"
-#include "sensors/HeartRateData.h"
-#include "sensors/EchelonData.h"
 
-std::shared_ptr<SensorData> SensorDataFactory::getSensorData(const NimBLEUUID characteristicUUID, uint8_t *data, size_t length) {
-  for (auto &it : SensorDataFactory::knownDevices) {
-    if (it->getUUID() == characteristicUUID) {
-      return it->decode(data, length);
-    }
-  }
-
-  std::shared_ptr<SensorData> sensorData = NULL_SENSOR_DATA;
+uint8_t SensorDataFactory::getSensorId(const NimBLEUUID &characteristicUUID) {
   if (characteristicUUID == CYCLINGPOWERMEASUREMENT_UUID) {
-    sensorData = std::shared_ptr<SensorData>(new CyclePowerData());
+    return Types::CyclePower;
   } else if (characteristicUUID == HEARTCHARACTERISTIC_UUID) {
-    sensorData = std::shared_ptr<SensorData>(new HeartRateData());
+    return Types::HeartRate;
   } else if (characteristicUUID == FITNESSMACHINEINDOORBIKEDATA_UUID) {
-    sensorData = std::shared_ptr<SensorData>(new FitnessMachineIndoorBikeData());
-  } else if (characteristicUUID == FLYWHEEL_UART_SERVICE_UUID) {
-    sensorData = std::shared_ptr<SensorData>(new FlywheelData());
+    return Types::FitnessMachineIndoorBike;
+  } else if (characteristicUUID == FLYWHEEL_UART_TX_UUID || characteristicUUID == FLYWHEEL_UART_SERVICE_UUID) {
+    return Types::Flywheel;
   } else if (characteristicUUID == ECHELON_DATA_UUID) {
-    sensorData = std::shared_ptr<SensorData>(new EchelonData());
-  } else {
-    return NULL_SENSOR_DATA;
+    return Types::Echelon;
   }
-
-  KnownDevice *knownDevice = new KnownDevice(characteristicUUID, sensorData);
-  SensorDataFactory::knownDevices.push_back(knownDevice);
-  return knownDevice->decode(data, length);
+  return Types::Unknown;
 }
 
-NimBLEUUID SensorDataFactory::KnownDevice::getUUID() { return this->uuid; }
+SensorData &SensorDataFactory::getSensorData(uint8_t sensorId, uint8_t *data, size_t length) {
+  SensorData &sensorData = sensorId < TypeCount ? *this->decoders[sensorId] : this->nullData;
+  sensorData.decode(data, length);
+  return sensorData;
+}
 
-std::shared_ptr<SensorData> SensorDataFactory::KnownDevice::decode(uint8_t *data, size_t length) {
-  this->sensorData->decode(data, length);
-  return this->sensorData;
+SensorData &SensorDataFactory::getSensorData(const NimBLEUUID &characteristicUUID, uint8_t *data, size_t length) {
+  return this->getSensorData(getSensorId(characteristicUUID), data, length);
 }
 
 bool SensorDataFactory::NullData::hasHeartRate() { return false; }
@@ -65,5 +51,3 @@ int SensorDataFactory::NullData::getPower() { return INT_MIN; }
 float SensorDataFactory::NullData::getSpeed() { return nanf(""); }
 
 void SensorDataFactory::NullData::decode(uint8_t *data, size_t length) {}
-
-std::shared_ptr<SensorData> SensorDataFactory::NULL_SENSOR_DATA = std::shared_ptr<SensorData>(new NullData());
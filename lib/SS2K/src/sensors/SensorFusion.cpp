@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "sensors/SensorFusion.h"
+
+// Indexed by sensor id, then metric: Power, Cadence, HeartRate, Speed.
+static const uint8_t Priorities[SensorDataFactory::TypeCount][SensorFusion::MetricCount] = {
+    {4, 4, 1, 1},  // CyclePower
+    {1, 1, 4, 1},  // HeartRate
+    {3, 3, 2, 3},  // FitnessMachineIndoorBike
+    {3, 3, 2, 2},  // Flywheel
+    {2, 3, 2, 2},  // Echelon, power is modelled from resistance and cadence
+};
+
+uint8_t SensorFusion::getPriority(uint8_t sensorId, Metric metric) {
+  if (sensorId >= SensorDataFactory::TypeCount || metric >= MetricCount) {
+    return 1;
+  }
+  return Priorities[sensorId][metric];
+}
+
+void SensorFusion::update(uint8_t source, uint8_t sensorId, Metric metric, float value, uint32_t timestamp) {
+  if (source >= MaxSources || metric >= MetricCount) {
+    return;
+  }
+  Reading &reading  = this->readings[source][metric];
+  reading.value     = value;
+  reading.timestamp = timestamp;
+  reading.priority  = getPriority(sensorId, metric);
+  reading.valid     = true;
+}
+
+bool SensorFusion::get(Metric metric, uint32_t now, float *value, uint8_t *source) {
+  if (metric >= MetricCount) {
+    return false;
+  }
+  const Reading *best = nullptr;
+  uint8_t bestSource  = 0;
+  for (uint8_t i = 0; i < MaxSources; i++) {
+    Reading &reading = this->readings[i][metric];
+    if (!reading.valid) {
+      continue;
+    }
+    // Unsigned so a micros() rollover between the reading and now still gives its age.
+    const uint32_t age = now - reading.timestamp;
+    if (age > this->staleTimeout) {
+      reading.valid = false;  // Expire it now, before its age wraps around and looks fresh again.
+      continue;
+    }
+    if (best == nullptr || reading.priority > best->priority || (reading.priority == best->priority && age < now - best->timestamp)) {
+      best       = &reading;
+      bestSource = i;
+    }
+  }
+  if (best == nullptr) {
+    return false;
+  }
+  *value = best->value;
+  if (source != nullptr) {
+    *source = bestSource;
+  }
+  return true;
+}
+
+void SensorFusion::removeSource(uint8_t source) {
+  if (source >= MaxSources) {
+    return;
+  }
+  for (uint8_t metric = 0; metric < MetricCount; metric++) {
+    this->readings[source][metric].valid = false;
+  }
+}
@@ -42,7 +42,7 @@ void bleClientTask(void *pvParameters) {
   for (;;) {
     if (spinBLEClient.doScan && (scanRetries > 0)) {
       scanRetries--;
-      debugDirector("Initiating Scan from Client Task:");
+      SS2K_LOG(BLE_CLIENT, INFO, "Initiating Scan from Client Task:");
       spinBLEClient.scanProcess();
     }
 
@@ -53,7 +53,7 @@ void bleClientTask(void *pvParameters) {
     for (size_t x = 0; x < NUM_BLE_DEVICES; x++) {
       if (spinBLEClient.myBLEDevices[x].doConnect == true) {
         if (spinBLEClient.connectToServer()) {
-          debugDirector("We are now connected to the BLE Server.");
+          SS2K_LOG(BLE_CLIENT, INFO, "We are now connected to the BLE Server.");
         } else {
         }
       }
@@ -62,7 +62,7 @@ void bleClientTask(void *pvParameters) {
 }
 
 bool SpinBLEClient::connectToServer() {
-  debugDirector("Initiating Server Connection");
+  SS2K_LOG(BLE_CLIENT, INFO, "Initiating Server Connection");
   NimBLEUUID serviceUUID;
   NimBLEUUID charUUID;
 
@@ -76,7 +76,7 @@ bool SpinBLEClient::connectToServer() {
         device_number = i;
         break;
       } else {
-        debugDirector("doConnect and client out of alignment. Resetting device slot");
+        SS2K_LOG(BLE_CLIENT, WARNING, "doConnect and client out of alignment. Resetting device slot");
         spinBLEClient.myBLEDevices[i].reset();
         spinBLEClient.serverScan(true);
         return false;
@@ -84,7 +84,7 @@ bool SpinBLEClient::connectToServer() {
     }
   }
   if (myDevice == nullptr) {
-    debugDirector("No Device Found to Connect");
+    SS2K_LOG(BLE_CLIENT, WARNING, "No Device Found to Connect");
     return false;
   }
   // FUTURE - Iterate through an array of UUID's we support instead of all the if checks.
@@ -92,30 +92,30 @@ bool SpinBLEClient::connectToServer() {
     if (myDevice->isAdvertisingService(FLYWHEEL_UART_SERVICE_UUID) && (myDevice->getName() == FLYWHEEL_BLE_NAME)) {
       serviceUUID = FLYWHEEL_UART_SERVICE_UUID;
       charUUID    = FLYWHEEL_UART_TX_UUID;
-      debugDirector("trying to connect to Flywheel Bike");
+      SS2K_LOG(BLE_CLIENT, INFO, "trying to connect to Flywheel Bike");
     } else if (myDevice->isAdvertisingService(CYCLINGPOWERSERVICE_UUID)) {
       serviceUUID = CYCLINGPOWERSERVICE_UUID;
       charUUID    = CYCLINGPOWERMEASUREMENT_UUID;
-      debugDirector("trying to connect to PM");
+      SS2K_LOG(BLE_CLIENT, INFO, "trying to connect to PM");
     } else if (myDevice->isAdvertisingService(FITNESSMACHINESERVICE_UUID)) {
       serviceUUID = FITNESSMACHINESERVICE_UUID;
       charUUID    = FITNESSMACHINEINDOORBIKEDATA_UUID;
-      debugDirector("trying to connect to Fitness machine service");
+      SS2K_LOG(BLE_CLIENT, INFO, "trying to connect to Fitness machine service");
     } else if (myDevice->isAdvertisingService(ECHELON_DEVICE_UUID)) {
       serviceUUID = ECHELON_SERVICE_UUID;
       charUUID    = ECHELON_DATA_UUID;
-      debugDirector("Trying to connect to Echelon Bike");
+      SS2K_LOG(BLE_CLIENT, INFO, "Trying to connect to Echelon Bike");
     } else if (myDevice->isAdvertisingService(HEARTSERVICE_UUID)) {
       serviceUUID = HEARTSERVICE_UUID;
       charUUID    = HEARTCHARACTERISTIC_UUID;
-      debugDirector("Trying to connect to HRM");
+      SS2K_LOG(BLE_CLIENT, INFO, "Trying to connect to HRM");
     } else {
-      debugDirector("Error: No advertised UUID found");
+      SS2K_LOG(BLE_CLIENT, ERROR, "Error: No advertised UUID found");
       spinBLEClient.myBLEDevices[device_number].reset();
       return false;
     }
   } else {
-    debugDirector("Error: Device has no Service UUID");
+    SS2K_LOG(BLE_CLIENT, ERROR, "Error: Device has no Service UUID");
     spinBLEClient.myBLEDevices[device_number].reset();
     spinBLEClient.serverScan(true);
     return false;
@@ -130,12 +130,12 @@ bool SpinBLEClient::connectToServer() {
     //     *  This saves considerable time and power.
     //     *
     pClient = NimBLEDevice::getClientByPeerAddress(myDevice->getAddress());
-    debugDirector("Reusing Client");
+    SS2K_LOG(BLE_CLIENT, INFO, "Reusing Client");
     if (pClient) {
-      debugDirector("Client RSSI " + String(pClient->getRssi()));
-      debugDirector("device RSSI " + String(myDevice->getRSSI()));
+      SS2K_LOG(BLE_CLIENT, DEBUG, "Client RSSI %d", pClient->getRssi());
+      SS2K_LOG(BLE_CLIENT, DEBUG, "device RSSI %d", myDevice->getRSSI());
       if (myDevice->getRSSI() == 0) {
-        debugDirector("no signal detected. abortng.");
+        SS2K_LOG(BLE_CLIENT, WARNING, "no signal detected. abortng.");
         reconnectTries--;
         return false;
       }
@@ -144,7 +144,7 @@ bool SpinBLEClient::connectToServer() {
       if (!pClient->connect(myDevice->getAddress(), true)) {
         Serial.println("Reconnect failed ");
         reconnectTries--;
-        debugDirector(String(reconnectTries) + " left.");
+        SS2K_LOG(BLE_CLIENT, INFO, "%d left.", reconnectTries);
         if (reconnectTries < 1) {
           spinBLEClient.myBLEDevices[device_number].reset();
           spinBLEClient.myBLEDevices[device_number].doConnect = false;
@@ -157,7 +157,7 @@ bool SpinBLEClient::connectToServer() {
       BLERemoteService *pRemoteService = pClient->getService(serviceUUID);
 
       if (pRemoteService == nullptr) {
-        debugDirector("Couldn't find Service");
+        SS2K_LOG(BLE_CLIENT, WARNING, "Couldn't find Service");
         reconnectTries--;
         return false;
       }
@@ -165,26 +165,26 @@ bool SpinBLEClient::connectToServer() {
       pRemoteCharacteristic = pRemoteService->getCharacteristic(charUUID);
 
       if (pRemoteCharacteristic == nullptr) {
-        debugDirector("Couldn't find Characteristic");
+        SS2K_LOG(BLE_CLIENT, WARNING, "Couldn't find Characteristic");
         reconnectTries--;
         return false;
       }
 
       if (pRemoteCharacteristic->canNotify()) {
-        debugDirector("Found " + String(pRemoteCharacteristic->getUUID().toString().c_str()) + " on reconnect.");
+        SS2K_LOG(BLE_CLIENT, INFO, "Found %s on reconnect.", pRemoteCharacteristic->getUUID().toString().c_str());
         reconnectTries = MAX_RECONNECT_TRIES;
         // VV Is this really needed? Shouldn't it just carry over from the previous connection? VV
         spinBLEClient.myBLEDevices[device_number].set(myDevice, pClient->getConnId(), serviceUUID, charUUID);
         spinBLEClient.myBLEDevices[device_number].doConnect = false;
-        pRemoteCharacteristic->subscribe(true, nullptr, true);
+        pRemoteCharacteristic->subscribe(true, notifyCallback, true);
         postConnect(pClient);
         return true;
       } else {
-        debugDirector("Unable to subscribe to notifications");
+        SS2K_LOG(BLE_CLIENT, WARNING, "Unable to subscribe to notifications");
         return false;
       }
     } else {  // We don't already have a client that knows this device, we will check for a client that is disconnected that we can use.
-      debugDirector("No Previous client found");
+      SS2K_LOG(BLE_CLIENT, INFO, "No Previous client found");
       // pClient = NimBLEDevice::getDisconnectedClient();
     }
   }
@@ -192,60 +192,66 @@ bool SpinBLEClient::connectToServer() {
   if (myDevice->haveName()) {
     String t_name = myDevice->getName().c_str();
   }
-  debugDirector("Forming a connection to: " + t_name + " " + String(myDevice->getAddress().toString().c_str()));
+  SS2K_LOG(BLE_CLIENT, INFO, "Forming a connection to: %s %s", t_name.c_str(), myDevice->getAddress().toString().c_str());
   pClient = NimBLEDevice::createClient();
-  debugDirector(" - Created client", false);
+  SS2K_LOG(BLE_CLIENT, DEBUG, " - Created client");
   pClient->setClientCallbacks(new MyClientCallback(), true);
   // Connect to the remove BLE Server.
-  pClient->setConnectionParams(60, 200, 0, 1000);
+  const uint8_t role                    = serviceUUID == HEARTSERVICE_UUID ? ConnectionManager::SensorUplink : ConnectionManager::PowerUplink;
+  const ConnectionParameters parameters = ConnectionManager::getParameters(role, 0, NOTIFY_DATA_MAX_LENGTH);
+  pClient->setConnectionParams(parameters.minInterval, parameters.maxInterval, parameters.latency, parameters.supervisionTimeout);
   /** Set how long we are willing to wait for the connection to complete (seconds), default is 30. */
   pClient->setConnectTimeout(5);
   pClient->connect(myDevice->getAddress());  // if you pass BLEAdvertisedDevice instead of address, it will be recognized type of peer device address (public or private)
-  debugDirector(" - Connected to server", true);
-  debugDirector(" - RSSI " + pClient->getRssi(), true);
+  SS2K_LOG(BLE_CLIENT, INFO, " - Connected to server");
+  if (pClient->isConnected()) {
+    requestLinkLayerFeatures(pClient->getConnId(), parameters);
+  }
+  SS2K_LOG(BLE_CLIENT, DEBUG, " - RSSI %d", pClient->getRssi());
   // Obtain a reference to the service we are after in the remote BLE server.
   BLERemoteService *pRemoteService = pClient->getService(serviceUUID);
   if (pRemoteService == nullptr) {
-    debugDirector("Failed to find service:" + String(serviceUUID.toString().c_str()));
+    SS2K_LOG(BLE_CLIENT, WARNING, "Failed to find service:%s", serviceUUID.toString().c_str());
   } else {
-    debugDirector(" - Found service:" + String(pRemoteService->getUUID().toString().c_str()));
+    SS2K_LOG(BLE_CLIENT, INFO, " - Found service:%s", pRemoteService->getUUID().toString().c_str());
     sucessful++;
 
     // Obtain a reference to the characteristic in the service of the remote BLE server.
     pRemoteCharacteristic = pRemoteService->getCharacteristic(charUUID);
     if (pRemoteCharacteristic == nullptr) {
-      debugDirector("Failed to find our characteristic UUID: " + String(charUUID.toString().c_str()));
+      SS2K_LOG(BLE_CLIENT, WARNING, "Failed to find our characteristic UUID: %s", charUUID.toString().c_str());
     } else {  // need to iterate through these for all UUID's
-      debugDirector(" - Found Characteristic:" + String(pRemoteCharacteristic->getUUID().toString().c_str()));
+      SS2K_LOG(BLE_CLIENT, INFO, " - Found Characteristic:%s", pRemoteCharacteristic->getUUID().toString().c_str());
       sucessful++;
     }
 
     // Read the value of the characteristic.
     if (pRemoteCharacteristic->canRead()) {
       std::string value = pRemoteCharacteristic->readValue();
-      debugDirector("The characteristic value was: " + String(value.c_str()));
+      SS2K_LOG(BLE_CLIENT, DEBUG, "The characteristic value was: %s", value.c_str());
     }
 
     if (pRemoteCharacteristic->canNotify()) {
-      pRemoteCharacteristic->subscribe(true, nullptr, true);
+      pRemoteCharacteristic->subscribe(true, notifyCallback, true);
       reconnectTries = MAX_RECONNECT_TRIES;
       scanRetries    = MAX_SCAN_RETRIES;
     } else {
-      debugDirector("Unable to subscribe to notifications");
+      SS2K_LOG(BLE_CLIENT, WARNING, "Unable to subscribe to notifications");
     }
   }
   if (sucessful > 0) {
-    debugDirector("Sucessful " + String(pRemoteCharacteristic->getUUID().toString().c_str()) + " subscription.");
+    SS2K_LOG(BLE_CLIENT, INFO, "Sucessful %s subscription.", pRemoteCharacteristic->getUUID().toString().c_str());
     spinBLEClient.myBLEDevices[device_number].doConnect = false;
     reconnectTries                                      = MAX_RECONNECT_TRIES;
     spinBLEClient.myBLEDevices[device_number].set(myDevice, pClient->getConnId(), serviceUUID, charUUID);
+    spinBLEClient.linkStats[device_number].reset();  // Kept across reconnects, not across devices
     // vTaskDelay(100 / portTICK_PERIOD_MS); //Give time for connection to finalize.
     removeDuplicates(pClient);
     postConnect(pClient);
     return true;
   }
   reconnectTries--;
-  debugDirector("disconnecting Client");
+  SS2K_LOG(BLE_CLIENT, INFO, "disconnecting Client");
   if (pClient->isConnected()) {
     pClient->disconnect();
   }
@@ -255,6 +261,33 @@ bool SpinBLEClient::connectToServer() {
   return false;
 }
 
+// Keep this short: it runs in the NimBLE host task. Copy the packet and wake the processing task.
+void notifyCallback(BLERemoteCharacteristic *pBLERemoteCharacteristic, uint8_t *pData, size_t length, bool isNotify) {
+  NotifyPacket packet;
+  packet.timestamp    = micros();
+  packet.sensorId     = SensorDataFactory::Types::Unknown;
+  packet.deviceIndex  = -1;
+  packet.disconnected = false;
+  packet.length       = length < NOTIFY_DATA_MAX_LENGTH ? length : NOTIFY_DATA_MAX_LENGTH;
+  memcpy(packet.data, pData, packet.length);
+
+  uint16_t connId = pBLERemoteCharacteristic->getRemoteService()->getClient()->getConnId();
+  for (size_t i = 0; i < NUM_BLE_DEVICES; i++) {
+    if (spinBLEClient.myBLEDevices[i].connectedClientID == connId) {
+      packet.deviceIndex = i;
+      packet.sensorId    = spinBLEClient.myBLEDevices[i].sensorId;
+      break;
+    }
+  }
+  if (packet.sensorId == SensorDataFactory::Types::Unknown) {  // Slot not set() yet, so intern the UUID here.
+    packet.sensorId = SensorDataFactory::getSensorId(pBLERemoteCharacteristic->getUUID());
+  }
+
+  if (spinBLEClient.notifyQueue.push(packet) && BLESensorProcessingTask != nullptr) {
+    xTaskNotifyGive(BLESensorProcessingTask);
+  }
+}
+
 /**  None of these are required as they will be handled by the library with defaults. **
  **                       Remove as you see fit for your needs                        */
 
@@ -263,30 +296,45 @@ void SpinBLEClient::MyClientCallback::onConnect(NimBLEClient *pClient) {
 }
 
 void SpinBLEClient::MyClientCallback::onDisconnect(NimBLEClient *pclient) {
-  debugDirector("Disconnect Called");
+  SS2K_LOG(BLE_CLIENT, INFO, "Disconnect Called");
+
+  // Its readings are dropped by BLESensorProcessing(), which is told the same way as about packets.
+  for (size_t i = 0; i < NUM_BLE_DEVICES; i++) {
+    if (pclient->getPeerAddress() == spinBLEClient.myBLEDevices[i].peerAddress) {
+      NotifyPacket packet;
+      packet.timestamp    = micros();
+      packet.sensorId     = spinBLEClient.myBLEDevices[i].sensorId;
+      packet.deviceIndex  = i;
+      packet.disconnected = true;
+      packet.length       = 0;
+      if (spinBLEClient.notifyQueue.push(packet) && BLESensorProcessingTask != nullptr) {
+        xTaskNotifyGive(BLESensorProcessingTask);
+      }
+    }
+  }
 
   if (spinBLEClient.intentionalDisconnect) {
-    debugDirector("Intentional Disconnect");
+    SS2K_LOG(BLE_CLIENT, INFO, "Intentional Disconnect");
     spinBLEClient.intentionalDisconnect = false;
     return;
   }
   if (!pclient->isConnected()) {
     NimBLEAddress addr = pclient->getPeerAddress();
     // auto addr = BLEDevice::getDisconnectedClient()->getPeerAddress();
-    debugDirector("This disconnected client Address " + String(addr.toString().c_str()));
+    SS2K_LOG(BLE_CLIENT, INFO, "This disconnected client Address %s", addr.toString().c_str());
     for (size_t i = 0; i < NUM_BLE_DEVICES; i++) {
       if (addr == spinBLEClient.myBLEDevices[i].peerAddress) {
         // spinBLEClient.myBLEDevices[i].connectedClientID = BLE_HS_CONN_HANDLE_NONE;
-        debugDirector("Detected " + String(spinBLEClient.myBLEDevices[i].serviceUUID.toString().c_str()) + " Disconnect");
+        SS2K_LOG(BLE_CLIENT, INFO, "Detected %s Disconnect", spinBLEClient.myBLEDevices[i].serviceUUID.toString().c_str());
         spinBLEClient.myBLEDevices[i].doConnect = true;
         if ((spinBLEClient.myBLEDevices[i].charUUID == CYCLINGPOWERMEASUREMENT_UUID) || (spinBLEClient.myBLEDevices[i].charUUID == FITNESSMACHINEINDOORBIKEDATA_UUID) ||
             (spinBLEClient.myBLEDevices[i].charUUID == FLYWHEEL_UART_RX_UUID) || (spinBLEClient.myBLEDevices[i].charUUID == ECHELON_SERVICE_UUID)) {
-          debugDirector("Deregistered PM on Disconnect");
+          SS2K_LOG(BLE_CLIENT, INFO, "Deregistered PM on Disconnect");
           spinBLEClient.connectedPM = false;
           break;
         }
         if ((spinBLEClient.myBLEDevices[i].charUUID == HEARTCHARACTERISTIC_UUID)) {
-          debugDirector("Deregistered HR on Disconnect");
+          SS2K_LOG(BLE_CLIENT, INFO, "Deregistered HR on Disconnect");
           spinBLEClient.connectedHR = false;
           break;
         }
@@ -299,15 +347,15 @@ void SpinBLEClient::MyClientCallback::onDisconnect(NimBLEClient *pclient) {
 /***************** New - Security handled here ********************
 ****** Note: these are the same return values as defaults ********/
 uint32_t SpinBLEClient::MyClientCallback::onPassKeyRequest() {
-  debugDirector("Client PassKeyRequest");
+  SS2K_LOG(BLE_CLIENT, INFO, "Client PassKeyRequest");
   return 123456;
 }
 bool SpinBLEClient::MyClientCallback::onConfirmPIN(uint32_t pass_key) {
-  debugDirector("The passkey YES/NO number: " + String(pass_key));
+  SS2K_LOG(BLE_CLIENT, INFO, "The passkey YES/NO number: %u", pass_key);
   return true;
 }
 
-void SpinBLEClient::MyClientCallback::onAuthenticationComplete(ble_gap_conn_desc desc) { debugDirector("Starting BLE work!"); }
+void SpinBLEClient::MyClientCallback::onAuthenticationComplete(ble_gap_conn_desc desc) { SS2K_LOG(BLE_CLIENT, INFO, "Starting BLE work!"); }
 /*******************************************************************/
 
 /**
@@ -315,7 +363,7 @@ void SpinBLEClient::MyClientCallback::onAuthenticationComplete(ble_gap_conn_desc
  */
 
 void SpinBLEClient::MyAdvertisedDeviceCallback::onResult(BLEAdvertisedDevice *advertisedDevice) {
-  debugDirector("BLE Advertised Device found: " + String(advertisedDevice->toString().c_str()));
+  SS2K_LOG(BLE_CLIENT, DEBUG, "BLE Advertised Device found: %s", advertisedDevice->toString().c_str());
   String aDevName;
   if (advertisedDevice->haveName()) {
     aDevName = String(advertisedDevice->getName().c_str());
@@ -329,27 +377,27 @@ void SpinBLEClient::MyAdvertisedDeviceCallback::onResult(BLEAdvertisedDevice *ad
     // if ((aDevName == c_PM) || (advertisedDevice->getAddress().toString().c_str() == c_PM) || (aDevName == c_HR) || (advertisedDevice->getAddress().toString().c_str() == c_HR) ||
     // (String(c_PM) == ("any")) || (String(c_HR) == ("any"))) { //notice the subtle difference vv getServiceUUID(int) returns the index of the service in the list or the 0 slot if
     // not specified.
-    debugDirector("Matching Device Name: " + aDevName);
+    SS2K_LOG(BLE_CLIENT, DEBUG, "Matching Device Name: %s", aDevName.c_str());
     if (advertisedDevice->getServiceUUID() == HEARTSERVICE_UUID) {
       if (String(userConfig.getconnectedHeartMonitor()) == "any") {
-        debugDirector("HR String Matched Any");
+        SS2K_LOG(BLE_CLIENT, DEBUG, "HR String Matched Any");
         // continue
       } else if (aDevName != String(userConfig.getconnectedHeartMonitor()) || (String(userConfig.getconnectedHeartMonitor()) == "none")) {
-        debugDirector("Skipping non-selected HRM |" + aDevName + "|" + String(userConfig.getconnectedHeartMonitor()));
+        SS2K_LOG(BLE_CLIENT, DEBUG, "Skipping non-selected HRM |%s|%s", aDevName.c_str(), userConfig.getconnectedHeartMonitor());
         return;
       } else if (aDevName == String(userConfig.getconnectedHeartMonitor())) {
-        debugDirector("HR String Matched " + aDevName);
+        SS2K_LOG(BLE_CLIENT, DEBUG, "HR String Matched %s", aDevName.c_str());
       }
     } else {  // Already tested -->((advertisedDevice->getServiceUUID()(CYCLINGPOWERSERVICE_UUID) || advertisedDevice->getServiceUUID()(FLYWHEEL_UART_SERVICE_UUID) ||
               // advertisedDevice->getServiceUUID()(FITNESSMACHINESERVICE_UUID)))
       if (String(userConfig.getconnectedPowerMeter()) == "any") {
-        debugDirector("PM String Matched Any");
+        SS2K_LOG(BLE_CLIENT, DEBUG, "PM String Matched Any");
         // continue
       } else if (aDevName != String(userConfig.getconnectedPowerMeter()) || (String(userConfig.getconnectedPowerMeter()) == "none")) {
-        debugDirector("Skipping non-selected PM |" + aDevName + "|" + String(userConfig.getconnectedPowerMeter()));
+        SS2K_LOG(BLE_CLIENT, DEBUG, "Skipping non-selected PM |%s|%s", aDevName.c_str(), userConfig.getconnectedPowerMeter());
         return;
       } else if (aDevName == String(userConfig.getconnectedPowerMeter())) {
-        debugDirector("PM String Matched " + aDevName);
+        SS2K_LOG(BLE_CLIENT, DEBUG, "PM String Matched %s", aDevName.c_str());
       }
     }
     for (size_t i = 0; i < NUM_BLE_DEVICES; i++) {
@@ -357,11 +405,11 @@ void SpinBLEClient::MyAdvertisedDeviceCallback::onResult(BLEAdvertisedDevice *ad
           (advertisedDevice->getAddress() == spinBLEClient.myBLEDevices[i].peerAddress)) {  // found empty device slot
         spinBLEClient.myBLEDevices[i].set(advertisedDevice);
         spinBLEClient.myBLEDevices[i].doConnect = true;
-        debugDirector("doConnect set on device: " + String(i));
+        SS2K_LOG(BLE_CLIENT, INFO, "doConnect set on device: %u", i);
 
         return;
       }
-      debugDirector("Checking Slot " + String(i));
+      SS2K_LOG(BLE_CLIENT, DEBUG, "Checking Slot %u", i);
     }
     return;
     //}
@@ -370,7 +418,7 @@ void SpinBLEClient::MyAdvertisedDeviceCallback::onResult(BLEAdvertisedDevice *ad
 
 void SpinBLEClient::scanProcess() {
   this->doScan = false;  // Confirming we did the scan
-  debugDirector("Scanning for BLE servers and putting them into a list...");
+  SS2K_LOG(BLE_CLIENT, INFO, "Scanning for BLE servers and putting them into a list...");
 
   BLEScan *pBLEScan = BLEDevice::getScan();
   pBLEScan->setAdvertisedDeviceCallbacks(new MyAdvertisedDeviceCallback());
@@ -423,7 +471,7 @@ void SpinBLEClient::disconnect() {
   scanRetries           = 0;
   reconnectTries        = 0;
   intentionalDisconnect = true;
-  debugDirector("Shutting Down all BLE services");
+  SS2K_LOG(BLE_CLIENT, INFO, "Shutting Down all BLE services");
   if (NimBLEDevice::getInitialized()) {
     NimBLEDevice::deinit();
     vTaskDelay(100 / portTICK_RATE_MS);
@@ -448,7 +496,7 @@ void SpinBLEClient::removeDuplicates(NimBLEClient *pClient) {
       if ((tBLEd.serviceUUID == oldBLEd.serviceUUID) && (tBLEd.peerAddress != oldBLEd.peerAddress)) {
         if (BLEDevice::getClientByPeerAddress(oldBLEd.peerAddress)) {
           if (BLEDevice::getClientByPeerAddress(oldBLEd.peerAddress)->isConnected()) {
-            debugDirector(String(tBLEd.peerAddress.toString().c_str()) + " Matched another service.  Disconnecting: " + String(oldBLEd.peerAddress.toString().c_str()));
+            SS2K_LOG(BLE_CLIENT, INFO, "%s Matched another service.  Disconnecting: %s", tBLEd.peerAddress.toString().c_str(), oldBLEd.peerAddress.toString().c_str());
             BLEDevice::getClientByPeerAddress(oldBLEd.peerAddress)->disconnect();
             oldBLEd.reset();
             spinBLEClient.intentionalDisconnect = true;
@@ -460,6 +508,43 @@ void SpinBLEClient::removeDuplicates(NimBLEClient *pClient) {
   }
 }
 
+String SpinBLEClient::returnLinkStatsJSON() {
+  DynamicJsonDocument doc(LINKSTATS_JSON_SIZE);
+  const uint32_t now = micros();
+
+  doc["notifyQueueDropped"] = this->notifyQueue.getDropped();
+  JsonArray slots           = doc.createNestedArray("slots");
+  for (size_t i = 0; i < NUM_BLE_DEVICES; i++) {
+    const LinkStats &stats = this->linkStats[i];
+    if (stats.getPackets() == 0 && this->myBLEDevices[i].connectedClientID == BLE_HS_CONN_HANDLE_NONE) {
+      continue;
+    }
+    JsonObject slot        = slots.createNestedObject();
+    slot["slot"]           = i;
+    slot["charUUID"]       = String(this->myBLEDevices[i].charUUID.toString().c_str());
+    slot["connected"]      = this->myBLEDevices[i].connectedClientID != BLE_HS_CONN_HANDLE_NONE;
+    slot["packets"]        = stats.getPackets();
+    slot["bytes"]          = stats.getBytes();
+    slot["decodeFailures"] = stats.getDecodeFailures();
+    slot["rateHz"]         = stats.getRate();
+    slot["meanGapMs"]      = stats.getMeanGap() / 1000;
+    slot["jitterMs"]       = stats.getJitter() / 1000;
+    slot["maxGapMs"]       = stats.getMaxGap() / 1000;
+    slot["lastPacketMs"]   = stats.getPackets() > 0 ? static_cast<int32_t>(stats.getLastPacketAge(now) / 1000) : -1;
+    slot["decodeMeanUs"]   = stats.getMeanDecodeTime();
+    slot["decodeMaxUs"]    = stats.getMaxDecodeTime();
+    JsonObject histogram   = slot.createNestedObject("gapHistogramMs");
+    for (uint8_t bin = 0; bin < LinkStats::HistogramBins; bin++) {
+      String label = bin < LinkStats::HistogramBins - 1 ? "<=" + String(LinkStats::HistogramLimits[bin]) : ">" + String(LinkStats::HistogramLimits[bin - 1]);
+      histogram[label] = stats.getHistogramCount(bin);
+    }
+  }
+
+  String output;
+  serializeJson(doc, output);
+  return output;
+}
+
 void SpinBLEClient::resetDevices() {
   SpinBLEAdvertisedDevice tBLEd;
   for (size_t i = 0; i < NUM_BLE_DEVICES; i++) {
@@ -474,46 +559,37 @@ void SpinBLEClient::postConnect(NimBLEClient *pClient) {
       if ((this->myBLEDevices[i].charUUID == CYCLINGPOWERMEASUREMENT_UUID) || (this->myBLEDevices[i].charUUID == FITNESSMACHINEINDOORBIKEDATA_UUID) ||
           (this->myBLEDevices[i].charUUID == FLYWHEEL_UART_RX_UUID) || (this->myBLEDevices[i].charUUID == ECHELON_DATA_UUID)) {
         this->connectedPM = true;
-        debugDirector("Registered PM on Connect");
+        SS2K_LOG(BLE_CLIENT, INFO, "Registered PM on Connect");
         if (this->myBLEDevices[i].charUUID == ECHELON_DATA_UUID) {
           NimBLERemoteCharacteristic *writeCharacteristic = pClient->getService(ECHELON_SERVICE_UUID)->getCharacteristic(ECHELON_WRITE_UUID);
           if (writeCharacteristic == nullptr) {
-            debugDirector("Failed to find Echelon write characteristic UUID: ", false);
-            debugDirector(String(ECHELON_WRITE_UUID.toString().c_str()));
+            SS2K_LOG(BLE_CLIENT, WARNING, "Failed to find Echelon write characteristic UUID: %s", ECHELON_WRITE_UUID.toString().c_str());
             pClient->disconnect();
             return;
           }
           // Enable device notifications
           byte message[] = {0xF0, 0xB0, 0x01, 0x01, 0xA2};
           writeCharacteristic->writeValue(message, 5);
-          debugDirector("Activated Echelon callbacks.");
+          SS2K_LOG(BLE_CLIENT, INFO, "Activated Echelon callbacks.");
         }
         // spinBLEClient.removeDuplicates(pclient);
         return;
       }
       if ((this->myBLEDevices[i].charUUID == HEARTCHARACTERISTIC_UUID)) {
         this->connectedHR = true;
-        debugDirector("Registered HRM on Connect");
+        SS2K_LOG(BLE_CLIENT, INFO, "Registered HRM on Connect");
         return;
       } else {
-        debugDirector("These did not match|" + String(pClient->getPeerAddress().toString().c_str()) + "|" + String(this->myBLEDevices[i].peerAddress.toString().c_str()) + "|");
+        SS2K_LOG(BLE_CLIENT, DEBUG, "These did not match|%s|%s|", pClient->getPeerAddress().toString().c_str(), this->myBLEDevices[i].peerAddress.toString().c_str());
       }
     }
   }
 }
 
 void SpinBLEAdvertisedDevice::print() {
-  char logBuf[250];
-  char *logBufP = logBuf;
-  logBufP += sprintf(logBufP, "Address: (%s)", peerAddress.toString().c_str());
-  logBufP += sprintf(logBufP, " Client ID: (%d)", connectedClientID);
-  logBufP += sprintf(logBufP, " SerUUID: (%s)", serviceUUID.toString().c_str());
-  logBufP += sprintf(logBufP, " CharUUID: (%s)", charUUID.toString().c_str());
-  logBufP += sprintf(logBufP, " HRM: (%s)", userSelectedHR ? "true" : "false");
-  logBufP += sprintf(logBufP, " PM: (%s)", userSelectedPM ? "true" : "false");
-  logBufP += sprintf(logBufP, " CSC: (%s)", userSelectedCSC ? "true" : "false");
-  logBufP += sprintf(logBufP, " CT: (%s)", userSelectedCT ? "true" : "false");
-  logBufP += sprintf(logBufP, " doConnect: (%s)", doConnect ? "true" : "false");
-  strcat(logBufP, "|");
-  debugDirector(String(logBuf));
+  // Two messages, as the UUIDs alone nearly fill a record.
+  SS2K_LOG(BLE_CLIENT, INFO, "Address: (%s) Client ID: (%d) SerUUID: (%s) CharUUID: (%s)", peerAddress.toString().c_str(), connectedClientID, serviceUUID.toString().c_str(),
+           charUUID.toString().c_str());
+  SS2K_LOG(BLE_CLIENT, INFO, " HRM: (%s) PM: (%s) CSC: (%s) CT: (%s) doConnect: (%s)|", userSelectedHR ? "true" : "false", userSelectedPM ? "true" : "false",
+           userSelectedCSC ? "true" : "false", userSelectedCT ? "true" : "false", doConnect ? "true" : "false");
 }
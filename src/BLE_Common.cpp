@@ -9,140 +9,379 @@
 #include "BLE_Common.h"
 
 #include <math.h>
+#include <SPIFFS.h>
+#include <SensorTrace.h>
 #include <sensors/SensorData.h>
 #include <sensors/SensorDataFactory.h>
+#include <sensors/SensorFusion.h>
+// NimBLE has no public call for the data length, so ble_hs_hci_util_set_data_len() comes from its host header.
+#include <src/ble_hs_hci_priv.h>
 
-int bleConnDesc               = 1;
-bool updateConnParametersFlag = false;
 bool hr2p                     = false;
 TaskHandle_t BLECommunicationTask;
+TaskHandle_t BLESensorProcessingTask = nullptr;
 SensorDataFactory sensorDataFactory;
+NotifyScheduler notifyScheduler;
+// Owned by BLESensorProcessing(). Sources are client slots, NUM_BLE_DEVICES for unregistered connections.
+SensorFusion sensorFusion(SENSOR_STALE_TIMEOUT * 1000);
+static_assert(NUM_BLE_DEVICES < SensorFusion::MaxSources, "Not enough sensor fusion sources");
 
-void BLECommunications(void *pvParameters) {
+PowerTable powerTable(POWER_TABLE_MIN_POSITION, POWER_TABLE_POSITION_SPACING, POWER_TABLE_MIN_CADENCE, POWER_TABLE_CADENCE_SPACING);
+static uint32_t powerTableSavedSamples = 0;
+
+// Sensor trace state. Packets are handed from BLESensorProcessing() to BLECommunications(), which owns the file.
+static bool sensorTraceRequested = false;
+static bool sensorTraceActive    = false;
+static File sensorTraceFile;
+static size_t sensorTraceSize = 0;
+static SensorTraceWriter sensorTraceWriter;
+static SPSCQueue<NotifyPacket, NOTIFY_QUEUE_LENGTH * 2> sensorTraceQueue;
+
+void startSensorTrace() { sensorTraceRequested = true; }
+
+void stopSensorTrace() { sensorTraceRequested = false; }
+
+bool isSensorTraceRecording() { return sensorTraceRequested || sensorTraceActive; }
+
+// Opens, appends to and closes the trace file as requested. Flash writes stay out of the sensor path.
+static void updateSensorTrace() {
+  if (sensorTraceRequested && !sensorTraceActive) {
+    NotifyPacket stale;
+    while (sensorTraceQueue.pop(stale)) {
+    }
+    sensorTraceFile = SPIFFS.open(SENSOR_TRACE_FILENAME, FILE_WRITE);
+    uint8_t header[SensorTraceWriter::HeaderSize];
+    sensorTraceSize = sensorTraceWriter.writeHeader(header, sizeof(header));
+    if (!sensorTraceFile || sensorTraceFile.write(header, sensorTraceSize) != sensorTraceSize) {
+      debugDirector("Unable to start sensor trace");
+      sensorTraceFile.close();
+      sensorTraceRequested = false;
+      return;
+    }
+    sensorTraceActive = true;
+    debugDirector("Sensor trace started");
+  }
+  if (!sensorTraceActive) {
+    return;
+  }
+
+  NotifyPacket packet;
+  uint8_t record[SensorTraceWriter::MaxRecordSize];
+  while (sensorTraceRequested && sensorTraceQueue.pop(packet)) {
+    if (packet.deviceIndex < 0) {  // No characteristic to record it under
+      continue;
+    }
+    size_t size = sensorTraceWriter.writePacket(record, sizeof(record), packet.timestamp, spinBLEClient.myBLEDevices[packet.deviceIndex].charUUID, packet.data, packet.length);
+    if (size == 0 || sensorTraceSize + size > SENSOR_TRACE_MAX_SIZE) {
+      debugDirector("Sensor trace full");
+      sensorTraceRequested = false;
+      break;
+    }
+    sensorTraceFile.write(record, size);
+    sensorTraceSize += size;
+  }
+  static uint32_t reportedDrops = 0;
+  if (sensorTraceQueue.getDropped() != reportedDrops) {
+    reportedDrops = sensorTraceQueue.getDropped();
+    debugDirector("Sensor trace has dropped " + String(reportedDrops) + " packets");
+  }
+
+  if (!sensorTraceRequested) {
+    sensorTraceFile.close();
+    sensorTraceActive = false;
+    debugDirector("Sensor trace stopped. " + String(sensorTraceSize) + " bytes in " + SENSOR_TRACE_FILENAME);
+  }
+}
+
+void loadPowerTable() {
+  File file = SPIFFS.open(POWER_TABLE_FILENAME, FILE_READ);
+  uint8_t data[PowerTable::SerializedSize];
+  if (!file || file.read(data, sizeof(data)) != sizeof(data) || !powerTable.deserialize(data, sizeof(data))) {
+    debugDirector("No learned power map, starting a new one");
+  } else {
+    debugDirector("Loaded learned power map, unused until readings agree with it");
+  }
+  file.close();
+}
+
+// Saves the power map now and then while it is learning. Flash writes stay out of the sensor path.
+static void savePowerTable() {
+  static uint32_t lastSave = 0;
+  if (powerTable.getSamples() == powerTableSavedSamples || millis() - lastSave < POWER_TABLE_SAVE_INTERVAL) {
+    return;
+  }
+  lastSave               = millis();
+  powerTableSavedSamples = powerTable.getSamples();
+  uint8_t data[PowerTable::SerializedSize];
+  const size_t size = powerTable.serialize(data, sizeof(data));
+  File file         = SPIFFS.open(POWER_TABLE_FILENAME, FILE_WRITE);
+  if (!file || file.write(data, size) != size) {
+    debugDirector("Unable to save learned power map");
+  }
+  file.close();
+}
+
+// Learns from a power reading once the stepper has rested long enough for the power meter to catch up.
+static void learnPowerTable(int watts, uint32_t now) {
+  static int restingPosition   = 0;
+  static uint32_t restingSince = 0;
+  const int position           = stepperPosition;
+  if (abs(position - restingPosition) > POWER_TABLE_REST_BAND) {
+    restingPosition = position;
+    restingSince    = now;
+    return;
+  }
+  if (now - restingSince < POWER_TABLE_SETTLE_TIME * 1000 || userConfig.getSimulateWatts() || userConfig.getSimulateCad()) {
+    return;
+  }
+  const bool trusted       = powerTable.isTrusted();
+  const uint32_t discarded = powerTable.getDiscarded();
+  powerTable.addSample(position, userConfig.getSimulatedCad(), watts);
+  if (powerTable.getDiscarded() != discarded) {
+    SS2K_LOG(ERG, INFO, "Learned power map doesn't match the stepper position, starting over");
+  } else if (powerTable.isTrusted() != trusted) {
+    SS2K_LOG(ERG, INFO, "Learned power map matches, using it");
+  }
+}
+
+// Copies the fused sensor values into userConfig. Metrics no sensor has reported lately drop to 0,
+// except power and cadence while they are estimated from heart rate.
+static void applySensorFusion(uint32_t now) {
+  float value;
+  if (!userConfig.getSimulateWatts()) {
+    if (sensorFusion.get(SensorFusion::Power, now, &value)) {
+      userConfig.setSimulatedWatts(value);
+    } else if (!hr2p) {
+      userConfig.setSimulatedWatts(0);
+    }
+  }
+  if (!userConfig.getSimulateCad()) {
+    if (sensorFusion.get(SensorFusion::Cadence, now, &value)) {
+      userConfig.setSimulatedCad(value);
+    } else if (!hr2p) {
+      userConfig.setSimulatedCad(0);
+    }
+  }
+  if (!userConfig.getSimulateHr()) {
+    userConfig.setSimulatedHr(sensorFusion.get(SensorFusion::HeartRate, now, &value) ? value : 0);
+  }
+  userConfig.setSimulatedSpeed(sensorFusion.get(SensorFusion::Speed, now, &value) ? value : 0);
+}
+
+void BLESensorProcessing(void *pvParameters) {
+  NotifyPacket packet;
   for (;;) {
-    // **********************************Client***************************************
-    for (size_t x = 0; x < NUM_BLE_DEVICES; x++) {  // loop through discovered devices
-      if (spinBLEClient.myBLEDevices[x].connectedClientID != BLE_HS_CONN_HANDLE_NONE) {
-        // spinBLEClient.myBLEDevices[x].print();
-        if (spinBLEClient.myBLEDevices[x].advertisedDevice) {  // is device registered?
-          // debugDirector("1",false);
-          SpinBLEAdvertisedDevice myAdvertisedDevice = spinBLEClient.myBLEDevices[x];
-          if ((myAdvertisedDevice.connectedClientID != BLE_HS_CONN_HANDLE_NONE) && (myAdvertisedDevice.doConnect == false)) {  // client must not be in connection process
-            // debugDirector("2",false);
-            if (BLEDevice::getClientByPeerAddress(myAdvertisedDevice.peerAddress)) {  // nullptr check
-              // debugDirector("3",false);
-              BLEClient *pClient = NimBLEDevice::getClientByPeerAddress(myAdvertisedDevice.peerAddress);
-              // Client connected with a valid UUID registered
-              if ((myAdvertisedDevice.serviceUUID != BLEUUID((uint16_t)0x0000)) && (pClient->isConnected())) {
-                // debugDirector("4");
-                // Write the recieved data to the Debug Director
-
-                BLERemoteCharacteristic *pRemoteBLECharacteristic = pClient->getService(myAdvertisedDevice.serviceUUID)->getCharacteristic(myAdvertisedDevice.charUUID);
-                std::string data                                  = pRemoteBLECharacteristic->getValue();
-                uint8_t *pData                                    = reinterpret_cast<uint8_t *>(&data[0]);
-                int length                                        = data.length();
-
-                // 250 == Data(60), Spaces(Data/2), Arrow(4), SvrUUID(37), Sep(3), ChrUUID(37), Sep(3),
-                //        Name(10), Prefix(2), HR(8), SEP(1), CD(10), SEP(1), PW(8), SEP(1), SP(7), Suffix(2), Nul(1) - 225 rounded up
-                char logBuf[250];
-                char *logBufP = logBuf;
-                for (int i = 0; i < length; i++) {
-                  logBufP += sprintf(logBufP, "%02x ", pData[i]);
-                }
-                logBufP += sprintf(logBufP, "<- %.8s | %.8s", myAdvertisedDevice.serviceUUID.toString().c_str(), myAdvertisedDevice.charUUID.toString().c_str());
-
-                std::shared_ptr<SensorData> sensorData = sensorDataFactory.getSensorData(pRemoteBLECharacteristic->getUUID(), pData, length);
-
-                logBufP += sprintf(logBufP, " | %s:[", sensorData->getId().c_str());
-                if (sensorData->hasHeartRate() && !userConfig.getSimulateHr()) {
-                  int heartRate = sensorData->getHeartRate();
-                  userConfig.setSimulatedHr(heartRate);
-                  spinBLEClient.connectedHR |= true;
-                  logBufP += sprintf(logBufP, " HR(%d)", heartRate % 1000);
-                }
-                if (sensorData->hasCadence() && !userConfig.getSimulateCad()) {
-                  float cadence = sensorData->getCadence();
-                  userConfig.setSimulatedCad(cadence);
-                  spinBLEClient.connectedCD |= true;
-                  logBufP += sprintf(logBufP, " CD(%.2f)", fmodf(cadence, 1000.0));
-                }
-                if (sensorData->hasPower() && !userConfig.getSimulateWatts()) {
-                  int power = sensorData->getPower() * userConfig.getPowerCorrectionFactor();
-                  userConfig.setSimulatedWatts(power);
-                  spinBLEClient.connectedPM |= true;
-                  logBufP += sprintf(logBufP, " PW(%d)", power % 10000);
-                }
-                if (sensorData->hasSpeed()) {
-                  float speed = sensorData->getSpeed();
-                  userConfig.setSimulatedSpeed(speed);
-                  logBufP += sprintf(logBufP, " SD(%.2f)", fmodf(speed, 1000.0));
-                }
-                strcat(logBufP, " ]");
-                debugDirector(String(logBuf), true, true);
-              } else if (!pClient->isConnected()) {  // This shouldn't ever be
-                                                     // called...
-                if (pClient->disconnect() == 0) {    // 0 is a successful disconnect
-                  BLEDevice::deleteClient(pClient);
-                  vTaskDelay(100 / portTICK_PERIOD_MS);
-                  debugDirector("Workaround connect");
-                  myAdvertisedDevice.doConnect = true;
-                }
+    // Woken by notifyCallback(), or often enough to notice sensors that went silent.
+    ulTaskNotifyTake(pdTRUE, (SENSOR_STALE_TIMEOUT / 3) / portTICK_PERIOD_MS);
+    uint8_t changed = 0;  // ServerNotifyChannels bits of the characteristics fed by what was decoded
+    while (spinBLEClient.notifyQueue.pop(packet)) {
+      if (packet.disconnected) {
+        // Its values are dropped now rather than when they go stale.
+        sensorFusion.removeSource(packet.deviceIndex);
+        changed |= NotifyScheduler::bit(ServerNotifyChannels::IndoorBikeData) | NotifyScheduler::bit(ServerNotifyChannels::CyclingPowerMeasurement) |
+                   NotifyScheduler::bit(ServerNotifyChannels::HeartRateMeasurement);
+        continue;
+      }
+      uint8_t *pData = packet.data;
+      int length     = packet.length;
+
+      // The decoded values are only put together when packets are logged.
+      const bool logPacket = SS2K_LOG_ENABLED(BLE_CLIENT, VERBOSE);
+      // 45 == HR(9), CD(12), PW(10), SD(12), Nul(1), rounded up
+      char values[45] = "";
+      char *valuesP   = values;
+
+      if (sensorTraceActive) {
+        sensorTraceQueue.push(packet);
+      }
+
+      const uint32_t decodeStart = micros();
+      SensorData &sensorData     = sensorDataFactory.getSensorData(packet.sensorId, pData, length);
+      const uint32_t decodeTime  = micros() - decodeStart;
+      const uint8_t source       = packet.deviceIndex >= 0 ? packet.deviceIndex : NUM_BLE_DEVICES;
+      if (packet.deviceIndex >= 0) {
+        LinkStats &stats = spinBLEClient.linkStats[packet.deviceIndex];
+        stats.recordPacket(packet.timestamp, packet.length);
+        stats.recordDecode(decodeTime, sensorData.hasHeartRate() || sensorData.hasCadence() || sensorData.hasPower() || sensorData.hasSpeed());
+      }
+
+      if (sensorData.hasHeartRate()) {
+        int heartRate = sensorData.getHeartRate();
+        sensorFusion.update(source, packet.sensorId, SensorFusion::HeartRate, heartRate, packet.timestamp);
+        spinBLEClient.connectedHR |= true;
+        changed |= NotifyScheduler::bit(ServerNotifyChannels::HeartRateMeasurement) | NotifyScheduler::bit(ServerNotifyChannels::IndoorBikeData);
+        if (logPacket) {
+          valuesP += sprintf(valuesP, " HR(%d)", heartRate % 1000);
+        }
+      }
+      if (sensorData.hasCadence()) {
+        float cadence = sensorData.getCadence();
+        sensorFusion.update(source, packet.sensorId, SensorFusion::Cadence, cadence, packet.timestamp);
+        spinBLEClient.connectedCD |= true;
+        changed |= NotifyScheduler::bit(ServerNotifyChannels::IndoorBikeData) | NotifyScheduler::bit(ServerNotifyChannels::CyclingPowerMeasurement);
+        if (logPacket) {
+          valuesP += sprintf(valuesP, " CD(%.2f)", fmodf(cadence, 1000.0));
+        }
+      }
+      uint16_t crankRevolutions, crankEventTime;
+      if (packet.sensorId == SensorDataFactory::CyclePower && !userConfig.getSimulateCad() &&
+          static_cast<CyclePowerData &>(sensorData).getCrankEvent(&crankRevolutions, &crankEventTime)) {
+        passUpstreamCrankEvent(crankRevolutions, crankEventTime, packet.timestamp);
+      }
+      if (sensorData.hasPower()) {
+        int power = sensorData.getPower() * userConfig.getPowerCorrectionFactor();
+        sensorFusion.update(source, packet.sensorId, SensorFusion::Power, power, packet.timestamp);
+        spinBLEClient.connectedPM |= true;
+        learnPowerTable(power, packet.timestamp);
+        changed |= NotifyScheduler::bit(ServerNotifyChannels::IndoorBikeData) | NotifyScheduler::bit(ServerNotifyChannels::CyclingPowerMeasurement);
+        if (logPacket) {
+          valuesP += sprintf(valuesP, " PW(%d)", power % 10000);
+        }
+      }
+      if (sensorData.hasSpeed()) {
+        float speed = sensorData.getSpeed();
+        sensorFusion.update(source, packet.sensorId, SensorFusion::Speed, speed, packet.timestamp);
+        changed |= NotifyScheduler::bit(ServerNotifyChannels::IndoorBikeData);
+        if (logPacket) {
+          valuesP += sprintf(valuesP, " SD(%.2f)", fmodf(speed, 1000.0));
+        }
+      }
+      if (packet.deviceIndex >= 0) {
+        const SpinBLEAdvertisedDevice &device = spinBLEClient.myBLEDevices[packet.deviceIndex];
+        SS2K_LOG(BLE_CLIENT, VERBOSE, "%s<- %s | %s | %s:[%s ]", LogRing::Hex(pData, length), device.serviceUUID.toString().substr(0, 8).c_str(),
+                 device.charUUID.toString().substr(0, 8).c_str(), sensorData.getId().c_str(), values);
+      } else {
+        SS2K_LOG(BLE_CLIENT, VERBOSE, "%s<- unregistered | %s:[%s ]", LogRing::Hex(pData, length), sensorData.getId().c_str(), values);
+      }
+    }
+    applySensorFusion(micros());
+    if (changed) {
+      notifyServerDataChanged(changed);
+    }
+#ifdef DEBUG_STACK
+    Serial.printf("BLESensor: %d \n", uxTaskGetStackHighWaterMark(BLESensorProcessingTask));
+#endif
+  }
+}
+
+// Everything that only needs doing once a BLE_NOTIFY_DELAY.
+static void BLEHousekeeping() {
+  // **********************************Client***************************************
+  // Sensor data is pushed by notifyCallback() and handled in BLESensorProcessing().
+  // Here we only look after clients that have silently dropped their connection.
+  for (size_t x = 0; x < NUM_BLE_DEVICES; x++) {  // loop through discovered devices
+    if (spinBLEClient.myBLEDevices[x].connectedClientID != BLE_HS_CONN_HANDLE_NONE) {
+      if (spinBLEClient.myBLEDevices[x].advertisedDevice) {  // is device registered?
+        SpinBLEAdvertisedDevice myAdvertisedDevice = spinBLEClient.myBLEDevices[x];
+        if ((myAdvertisedDevice.connectedClientID != BLE_HS_CONN_HANDLE_NONE) && (myAdvertisedDevice.doConnect == false)) {  // client must not be in connection process
+          if (BLEDevice::getClientByPeerAddress(myAdvertisedDevice.peerAddress)) {                                          // nullptr check
+            BLEClient *pClient = NimBLEDevice::getClientByPeerAddress(myAdvertisedDevice.peerAddress);
+            if (!pClient->isConnected()) {       // This shouldn't ever be
+                                                 // called...
+              if (pClient->disconnect() == 0) {  // 0 is a successful disconnect
+                BLEDevice::deleteClient(pClient);
+                vTaskDelay(100 / portTICK_PERIOD_MS);
+                debugDirector("Workaround connect");
+                myAdvertisedDevice.doConnect = true;
               }
             }
           }
         }
       }
     }
+  }
 
-    // ***********************************SERVER**************************************
-    if ((spinBLEClient.connectedHR || userConfig.getSimulateHr()) && !spinBLEClient.connectedPM && !userConfig.getSimulateWatts() && (userConfig.getSimulatedHr() > 0) &&
-        userPWC.hr2Pwr) {
-      calculateInstPwrFromHR();
-      hr2p = true;
-    } else {
-      hr2p = false;
-    }
-#ifdef DEBUG_HR_TO_PWR
+  updateSensorTrace();
+
+  if ((spinBLEClient.connectedHR || userConfig.getSimulateHr()) && !spinBLEClient.connectedPM && !userConfig.getSimulateWatts() && (userConfig.getSimulatedHr() > 0) &&
+      userPWC.hr2Pwr) {
     calculateInstPwrFromHR();
+    hr2p = true;
+  } else {
+    hr2p = false;
+  }
+#ifdef DEBUG_HR_TO_PWR
+  calculateInstPwrFromHR();
 #endif
 
-    if (!spinBLEClient.connectedPM && !hr2p && !userConfig.getSimulateWatts() && !userConfig.getSimulateCad()) {
-      userConfig.setSimulatedCad(0);
-      userConfig.setSimulatedWatts(0);
+  updateServerConnections();
+  savePowerTable();
+  if (BLEDevice::getAdvertising()) {
+    if (!(BLEDevice::getAdvertising()->isAdvertising()) && (BLEDevice::getServer()->getConnectedCount() < CONFIG_BT_NIMBLE_MAX_CONNECTIONS - NUM_BLE_DEVICES)) {
+      debugDirector("Starting Advertising From Communication Loop");
+      BLEDevice::startAdvertising();
+    }
+  }
+}
+
+void requestLinkLayerFeatures(uint16_t connHandle, const ConnectionParameters &parameters) {
+  if (parameters.prefer2M) {
+    // Controllers without 2M PHY (the original ESP32) refuse, and the link stays on 1M.
+    int rc = ble_gap_set_prefered_le_phy(connHandle, BLE_GAP_LE_PHY_1M_MASK | BLE_GAP_LE_PHY_2M_MASK, BLE_GAP_LE_PHY_1M_MASK | BLE_GAP_LE_PHY_2M_MASK, BLE_GAP_LE_PHY_CODED_ANY);
+    if (rc != 0) {
+      debugDirector("2M PHY not available for connection " + String(connHandle) + ": " + String(rc));
+    }
+  }
+  if (parameters.dataLength > 0) {
+    const uint16_t txTime = (parameters.dataLength + 14) * 8;  // us on the 1M PHY
+    int rc                = ble_hs_hci_util_set_data_len(connHandle, parameters.dataLength, txTime);
+    if (rc != 0) {
+      debugDirector("Data length extension not available for connection " + String(connHandle) + ": " + String(rc));
     }
-    if (!spinBLEClient.connectedHR && !userConfig.getSimulateHr()) {
-      userConfig.setSimulatedHr(0);
+  }
+  debugDirector("Connection " + String(connHandle) + " asked for " + String(parameters.minInterval * 1.25) + "-" + String(parameters.maxInterval * 1.25) + " ms intervals");
+}
+
+void notifyServerDataChanged(uint8_t channels) {
+  notifyScheduler.markDirty(channels);
+  if (BLECommunicationTask != nullptr) {
+    xTaskNotifyGive(BLECommunicationTask);
+  }
+}
+
+void BLECommunications(void *pvParameters) {
+  notifyScheduler.setMaxRate(ServerNotifyChannels::IndoorBikeData, INDOOR_BIKE_DATA_MAX_RATE);
+  notifyScheduler.setMaxRate(ServerNotifyChannels::CyclingPowerMeasurement, CYCLING_POWER_MAX_RATE);
+  notifyScheduler.setMaxRate(ServerNotifyChannels::HeartRateMeasurement, HEART_RATE_MAX_RATE);
+  uint32_t lastHousekeeping = millis() - BLE_NOTIFY_DELAY;
+
+  for (;;) {
+    if (millis() - lastHousekeeping >= BLE_NOTIFY_DELAY) {
+      lastHousekeeping = millis();
+      BLEHousekeeping();
+      // Refresh every characteristic at least once a period, also when nothing upstream changed.
+      notifyScheduler.markDirty(NotifyScheduler::bit(ServerNotifyChannels::IndoorBikeData) | NotifyScheduler::bit(ServerNotifyChannels::CyclingPowerMeasurement) |
+                                NotifyScheduler::bit(ServerNotifyChannels::HeartRateMeasurement));
     }
 
+    // ***********************************SERVER**************************************
+    uint32_t wait = (BLE_NOTIFY_DELAY / 2);  // Often enough to blink the LED
     if (connectedClientCount() > 0) {
-      // update the BLE information on the server
-      computeCSC();
-      updateIndoorBikeDataChar();
-      updateCyclingPowerMesurementChar();
-      updateHeartRateMeasurementChar();
-
-      if (updateConnParametersFlag) {
-        vTaskDelay(100 / portTICK_PERIOD_MS);
-        // BLEDevice::getServer()->updateConnParams(bleConnDesc, 40, 50,
-        // 0, 100);
-        BLEDevice::getServer()->updateConnParams(bleConnDesc, 80, 200, 0, 800);
-        updateConnParametersFlag = false;
+      const uint8_t due = notifyScheduler.takeDue(micros());
+      if (due & NotifyScheduler::bit(ServerNotifyChannels::IndoorBikeData)) {
+        updateIndoorBikeDataChar();
       }
-    } else {
-    }
-    if (connectedClientCount() == 0) {
-      digitalWrite(LED_PIN, LOW);  // blink if no client connected
-    }
-    if (BLEDevice::getAdvertising()) {
-      if (!(BLEDevice::getAdvertising()->isAdvertising()) && (BLEDevice::getServer()->getConnectedCount() < CONFIG_BT_NIMBLE_MAX_CONNECTIONS - NUM_BLE_DEVICES)) {
-        debugDirector("Starting Advertising From Communication Loop");
-        BLEDevice::startAdvertising();
+      if (due & NotifyScheduler::bit(ServerNotifyChannels::CyclingPowerMeasurement)) {
+        updateCyclingPowerMesurementChar();
+      }
+      if (due & NotifyScheduler::bit(ServerNotifyChannels::HeartRateMeasurement)) {
+        updateHeartRateMeasurementChar();
       }
+      const uint32_t untilDue = notifyScheduler.getTimeUntilDue(micros());
+      if (untilDue != UINT32_MAX) {
+        wait = min(wait, (untilDue + 999) / 1000);
+      }
+      digitalWrite(LED_PIN, HIGH);
+    } else {
+      digitalWrite(LED_PIN, (millis() / (BLE_NOTIFY_DELAY / 2)) % 2 ? HIGH : LOW);  // blink if no client connected
     }
+    const uint32_t sinceHousekeeping = millis() - lastHousekeeping;
+    wait                             = min(wait, sinceHousekeeping < BLE_NOTIFY_DELAY ? BLE_NOTIFY_DELAY - sinceHousekeeping : 0);
 
-    vTaskDelay((BLE_NOTIFY_DELAY / 2) / portTICK_PERIOD_MS);
-    digitalWrite(LED_PIN, HIGH);
-    vTaskDelay((BLE_NOTIFY_DELAY / 2) / portTICK_PERIOD_MS);
+    // Woken early by notifyServerDataChanged().
+    if (wait > 0) {
+      ulTaskNotifyTake(pdTRUE, (wait + portTICK_PERIOD_MS - 1) / portTICK_PERIOD_MS);
+    }
 #ifdef DEBUG_STACK
     Serial.printf("BLEComm: %d \n", uxTaskGetStackHighWaterMark(BLECommunicationTask));
 #endif
@@ -10,7 +10,11 @@
 
 #include <ArduinoJson.h>
 #include <Constants.h>
+#include <CrankSynthesizer.h>
+#include <ERG.h>
+#include <FTMSControlPoint.h>
 #include <NimBLEDevice.h>
+#include <ServerEncoders.h>
 
 // BLE Server Settings
 
@@ -20,6 +24,46 @@ BLECharacteristic *heartRateMeasurementCharacteristic;
 BLECharacteristic *cyclingPowerMeasurementCharacteristic;
 BLECharacteristic *fitnessMachineFeature;
 BLECharacteristic *fitnessMachineIndoorBikeData;
+BLECharacteristic *fitnessMachineControlPoint;
+
+// Control point writes, copied out of the NimBLE host task and applied by ftmsControlPointWorker().
+TaskHandle_t FTMSControlPointTask;
+static QueueHandle_t controlPointQueue;
+static uint32_t controlPointDropped = 0;
+// Response indications that weren't confirmed. Counted by MyCallbacks::onStatus() in the worker's context.
+static uint32_t controlPointIndicateFailures = 0;
+
+// Power targets and grades reach ergControllerWorker() as its task notification value. The controller, ERG mode
+// and, while in ERG mode, the incline are owned by that task, so a grade can't be overwritten by an update in flight.
+TaskHandle_t ERGControllerTask;
+static const uint32_t ERGGradeCommand = 0x80000000;  // Set with the grade in the low 16 bits. Ends ERG mode
+static ERGController ergController({ERG_PROPORTIONAL_GAIN, ERG_INTEGRAL_GAIN, ERG_DERIVATIVE_GAIN, ERG_FEED_FORWARD_GAIN},
+                                   {ERG_MIN_INCLINE, ERG_MAX_INCLINE, ERG_MAX_INCLINE_RATE, ERG_MIN_CADENCE});
+
+// Client connections and subscriptions, reported by the NimBLE host and applied by the sending task.
+struct ServerLinkEvent {
+  enum Types : uint8_t { Connect, Disconnect, Subscribe };
+  uint8_t type;
+  uint16_t connHandle;
+  uint8_t channel;
+  bool subscribed;
+};
+static SPSCQueue<ServerLinkEvent, SERVER_LINK_EVENT_QUEUE_LENGTH> serverLinkEvents;
+// Owned by the task that sends notifications, BLECommunications().
+static NotifyFanout notifyFanout;
+static_assert(CONFIG_BT_NIMBLE_MAX_CONNECTIONS <= NotifyFanout::MaxPeers, "Not enough notify fan-out peers");
+// Connection parameters for each client, negotiated from BLECommunications().
+static ConnectionManager serverConnections;
+
+// Crank events of the upstream power meter, handed from BLESensorProcessing() to the task that sends notifications.
+struct UpstreamCrankEvent {
+  uint16_t revolutions;
+  uint16_t time;  // 1/1024 s
+  uint32_t timestamp;
+};
+static SPSCQueue<UpstreamCrankEvent, UPSTREAM_CRANK_EVENT_QUEUE_LENGTH> upstreamCrankEvents;
+// The Crank Revolution Data of our Cycling Power Measurement. Owned by BLECommunications().
+static CrankSynthesizer crankSynthesizer;
 
 /********************************Bit field Flag
  * Example***********************************/
@@ -41,11 +85,9 @@ BLECharacteristic *fitnessMachineIndoorBikeData;
 // 00000101000010000110
 // 00000000100001010100
 //               100000
-byte heartRateMeasurement[2]    = {0x00, 0x00};
-byte cyclingPowerMeasurement[9] = {0b0000000100011, 0, 200, 0, 0, 0, 0, 0, 0};
-byte cpsLocation[1]             = {0b000};       // sensor location 5 == left crank
-byte cpFeature[1]               = {0b00100000};  // crank information present // 3rd & 2nd
-                                                 // byte is reported power
+byte cpsLocation[1] = {0b000};       // sensor location 5 == left crank
+byte cpFeature[1]   = {0b00100000};  // crank information present // 3rd & 2nd
+                                     // byte is reported power
 
 byte ftmsService[6]       = {0x00, 0x00, 0x00, 0b01, 0b0100000, 0x00};
 byte ftmsControlPoint[8]  = {0, 0, 0, 0, 0, 0, 0, 0};  // 0x08 we need to return a value of 1 for any sucessful change
@@ -56,14 +98,72 @@ struct FitnessMachineFeature ftmsFeature = {
         FitnessMachineFeatureFlags::Types::PowerMeasurementSupported,
     FitnessMachineTargetFlags::Types::InclinationTargetSettingSupported | FitnessMachineTargetFlags::Types::IndoorBikeSimulationParametersSupported};
 
-uint8_t ftmsIndoorBikeData[14] = {0x44, 0x02, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0};  // 00000000100001010100 ISpeed, ICAD,
-                                                                                                            // TDistance, IPower, ETime
-uint8_t ftmsResistanceLevelRange[6] = {0x00, 0x00, 0x3A, 0x98, 0xC5, 0x68};                                 // +-15000 not sure what units
-uint8_t ftmsPowerRange[6]           = {0x00, 0x00, 0xA0, 0x0F, 0x01, 0x00};                                 // 1-4000 watts
+uint8_t ftmsResistanceLevelRange[6] = {0x00, 0x00, 0x3A, 0x98, 0xC5, 0x68};  // +-15000 not sure what units
+uint8_t ftmsPowerRange[6]           = {0x00, 0x00, 0xA0, 0x0F, 0x01, 0x00};  // 1-4000 watts
+
+// The measurement characteristics are encoded straight into a packet of the encoder's size, which
+// setValue() copies into the attribute. NimBLE keeps its own copy of a value, so that is the only copy.
+
+static void setIndoorBikeDataValue(uint8_t *value) {
+  encodeIndoorBikeData(value, userConfig.getSimulatedCad(), userConfig.getSimulatedWatts(), userConfig.getSimulatedHr(), userConfig.getSimulatedSpeed());
+  fitnessMachineIndoorBikeData->setValue(value, IndoorBikeDataEncoder::Size);
+}
+
+static void setCyclingPowerMeasurementValue(uint8_t *value) {
+  UpstreamCrankEvent event;
+  while (upstreamCrankEvents.pop(event)) {
+    crankSynthesizer.passthrough(event.revolutions, event.time, event.timestamp);
+  }
+  crankSynthesizer.update(userConfig.getSimulatedCad(), micros());
+  encodeCyclingPowerMeasurement(value, userConfig.getSimulatedWatts(), crankSynthesizer.getRevolutions(), crankSynthesizer.getEventTime());
+  cyclingPowerMeasurementCharacteristic->setValue(value, CyclingPowerMeasurementEncoder::Size);
+}
+
+static void setHeartRateMeasurementValue(uint8_t *value) {
+  encodeHeartRateMeasurement(value, userConfig.getSimulatedHr());
+  heartRateMeasurementCharacteristic->setValue(value, HeartRateMeasurementEncoder::Size);
+}
+
+// Sends a value to every subscribed client that isn't backed off. Unlike notify() a congested
+// client can't hold up the others: a notification it can't take is counted and the client skipped
+// for a while.
+static void updateServerLinks() {
+  ServerLinkEvent event;
+  while (serverLinkEvents.pop(event)) {
+    switch (event.type) {
+      case ServerLinkEvent::Connect:
+        notifyFanout.addPeer(event.connHandle);
+        serverConnections.addLink(event.connHandle, ConnectionManager::AppDownlink, micros());
+        break;
+      case ServerLinkEvent::Disconnect:
+        notifyFanout.removePeer(event.connHandle);
+        serverConnections.removeLink(event.connHandle);
+        break;
+      case ServerLinkEvent::Subscribe:
+        notifyFanout.setSubscribed(event.connHandle, event.channel, event.subscribed);
+        break;
+    }
+  }
+}
+
+static void notifyClients(BLECharacteristic *characteristic, uint8_t channel, const uint8_t *value, size_t length) {
+  updateServerLinks();
+
+  uint16_t recipients[NotifyFanout::MaxPeers];
+  const uint32_t now    = micros();
+  const uint8_t count   = notifyFanout.getRecipients(channel, now, recipients);
+  const uint16_t handle = characteristic->getHandle();
+  for (uint8_t i = 0; i < count; i++) {
+    // The host takes the mbuf, sent or not.
+    os_mbuf *om = ble_hs_mbuf_from_flat(value, length);
+    int rc      = om == nullptr ? BLE_HS_ENOMEM : ble_gattc_notify_custom(recipients[i], handle, om);
+    notifyFanout.recordResult(recipients[i], rc == 0, now);
+  }
+}
 
 void startBLEServer() {
   // Server Setup
-  debugDirector("Starting BLE Server");
+  SS2K_LOG(BLE_SERVER, INFO, "Starting BLE Server");
   pServer = BLEDevice::createServer();
 
   // HEART RATE MONITOR SERVICE SETUP
@@ -85,8 +185,8 @@ void startBLEServer() {
   fitnessMachineFeature = pFitnessMachineService->createCharacteristic(FITNESSMACHINEFEATURE_UUID,
                                                                        NIMBLE_PROPERTY::READ | NIMBLE_PROPERTY::WRITE | NIMBLE_PROPERTY::NOTIFY | NIMBLE_PROPERTY::INDICATE);
 
-  BLECharacteristic *fitnessMachineControlPoint =
-      pFitnessMachineService->createCharacteristic(FITNESSMACHINECONTROLPOINT_UUID, NIMBLE_PROPERTY::WRITE | NIMBLE_PROPERTY::NOTIFY | NIMBLE_PROPERTY::INDICATE);
+  fitnessMachineControlPoint = pFitnessMachineService->createCharacteristic(FITNESSMACHINECONTROLPOINT_UUID,
+                                                                            NIMBLE_PROPERTY::WRITE | NIMBLE_PROPERTY::INDICATE);
 
   BLECharacteristic *fitnessMachineStatus =
       pFitnessMachineService->createCharacteristic(FITNESSMACHINESTATUS_UUID, NIMBLE_PROPERTY::READ | NIMBLE_PROPERTY::WRITE | NIMBLE_PROPERTY::NOTIFY);
@@ -100,22 +200,45 @@ void startBLEServer() {
   pServer->setCallbacks(new MyServerCallbacks());
 
   // Creating Characteristics
-  heartRateMeasurementCharacteristic->setValue(heartRateMeasurement, 2);
+  uint8_t heartRateMeasurement[HeartRateMeasurementEncoder::Size];
+  setHeartRateMeasurementValue(heartRateMeasurement);
 
-  cyclingPowerMeasurementCharacteristic->setValue(cyclingPowerMeasurement, 9);
+  uint8_t cyclingPowerMeasurement[CyclingPowerMeasurementEncoder::Size];
+  setCyclingPowerMeasurementValue(cyclingPowerMeasurement);
   cyclingPowerFeatureCharacteristic->setValue(cpFeature, 1);
   sensorLocationCharacteristic->setValue(cpsLocation, 1);
 
   fitnessMachineFeature->setValue(ftmsFeature.bytes, sizeof(ftmsFeature));
   fitnessMachineControlPoint->setValue(ftmsControlPoint, 8);
 
-  fitnessMachineIndoorBikeData->setValue(ftmsIndoorBikeData, 14);
+  uint8_t indoorBikeData[IndoorBikeDataEncoder::Size];
+  setIndoorBikeDataValue(indoorBikeData);
 
   fitnessMachineStatus->setValue(ftmsMachineStatus, 8);
   fitnessMachineResistanceLevelRange->setValue(ftmsResistanceLevelRange, 6);
   fitnessMachinePowerRange->setValue(ftmsPowerRange, 6);
 
   fitnessMachineControlPoint->setCallbacks(new MyCallbacks());
+  fitnessMachineIndoorBikeData->setCallbacks(new MeasurementCallbacks(ServerNotifyChannels::IndoorBikeData));
+  cyclingPowerMeasurementCharacteristic->setCallbacks(new MeasurementCallbacks(ServerNotifyChannels::CyclingPowerMeasurement));
+  heartRateMeasurementCharacteristic->setCallbacks(new MeasurementCallbacks(ServerNotifyChannels::HeartRateMeasurement));
+
+  controlPointQueue = xQueueCreate(CONTROL_POINT_QUEUE_LENGTH, sizeof(FTMSControlPoint::Command));
+  xTaskCreatePinnedToCore(ftmsControlPointWorker,  /* Task function. */
+                          "FTMSControlPointTask",  /* name of task. */
+                          3000,                    /* Stack size of task*/
+                          NULL,                    /* parameter of the task */
+                          1,                       /* priority of the task*/
+                          &FTMSControlPointTask,   /* Task handle to keep track of created task */
+                          1);                      /* pin task to core 1 */
+
+  xTaskCreatePinnedToCore(ergControllerWorker, /* Task function. */
+                          "ERGControllerTask", /* name of task. */
+                          2500,                /* Stack size of task*/
+                          NULL,                /* parameter of the task */
+                          2,                   /* priority of the task - above the 1s loops so it keeps its rate*/
+                          &ERGControllerTask,  /* Task handle to keep track of created task */
+                          1);                  /* pin task to core 1 */
 
   pHeartService->start();           // heart rate service
   pPowerMonitor->start();           // Power Meter Service
@@ -130,188 +253,219 @@ void startBLEServer() {
   pAdvertising->setScanResponse(true);
   BLEDevice::startAdvertising();
 
-  debugDirector("Bluetooth Characteristic defined!");
+  SS2K_LOG(BLE_SERVER, INFO, "Bluetooth Characteristic defined!");
 }
 
-void computeERG(int currentWatts, int setPoint) {
-  // cooldownTimer--;
-
-  float incline             = userConfig.getIncline();
-  int cad                   = userConfig.getSimulatedCad();
-  int newIncline            = incline;
-  int amountToChangeIncline = 0;
-
-  if (cad > 50 and currentWatts > 100) {
-    // 30  is amount of watts per shift. Was 50, seemed like too much...
-    if (abs(currentWatts - setPoint) < 30) {
-      amountToChangeIncline = (currentWatts - setPoint) * 1;
-    }
-    if (abs(currentWatts - setPoint) > 30) {
-      amountToChangeIncline = amountToChangeIncline + ((currentWatts - setPoint)) * 1;
-    }
-    amountToChangeIncline = amountToChangeIncline / ((currentWatts / 100) + 1);
-
-    // limit to 4 shifts at a time
-    if (abs(amountToChangeIncline) > userConfig.getShiftStep() * 5) {
-      if (amountToChangeIncline > 0) {
-        amountToChangeIncline = userConfig.getShiftStep() * 5;
+void ergControllerWorker(void *pvParameters) {
+  const TickType_t period = (1000 / ERG_UPDATE_RATE) / portTICK_PERIOD_MS;
+  TickType_t lastWake     = xTaskGetTickCount();
+  bool running            = false;
+  for (;;) {
+    // Idle until a target arrives, then run at a fixed rate until a grade switches ERG mode off.
+    uint32_t command;
+    if (xTaskNotifyWait(0, 0, &command, running ? 0 : portMAX_DELAY) == pdTRUE) {
+      if (command & ERGGradeCommand) {
+        userConfig.setERGMode(false);
+        userConfig.setIncline(static_cast<int16_t>(command & 0xFFFF));
+        SS2K_LOG(ERG, INFO, " Target Incline: %.2f", userConfig.getIncline() / 100);
+        running = false;
+        continue;
       }
-      if (amountToChangeIncline < 0) {
-        amountToChangeIncline = -(userConfig.getShiftStep() * 5);
+      if (!running) {
+        lastWake = xTaskGetTickCount();
       }
+      // Jump straight to where the learned map expects the target, if it has learned enough.
+      float predictedIncline = NAN;
+      int32_t position;
+      if (powerTable.getPosition(command, userConfig.getSimulatedCad(), &position)) {
+        predictedIncline = (position - shifterPosition) / userConfig.getInclineMultiplier();
+      }
+      ergController.setTarget(command, userConfig.getIncline(), micros(), predictedIncline);
+      userConfig.setERGMode(true);
+      running = true;
+    }
+    if (!running) {
+      continue;
     }
-  } else{
-    incline = 0;
-    amountToChangeIncline = 0;
+    userConfig.setIncline(ergController.update(userConfig.getSimulatedWatts(), userConfig.getSimulatedCad(), micros()));
+#ifdef DEBUG_STACK
+    Serial.printf("ERGController: %d \n", uxTaskGetStackHighWaterMark(ERGControllerTask));
+#endif
+    vTaskDelayUntil(&lastWake, period);
   }
-
-  newIncline = incline - amountToChangeIncline;  //  }
-  userConfig.setIncline(newIncline);
 }
 
-void computeCSC() {  // What was SIG smoking when they came up with the Cycling
-                     // Speed and Cadence Characteristic?
-  if (userConfig.getSimulatedCad() > 50) {
-    float crankRevPeriod = (60 * 1024) / userConfig.getSimulatedCad();
-    spinBLEClient.cscCumulativeCrankRev++;
-    spinBLEClient.cscLastCrankEvtTime += crankRevPeriod;
-    int remainder, quotient;
-    quotient                   = spinBLEClient.cscCumulativeCrankRev / 256;
-    remainder                  = spinBLEClient.cscCumulativeCrankRev % 256;
-    cyclingPowerMeasurement[5] = remainder;
-    cyclingPowerMeasurement[6] = quotient;
-    quotient                   = spinBLEClient.cscLastCrankEvtTime / 256;
-    remainder                  = spinBLEClient.cscLastCrankEvtTime % 256;
-    cyclingPowerMeasurement[7] = remainder;
-    cyclingPowerMeasurement[8] = quotient;
-  }  // ^^Using the old way of setting bytes because I like it and it makes
-     // more sense to me looking at it.
-}
+void passUpstreamCrankEvent(uint16_t revolutions, uint16_t time, uint32_t timestamp) { upstreamCrankEvents.push({revolutions, time, timestamp}); }
 
 void updateIndoorBikeDataChar() {
-  float cadRaw = userConfig.getSimulatedCad();
-  int cad      = static_cast<int>(cadRaw * 2);
-
-  int watts = userConfig.getSimulatedWatts();
-  int hr    = userConfig.getSimulatedHr();
-
-  int speed      = 0;
-  float speedRaw = userConfig.getSimulatedSpeed();
-  if (speedRaw <= 0) {
-    float gearRatio = 1;
-    speed           = ((cad * 2.75 * 2.08 * 60 * gearRatio) / 10);
-  } else {
-    speed = static_cast<int>(speedRaw * 100);
-  }
-  ftmsIndoorBikeData[2] = (uint8_t)(speed & 0xff);
-  ftmsIndoorBikeData[3] = (uint8_t)(speed >> 8);
-  ftmsIndoorBikeData[4] = (uint8_t)(cad & 0xff);
-  ftmsIndoorBikeData[5] = (uint8_t)(cad >> 8);  // cadence value
-  ftmsIndoorBikeData[6] = (uint8_t)(watts & 0xff);
-  ftmsIndoorBikeData[7] = (uint8_t)(watts >> 8);  // power value, constrained to avoid negative values,
-                                                  // although the specification allows for a sint16
-  ftmsIndoorBikeData[8] = (uint8_t)hr;
-  fitnessMachineIndoorBikeData->setValue(ftmsIndoorBikeData, 9);
-  fitnessMachineFeature->notify();
-  fitnessMachineIndoorBikeData->notify();
-}  // ^^Using the New Way of setting Bytes.
+  uint8_t indoorBikeData[IndoorBikeDataEncoder::Size];
+  setIndoorBikeDataValue(indoorBikeData);
+  notifyClients(fitnessMachineIndoorBikeData, ServerNotifyChannels::IndoorBikeData, indoorBikeData, sizeof(indoorBikeData));
+}
 
 void updateCyclingPowerMesurementChar() {
-  int remainder, quotient;
-  quotient                   = userConfig.getSimulatedWatts() / 256;
-  remainder                  = userConfig.getSimulatedWatts() % 256;
-  cyclingPowerMeasurement[2] = remainder;
-  cyclingPowerMeasurement[3] = quotient;
-  cyclingPowerMeasurementCharacteristic->setValue(cyclingPowerMeasurement, 9);
-
-  // Data(18), Sep(data/2), Static(13), Nul(1) == 41, rounded up
-  char logBuf[50];
-  char *logBufP = logBuf;
-  for (const auto &it : cyclingPowerMeasurement) {
-    logBufP += sprintf(logBufP, "%02x ", it);
-  }
-  strcat(logBufP, "<-- CPMC sent");
-
-  cyclingPowerMeasurementCharacteristic->notify();
-  debugDirector(String(logBuf), true);
+  uint8_t cyclingPowerMeasurement[CyclingPowerMeasurementEncoder::Size];
+  setCyclingPowerMeasurementValue(cyclingPowerMeasurement);
+  notifyClients(cyclingPowerMeasurementCharacteristic, ServerNotifyChannels::CyclingPowerMeasurement, cyclingPowerMeasurement, sizeof(cyclingPowerMeasurement));
+  SS2K_LOG(BLE_SERVER, VERBOSE, "%s<-- CPMC sent", LogRing::Hex(cyclingPowerMeasurement, sizeof(cyclingPowerMeasurement)));
 }
 
 void updateHeartRateMeasurementChar() {
-  heartRateMeasurement[1] = userConfig.getSimulatedHr();
-  heartRateMeasurementCharacteristic->setValue(heartRateMeasurement, 2);
-
-  // Data(10), Sep(data/2), Static(11), Nul(1) == 26, rounded up
-  char logBuf[35];
-  char *logBufP = logBuf;
-  for (const auto &it : heartRateMeasurement) {
-    logBufP += sprintf(logBufP, "%02x ", it);
-  }
-  strcat(logBufP, "<-- HR sent");
-
-  heartRateMeasurementCharacteristic->notify();
-  debugDirector(String(logBuf), true);
+  uint8_t heartRateMeasurement[HeartRateMeasurementEncoder::Size];
+  setHeartRateMeasurementValue(heartRateMeasurement);
+  notifyClients(heartRateMeasurementCharacteristic, ServerNotifyChannels::HeartRateMeasurement, heartRateMeasurement, sizeof(heartRateMeasurement));
+  SS2K_LOG(BLE_SERVER, VERBOSE, "%s<-- HR sent", LogRing::Hex(heartRateMeasurement, sizeof(heartRateMeasurement)));
 }
 
 // Creating Server Connection Callbacks
 
 void MyServerCallbacks::onConnect(BLEServer *pServer, ble_gap_conn_desc *desc) {
-  debugDirector("Bluetooth Remote Client Connected: " + String(NimBLEAddress(desc->peer_ota_addr).toString().c_str()) +
-                " Connected Clients: " + String(pServer->getConnectedCount()));
-  updateConnParametersFlag = true;
-  bleConnDesc              = desc->conn_handle;
+  SS2K_LOG(BLE_SERVER, INFO, "Bluetooth Remote Client Connected: %s Connected Clients: %d", NimBLEAddress(desc->peer_ota_addr).toString().c_str(),
+           pServer->getConnectedCount());
+  serverLinkEvents.push({ServerLinkEvent::Connect, desc->conn_handle, 0, false});
 
   if (pServer->getConnectedCount() < CONFIG_BT_NIMBLE_MAX_CONNECTIONS - NUM_BLE_DEVICES) {
     BLEDevice::startAdvertising();
   } else {
-    debugDirector("Max Remote Client Connections Reached");
+    SS2K_LOG(BLE_SERVER, WARNING, "Max Remote Client Connections Reached");
     BLEDevice::stopAdvertising();
   }
 }
 
-void MyServerCallbacks::onDisconnect(BLEServer *pServer) {
-  debugDirector("Bluetooth Remote Client Disconnected. Remaining Clients: " + String(pServer->getConnectedCount()));
+void MyServerCallbacks::onDisconnect(BLEServer *pServer, ble_gap_conn_desc *desc) {
+  serverLinkEvents.push({ServerLinkEvent::Disconnect, desc->conn_handle, 0, false});
+  SS2K_LOG(BLE_SERVER, INFO, "Bluetooth Remote Client Disconnected. Remaining Clients: %d", pServer->getConnectedCount());
   BLEDevice::startAdvertising();
 }
 
-void MyCallbacks::onWrite(BLECharacteristic *pCharacteristic) {
-  std::string rxValue = pCharacteristic->getValue();
+// Runs in the NimBLE host task, so it only copies the write into the queue.
+void MyCallbacks::onWrite(BLECharacteristic *pCharacteristic, ble_gap_conn_desc *desc) {
+  FTMSControlPoint::Command command;
+  std::string value  = pCharacteristic->getValue();
+  command.connHandle = desc->conn_handle;
+  command.length     = min(value.length(), FTMSControlPoint::MaxLength);
+  memcpy(command.data, value.data(), command.length);
+  if (xQueueSend(controlPointQueue, &command, 0) != pdTRUE) {
+    controlPointDropped++;
+  }
+}
 
-  if (rxValue.length() > 1) {
-    for (const auto &text : rxValue) {  // Range-for!
-      debugDirector(String(text, HEX) + " ", false);
-    }
-    debugDirector("<-- From APP ", false);
-    /* 0x11 17 means FTMS Incline Control Mode  (aka SIM mode)*/
+// Called by indicate() for each subscriber, in the worker's context.
+void MyCallbacks::onStatus(BLECharacteristic *pCharacteristic, Status s, int code) {
+  if (s != Status::SUCCESS_INDICATE) {
+    controlPointIndicateFailures++;
+  }
+}
 
-    if (static_cast<int>(rxValue[0]) == 17) {
-      signed char buf[2];
-      buf[0] = rxValue[3];  // (Least significant byte)
-      buf[1] = rxValue[4];  // (Most significant byte)
+// Applies a valid control point command and returns the FTMS result code.
+static uint8_t applyControlPointCommand(const FTMSControlPoint::Command &command) {
+  const uint8_t *data = command.data;
+  switch (command.getOpCode()) {
+    case FTMSControlPoint::OpCodes::SetIndoorBikeSimulationParameters: {
+      int grade = bytes_to_u16(data[4], data[3]);  // 0.01 %
+      xTaskNotify(ERGControllerTask, ERGGradeCommand | static_cast<uint16_t>(grade), eSetValueWithOverwrite);
+      return FTMSControlPoint::ResultCodes::Success;
+    }
 
-      int port = bytes_to_u16(buf[1], buf[0]);
-      userConfig.setIncline(port);
-      if (userConfig.getERGMode()) {
-        userConfig.setERGMode(false);
+    case FTMSControlPoint::OpCodes::SetTargetPower: {
+      if (!spinBLEClient.connectedPM) {
+        return FTMSControlPoint::ResultCodes::OperationFailed;
       }
-      debugDirector(" Target Incline: " + String((userConfig.getIncline() / 100)), false);
+      int targetWatts = bytes_to_u16(data[2], data[1]);
+      // Never negative, which would read as a grade.
+      xTaskNotify(ERGControllerTask, targetWatts > 0 ? targetWatts : 0, eSetValueWithOverwrite);
+      SS2K_LOG(ERG, INFO, "ERG MODE Target: %d Current: %d", targetWatts, userConfig.getSimulatedWatts());
+      return FTMSControlPoint::ResultCodes::Success;
     }
-    debugDirector("");
 
-    /* 0x05 5 means FTMS Watts Control Mode (aka ERG mode) */
-    if ((static_cast<int>(rxValue[0]) == 5) && (spinBLEClient.connectedPM)) {
-      int targetWatts = bytes_to_u16(rxValue[2], rxValue[1]);
-      if (!userConfig.getERGMode()) {
-        userConfig.setERGMode(true);
+    default:  // Request control, reset, start and stop need nothing from us
+      return FTMSControlPoint::ResultCodes::Success;
+  }
+}
+
+void ftmsControlPointWorker(void *pvParameters) {
+  FTMSControlPoint::Command batch[CONTROL_POINT_QUEUE_LENGTH];
+  uint32_t reportedDrops    = 0;
+  uint32_t reportedFailures = 0;
+  for (;;) {
+    if (xQueueReceive(controlPointQueue, &batch[0], portMAX_DELAY) != pdTRUE) {
+      continue;
+    }
+    // Take whatever else has arrived, so a burst of simulation parameters collapses to the last one.
+    size_t count = 1;
+    while (count < CONTROL_POINT_QUEUE_LENGTH && xQueueReceive(controlPointQueue, &batch[count], 0) == pdTRUE) {
+      count++;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+      const FTMSControlPoint::Command &command = batch[i];
+      SS2K_LOG(BLE_SERVER, VERBOSE, "%s<-- From APP", LogRing::Hex(command.data, command.length));
+
+      uint8_t result = FTMSControlPoint::validate(command);
+      if (result == FTMSControlPoint::ResultCodes::Success && !FTMSControlPoint::isSuperseded(batch, count, i)) {
+        result = applyControlPointCommand(command);
       }
-      computeERG(userConfig.getSimulatedWatts(), targetWatts);
-      debugDirector("ERG MODE", false);
-      debugDirector(" Target: " + String(targetWatts), false);
-      debugDirector(" Current: " + String(userConfig.getSimulatedWatts()),
-                    false);  // not displaying numbers less than 256 correctly
-                             // but they do get sent to Zwift correctly.
-      debugDirector(" Incline: " + String(userConfig.getIncline() / 100), false);
-      debugDirector("");
+
+      // ATT allows one indication in flight per connection, so the response goes through indicate(), which
+      // waits for each subscriber's confirmation before the next. That sends it to every client subscribed to
+      // the control point, which is the app in control, and skips the others.
+      uint8_t response[FTMSControlPoint::ResponseSize];
+      size_t length = FTMSControlPoint::encodeResponse(response, command.getOpCode(), result);
+      fitnessMachineControlPoint->setValue(response, length);
+      fitnessMachineControlPoint->indicate();
     }
+
+    if (controlPointDropped != reportedDrops) {
+      reportedDrops = controlPointDropped;
+      SS2K_LOG(BLE_SERVER, WARNING, "Control point queue full, %u writes dropped", reportedDrops);
+    }
+    if (controlPointIndicateFailures != reportedFailures) {
+      reportedFailures = controlPointIndicateFailures;
+      SS2K_LOG(BLE_SERVER, WARNING, "Control point responses not confirmed: %u", reportedFailures);
+    }
+#ifdef DEBUG_STACK
+    Serial.printf("FTMSControlPoint: %d \n", uxTaskGetStackHighWaterMark(FTMSControlPointTask));
+#endif
+  }
+}
+
+void MeasurementCallbacks::onSubscribe(BLECharacteristic *pCharacteristic, ble_gap_conn_desc *desc, uint16_t subValue) {
+  serverLinkEvents.push({ServerLinkEvent::Subscribe, desc->conn_handle, this->channel, subValue != 0});
+}
+
+String returnClientStatsJSON() {
+  DynamicJsonDocument doc(CLIENTSTATS_JSON_SIZE);
+  JsonArray clients = doc.createNestedArray("clients");
+  for (uint8_t slot = 0; slot < NotifyFanout::MaxPeers; slot++) {
+    const NotifyFanout::Peer &peer = notifyFanout.getPeer(slot);
+    if (peer.connHandle == NotifyFanout::NoConnection) {
+      continue;
+    }
+    JsonObject client       = clients.createNestedObject();
+    client["connHandle"]    = peer.connHandle;
+    client["subscribed"]    = peer.subscribed;
+    client["sent"]          = peer.sent;
+    client["failed"]        = peer.failed;
+    client["skipped"]       = peer.skipped;
+    client["failureStreak"] = peer.failureStreak;
+  }
+
+  String output;
+  serializeJson(doc, output);
+  return output;
+}
+
+void updateServerConnections() {
+  updateServerLinks();
+
+  // Apps get our fastest notifications and write ERG targets, so their links are kept short.
+  const float notifyRate      = max(max(INDOOR_BIKE_DATA_MAX_RATE, CYCLING_POWER_MAX_RATE), HEART_RATE_MAX_RATE);
+  const size_t largestPayload = max(max(IndoorBikeDataEncoder::Size, CyclingPowerMeasurementEncoder::Size), HeartRateMeasurementEncoder::Size);
+  ConnectionManager::Link link;
+  while (serverConnections.takePending(micros(), &link)) {
+    const ConnectionParameters parameters = ConnectionManager::getParameters(link.role, notifyRate, largestPayload);
+    BLEDevice::getServer()->updateConnParams(link.connHandle, parameters.minInterval, parameters.maxInterval, parameters.latency, parameters.supervisionTimeout);
+    requestLinkLayerFeatures(link.connHandle, parameters);
   }
 }
 
@@ -355,5 +509,23 @@ void calculateInstPwrFromHR() {
   userConfig.setSimulatedCad(90);
 #endif
 
-  debugDirector("Power From HR: " + String(avgP));
+  SS2K_LOG(ERG, DEBUG, "Power From HR: %d", avgP);
+}
+
+String returnERGStatsJSON() {
+  DynamicJsonDocument doc(ERGSTATS_JSON_SIZE);
+  const ERGController::Metrics &metrics = ergController.getMetrics();
+  doc["ergMode"]           = userConfig.getERGMode();
+  doc["target"]            = metrics.target;
+  doc["settled"]           = metrics.settled;
+  doc["settlingTimeMs"]    = metrics.settlingTime / 1000;
+  doc["overshootW"]        = metrics.overshoot;
+  doc["currentOvershootW"] = metrics.currentOvershoot;
+  doc["steps"]             = metrics.steps;
+  doc["updates"]           = metrics.updates;
+  doc["gatedUpdates"]      = metrics.gatedUpdates;
+  doc["saturatedUpdates"]  = metrics.saturatedUpdates;
+  String output;
+  serializeJson(doc, output);
+  return output;
 }
@@ -13,6 +13,16 @@
 void setupBLE() {  // Common BLE setup for both client and server
   debugDirector("Starting Arduino BLE Client application...");
   BLEDevice::init(userConfig.getDeviceName());
+  loadPowerTable();
+
+  xTaskCreatePinnedToCore(BLESensorProcessing,        /* Task function. */
+                          "BLESensorProcessingTask",  /* name of task. */
+                          3000,                       /* Stack size of task*/
+                          NULL,                       /* parameter of the task */
+                          2,                          /* priority of the task - above the 1s loops so packets are handled on arrival*/
+                          &BLESensorProcessingTask,   /* Task handle to keep track of created task */
+                          1);                         /* pin task to core 1 */
+
   spinBLEClient.start();
   startBLEServer();
 
@@ -47,7 +47,7 @@ void startWifi() {
   int i = 0;
 
   // Trying Station mode first:
-  debugDirector("Connecting to: " + String(userConfig.getSsid()));
+  SS2K_LOG(HTTP, INFO, "Connecting to: %s", userConfig.getSsid());
   if (String(WiFi.SSID()) != userConfig.getSsid()) {
     WiFi.mode(WIFI_STA);
     WiFi.setTxPower(WIFI_POWER_19_5dBm);
@@ -60,7 +60,7 @@ void startWifi() {
     i++;
     if (i > WIFI_CONNECT_TIMEOUT || (String(userConfig.getSsid()) == DEVICE_NAME)) {
       i = 0;
-      debugDirector("Couldn't Connect. Switching to AP mode");
+      SS2K_LOG(HTTP, WARNING, "Couldn't Connect. Switching to AP mode");
       WiFi.disconnect();
       WiFi.mode(WIFI_AP);
       break;
@@ -89,13 +89,13 @@ void startWifi() {
   }
 
   if (!MDNS.begin(userConfig.getDeviceName())) {
-    debugDirector("Error setting up MDNS responder!");
+    SS2K_LOG(HTTP, WARNING, "Error setting up MDNS responder!");
   }
 
   MDNS.addService("http", "_tcp", 80);
   MDNS.addServiceTxt("http", "_tcp", "lf", "0");
-  debugDirector("Connected to " + String(userConfig.getSsid()) + " IP address: " + myIP.toString(), true, true);
-  debugDirector(String("Open http://") + userConfig.getDeviceName() + ".local/");
+  SS2K_LOG(HTTP, INFO, "Connected to %s IP address: %s", userConfig.getSsid(), myIP.toString().c_str());
+  SS2K_LOG(HTTP, INFO, "Open http://%s.local/", userConfig.getDeviceName());
   WiFi.setTxPower(WIFI_POWER_19_5dBm);
 
   if (WiFi.getMode() == WIFI_STA) {
@@ -112,7 +112,7 @@ void startWifi() {
 }
 
 void startHttpServer() {
-  server.onNotFound([]() { debugDirector("Link Not Found: " + server.uri()); });
+  server.onNotFound([]() { SS2K_LOG(HTTP, WARNING, "Link Not Found: %s", server.uri().c_str()); });
 
   /********************************************Begin
    * Handlers***********************************/
@@ -131,7 +131,7 @@ void startHttpServer() {
   server.on("/send_settings", settingsProcessor);
 
   server.on("/BLEScan", []() {
-    debugDirector("Scanning from web request");
+    SS2K_LOG(HTTP, INFO, "Scanning from web request");
     String response =
         "<!DOCTYPE html><html><body>Scanning for BLE Devices. Please wait "
         "15 seconds.</body><script> setTimeout(\"location.href = 'http://" +
@@ -142,7 +142,7 @@ void startHttpServer() {
   });
 
   server.on("/load_defaults.html", []() {
-    debugDirector("Setting Defaults from Web Request");
+    SS2K_LOG(HTTP, INFO, "Setting Defaults from Web Request");
     SPIFFS.format();
     userConfig.setDefaults();
     userConfig.saveToSPIFFS();
@@ -156,7 +156,7 @@ void startHttpServer() {
   });
 
   server.on("/reboot.html", []() {
-    debugDirector("Rebooting from Web Request");
+    SS2K_LOG(HTTP, INFO, "Rebooting from Web Request");
     String response = "Rebooting....<script> setTimeout(\"location.href = 'http://" + myIP.toString() + "/index.html';\",500); </script>";
     server.send(200, "text/html", response);
     vTaskDelay(100 / portTICK_PERIOD_MS);
@@ -168,14 +168,14 @@ void startHttpServer() {
     if (value == "enable") {
       userConfig.setSimulateHr(true);
       server.send(200, "text/plain", "OK");
-      debugDirector("HR Simulator turned on");
+      SS2K_LOG(HTTP, INFO, "HR Simulator turned on");
     } else if (value == "disable") {
       userConfig.setSimulateHr(false);
       server.send(200, "text/plain", "OK");
-      debugDirector("HR Simulator turned off");
+      SS2K_LOG(HTTP, INFO, "HR Simulator turned off");
     } else {
       userConfig.setSimulatedHr(value.toInt());
-      debugDirector("HR is now: " + String(userConfig.getSimulatedHr()));
+      SS2K_LOG(HTTP, INFO, "HR is now: %d", userConfig.getSimulatedHr());
       server.send(200, "text/plain", "OK");
     }
   });
@@ -185,14 +185,14 @@ void startHttpServer() {
     if (value == "enable") {
       userConfig.setSimulateWatts(true);
       server.send(200, "text/plain", "OK");
-      debugDirector("Watt Simulator turned on");
+      SS2K_LOG(HTTP, INFO, "Watt Simulator turned on");
     } else if (value == "disable") {
       userConfig.setSimulateWatts(false);
       server.send(200, "text/plain", "OK");
-      debugDirector("Watt Simulator turned off");
+      SS2K_LOG(HTTP, INFO, "Watt Simulator turned off");
     } else {
       userConfig.setSimulatedWatts(value.toInt());
-      debugDirector("Watts are now: " + String(userConfig.getSimulatedWatts()));
+      SS2K_LOG(HTTP, INFO, "Watts are now: %d", userConfig.getSimulatedWatts());
       server.send(200, "text/plain", "OK");
     }
   });
@@ -202,18 +202,38 @@ void startHttpServer() {
     if (value == "enable") {
       userConfig.setSimulateCad(true);
       server.send(200, "text/plain", "OK");
-      debugDirector("CAD Simulator turned on");
+      SS2K_LOG(HTTP, INFO, "CAD Simulator turned on");
     } else if (value == "disable") {
       userConfig.setSimulateCad(false);
       server.send(200, "text/plain", "OK");
-      debugDirector("CAD Simulator turned off");
+      SS2K_LOG(HTTP, INFO, "CAD Simulator turned off");
     } else {
       userConfig.setSimulatedCad(value.toInt());
-      debugDirector("CAD is now: " + String(userConfig.getSimulatedCad()));
+      SS2K_LOG(HTTP, INFO, "CAD is now: %.2f", userConfig.getSimulatedCad());
       server.send(200, "text/plain", "OK");
     }
   });
 
+  server.on("/sensortrace", []() {
+    String value = server.arg("value");
+    if (value == "start") {
+      startSensorTrace();
+      server.send(200, "text/plain", "OK");
+    } else if (value == "stop") {
+      stopSensorTrace();
+      server.send(200, "text/plain", "OK");
+    } else if (isSensorTraceRecording()) {
+      server.send(409, "text/plain", "Stop the sensor trace first");
+    } else if (SPIFFS.exists(SENSOR_TRACE_FILENAME)) {
+      File file = SPIFFS.open(SENSOR_TRACE_FILENAME, FILE_READ);
+      server.sendHeader("Content-Disposition", "attachment; filename=sensortrace.bin");
+      server.streamFile(file, "application/octet-stream");
+      file.close();
+    } else {
+      server.send(404, "text/plain", "No sensor trace recorded");
+    }
+  });
+
   server.on("/configJSON", []() {
     String tString;
     tString = userConfig.returnJSON();
@@ -223,6 +243,24 @@ void startHttpServer() {
     debugToHTML = " ";
   });
 
+  server.on("/linkstats", []() { server.send(200, "application/json", spinBLEClient.returnLinkStatsJSON()); });
+
+  server.on("/clientstats", []() { server.send(200, "application/json", returnClientStatsJSON()); });
+
+  server.on("/ergstats", []() { server.send(200, "application/json", returnERGStatsJSON()); });
+
+  server.on("/stepperstats", []() { server.send(200, "application/json", returnStepperStatsJSON()); });
+
+  // Changes log levels at runtime, e.g. /loglevels?erg=3. Never above what was built in.
+  server.on("/loglevels", []() {
+    for (int i = 0; i < LOG_CATEGORIES; i++) {
+      if (server.hasArg(logCategoryNames[i])) {
+        setLogLevel(i, server.arg(logCategoryNames[i]).toInt());
+      }
+    }
+    server.send(200, "application/json", returnLogLevelsJSON());
+  });
+
   server.on("/PWCJSON", []() {
     String tString;
     tString = userPWC.returnJSON();
@@ -252,7 +290,7 @@ void startHttpServer() {
         HTTPUpload &upload = server.upload();
         if (upload.filename == String("firmware.bin").c_str()) {
           if (upload.status == UPLOAD_FILE_START) {
-            debugDirector("Update: " + upload.filename);
+            SS2K_LOG(HTTP, INFO, "Update: %s", upload.filename.c_str());
             if (!Update.begin(UPDATE_SIZE_UNKNOWN)) {  // start with max
                                                        // available size
               Update.printError(Serial);
@@ -278,7 +316,7 @@ void startHttpServer() {
             if (!filename.startsWith("/")) {
               filename = "/" + filename;
             }
-            debugDirector("handleFileUpload Name: " + filename);
+            SS2K_LOG(HTTP, INFO, "handleFileUpload Name: %s", filename.c_str());
             fsUploadFile = SPIFFS.open(filename, "w");
             filename     = String();
           } else if (upload.status == UPLOAD_FILE_WRITE) {
@@ -289,7 +327,7 @@ void startHttpServer() {
             if (fsUploadFile) {
               fsUploadFile.close();
             }
-            debugDirector(String("handleFileUpload Size: ") + String(upload.totalSize));
+            SS2K_LOG(HTTP, INFO, "handleFileUpload Size: %u", upload.totalSize);
             server.send(200, "text/plain", String(upload.filename + " Uploaded Sucessfully."));
           }
         }
@@ -317,7 +355,7 @@ void startHttpServer() {
 #endif
 
   server.begin();
-  debugDirector("HTTP server started");
+  SS2K_LOG(HTTP, INFO, "HTTP server started");
 }
 
 void webClientUpdate(void *pvParameters) {
@@ -343,7 +381,7 @@ void handleIndexFile() {
     server.streamFile(file, "text/html");
     file.close();
   } else {
-    debugDirector(filename + " not found. Sending builtin Index.html");
+    SS2K_LOG(HTTP, WARNING, "%s not found. Sending builtin Index.html", filename.c_str());
     server.send(200, "text/html", noIndexHTML);
   }
 }
@@ -356,9 +394,9 @@ void handleSpiffsFile() {
     File file = SPIFFS.open(filename, FILE_READ);
     server.streamFile(file, "text/" + fileType);
     file.close();
-    debugDirector("Served " + filename);
+    SS2K_LOG(HTTP, DEBUG, "Served %s", filename.c_str());
   } else {
-    debugDirector(filename + " not found. Sending builtin Index.html");
+    SS2K_LOG(HTTP, WARNING, "%s not found. Sending builtin Index.html", filename.c_str());
     server.send(404, "text/html",
                 "<html><body><h1>ERROR 404 <br> FILE NOT "
                 "FOUND!</h1></body></html>");
@@ -478,7 +516,7 @@ void settingsProcessor() {
         myIP.toString() + "/index.html';\",1000);</script></html>";
   }
   server.send(200, "text/html", response);
-  debugDirector("Config Updated From Web");
+  SS2K_LOG(HTTP, INFO, "Config Updated From Web");
   userConfig.saveToSPIFFS();
   userConfig.printFile();
   userPWC.saveToSPIFFS();
@@ -493,7 +531,7 @@ void FirmwareUpdate() {
   // WiFiClientSecure client;
 
   client.setCACert(rootCACertificate);
-  debugDirector("Checking for newer firmware:");
+  SS2K_LOG(HTTP, INFO, "Checking for newer firmware:");
   http.begin(userConfig.getFirmwareUpdateURL() + String(FW_VERSIONFILE),
              rootCACertificate);  // check version URL
   delay(100);
@@ -503,10 +541,10 @@ void FirmwareUpdate() {
   if (httpCode == HTTP_CODE_OK) {  // if version received
     payload = http.getString();    // save received version
     payload.trim();
-    debugDirector("  - Server version: " + payload);
+    SS2K_LOG(HTTP, INFO, "  - Server version: %s", payload.c_str());
     internetConnection = true;
   } else {
-    debugDirector("error downloading " + String(FW_VERSIONFILE) + " " + String(httpCode));
+    SS2K_LOG(HTTP, WARNING, "error downloading %s %d", FW_VERSIONFILE, httpCode);
     internetConnection = false;
   }
 
@@ -515,34 +553,34 @@ void FirmwareUpdate() {
     bool updateAnyway = false;
     if (!SPIFFS.exists("/index.html")) {
       updateAnyway = true;
-      debugDirector("  -index.html not found. Forcing update");
+      SS2K_LOG(HTTP, WARNING, "  -index.html not found. Forcing update");
     }
     Version availiableVer(payload.c_str());
     Version currentVer(FIRMWARE_VERSION);
 
     if ((availiableVer > currentVer) || (updateAnyway)) {
-      debugDirector("New firmware detected!");
-      debugDirector("Upgrading from " + String(FIRMWARE_VERSION) + " to " + payload);
+      SS2K_LOG(HTTP, INFO, "New firmware detected!");
+      SS2K_LOG(HTTP, INFO, "Upgrading from %s to %s", FIRMWARE_VERSION, payload.c_str());
 
       // Update Spiffs
       httpUpdate.setLedPin(LED_BUILTIN, LOW);
-      debugDirector("Updating FileSystem");
+      SS2K_LOG(HTTP, INFO, "Updating FileSystem");
       t_httpUpdate_return ret = httpUpdate.updateSpiffs(client, userConfig.getFirmwareUpdateURL() + String(FW_SPIFFSFILE));
       vTaskDelay(100 / portTICK_PERIOD_MS);
       switch (ret) {
         case HTTP_UPDATE_OK:
-          debugDirector("Saving Config.txt");
+          SS2K_LOG(HTTP, INFO, "Saving Config.txt");
           userConfig.saveToSPIFFS();
           userPWC.saveToSPIFFS();
-          debugDirector("Updating Program");
+          SS2K_LOG(HTTP, INFO, "Updating Program");
           break;
 
         case HTTP_UPDATE_NO_UPDATES:
-          debugDirector("HTTP_UPDATE_NO_UPDATES");
+          SS2K_LOG(HTTP, INFO, "HTTP_UPDATE_NO_UPDATES");
           break;
 
         case HTTP_UPDATE_FAILED:
-          debugDirector("SPIFFS Update Failed: " + String(httpUpdate.getLastError()) + " : " + httpUpdate.getLastErrorString());
+          SS2K_LOG(HTTP, ERROR, "SPIFFS Update Failed: %d : %s", httpUpdate.getLastError(), httpUpdate.getLastErrorString().c_str());
           break;
       }
 
@@ -550,19 +588,19 @@ void FirmwareUpdate() {
       ret = httpUpdate.update(client, userConfig.getFirmwareUpdateURL() + String(FW_BINFILE));
       switch (ret) {
         case HTTP_UPDATE_FAILED:
-          debugDirector("HTTP_UPDATE_FAILD Error " + String(httpUpdate.getLastError()) + " : " + httpUpdate.getLastErrorString());
+          SS2K_LOG(HTTP, ERROR, "HTTP_UPDATE_FAILD Error %d : %s", httpUpdate.getLastError(), httpUpdate.getLastErrorString().c_str());
           break;
 
         case HTTP_UPDATE_NO_UPDATES:
-          debugDirector("HTTP_UPDATE_NO_UPDATES");
+          SS2K_LOG(HTTP, INFO, "HTTP_UPDATE_NO_UPDATES");
           break;
 
         case HTTP_UPDATE_OK:
-          debugDirector("HTTP_UPDATE_OK");
+          SS2K_LOG(HTTP, INFO, "HTTP_UPDATE_OK");
           break;
       }
     } else {  // don't update
-      debugDirector("  - Current Version: " + String(FIRMWARE_VERSION));
+      SS2K_LOG(HTTP, INFO, "  - Current Version: %s", FIRMWARE_VERSION);
     }
   }
 }
@@ -10,16 +10,18 @@
 #include <Arduino.h>
 #include <SPIFFS.h>
 #include <HardwareSerial.h>
+#include <ArduinoJson.h>
 
 String debugToHTML = "<br>Firmware Version " + String(FIRMWARE_VERSION);
-bool lastDir       = true;  // Stepper Last Direction
+LogRing logRing;
+const char *const logCategoryNames[LOG_CATEGORIES] = {"bleClient", "bleServer", "erg", "stepper", "http"};
+static const int8_t logLevelLimits[LOG_CATEGORIES] = {LOG_LEVEL_BLE_CLIENT, LOG_LEVEL_BLE_SERVER, LOG_LEVEL_ERG, LOG_LEVEL_STEPPER, LOG_LEVEL_HTTP};
+int8_t logLevels[LOG_CATEGORIES]                   = {LOG_LEVEL_BLE_CLIENT, LOG_LEVEL_BLE_SERVER, LOG_LEVEL_ERG, LOG_LEVEL_STEPPER, LOG_LEVEL_HTTP};
 
 // Debounce Setup
 uint64_t lastDebounceTime = 0;    // the last time the output pin was toggled
 uint64_t debounceDelay    = 1000;  // the debounce time; increase if the output flickers
 
-// Stepper Speed - Lower is faster
-int maxStepperSpeed = 600;
 int shifterPosition = 0;
 int stepperPosition = 0;
 HardwareSerial stepperSerial(2);
@@ -35,6 +37,23 @@ bool scanDelayRunning   = false;
 // to prevent stuttering
 TaskHandle_t moveStepperTask;
 
+// Step pulses are timed by a hardware timer, from the moves moveStepper() queues.
+StepGenerator stepGenerator;
+hw_timer_t *stepTimer = nullptr;
+
+// After setup the driver's UART belongs to stepperMonitorWorker(). Settings changes reach it as notification
+// bits, and it scales the currents set up for the driver by what the monitor allows.
+TaskHandle_t stepperMonitorTask;
+StepperMonitor stepperMonitor({STEPPER_THERMAL_STEP, STEPPER_THERMAL_STEP_INTERVAL, STEPPER_MIN_CURRENT, STEPPER_COOL_DOWN_TIME,
+                               STEPPER_LONG_HOLD_CURRENT, STEPPER_LONG_HOLD_TIME});
+static const uint32_t StepperPowerChanged = 1 << 0;
+static const uint32_t StealthchopChanged  = 1 << 1;
+uint8_t fullRunCurrent                    = 0;  // IRUN and IHOLD at 100 %
+uint8_t fullHoldCurrent                   = 0;
+// Drift the monitor finds reaches moveStepper() as its task notification value, and is applied at rest.
+StepReconciler stepReconciler;
+bool reconcileSteps = false;  // Only once the driver's microstep setting is known
+
 ///////////// Initialize the Config /////////////
 userParameters userConfig;
 physicalWorkingCapacity userPWC;
@@ -44,6 +63,13 @@ physicalWorkingCapacity userPWC;
 void setup() {
   // Serial port for debugging purposes
   Serial.begin(512000);
+  xTaskCreatePinnedToCore(logDrainWorker, /* Task function. */
+                          "LogDrainTask", /* name of task. */
+                          3000,           /* Stack size of task */
+                          NULL,           /* parameter of the task */
+                          1,              /* priority of the task */
+                          NULL,           /* Task handle to keep track of created task */
+                          1);             /* pin task to core 1 */
   stepperSerial.begin(57600, SERIAL_8N2, STEPPERSERIAL_RX, STEPPERSERIAL_TX);
   debugDirector("Compiled " + String(__DATE__) + String(__TIME__));
 
@@ -81,17 +107,22 @@ void setup() {
   setupTMCStepperDriver();
 
   debugDirector("Setting up cpu Tasks");
-  disableCore0WDT();  // Disable the watchdog timer on core 0 (so long stepper
-                      // moves don't cause problems)
-
   xTaskCreatePinnedToCore(moveStepper,           /* Task function. */
                           "moveStepperFunction", /* name of task. */
-                          900,                   /* Stack size of task */
+                          2048,                  /* Stack size of task */
                           NULL,                  /* parameter of the task */
                           18,                    /* priority of the task  - 29 worked  at 1 I get stuttering */
                           &moveStepperTask,      /* Task handle to keep track of created task */
                           0);                    /* pin task to core 0 */
 
+  xTaskCreatePinnedToCore(stepperMonitorWorker, /* Task function. */
+                          "StepperMonitorTask", /* name of task. */
+                          2500,                 /* Stack size of task */
+                          NULL,                 /* parameter of the task */
+                          1,                    /* priority of the task */
+                          &stepperMonitorTask,  /* Task handle to keep track of created task */
+                          1);                   /* pin task to core 1 */
+
   digitalWrite(LED_PIN, HIGH);
 
   startWifi();
@@ -117,61 +148,50 @@ void loop() {
   vTaskDelay(1000 / portTICK_RATE_MS);
   scanIfShiftersHeld();
 
-  if (debugToHTML.length() > 500) {  // Clear up memory
-    debugToHTML = "<br>HTML Debug Truncated. Increase buffer if required.";
-  }
-
 #ifdef DEBUG_STACK
   Serial.printf("Stepper: %d \n", uxTaskGetStackHighWaterMark(moveStepperTask));
+  Serial.printf("StepperMonitor: %d \n", uxTaskGetStackHighWaterMark(stepperMonitorTask));
 #endif
 }
 #endif
 
+void IRAM_ATTR onStepTimer() {
+  const uint8_t pins = stepGenerator.tick();
+  digitalWrite(DIR_PIN, (pins & StepGenerator::DirectionPin) ? HIGH : LOW);
+  digitalWrite(STEP_PIN, (pins & StepGenerator::StepPin) ? HIGH : LOW);
+}
+
+// The enable pin and step timer StepperMotion drives.
+class FirmwareStepperDriver : public StepperDriver {
+ public:
+  void setEnabled(bool enabled) override { digitalWrite(ENABLE_PIN, enabled ? LOW : HIGH); }  // High disables the output FETs
+  void startTimer() override { timerAlarmEnable(stepTimer); }
+  void stopTimer() override { timerAlarmDisable(stepTimer); }
+};
+
+// Plans the motion to the target every STEPPER_PLAN_INTERVAL and queues the steps of each interval for the
+// step timer, keeping STEPPER_LOOKAHEAD ms ahead of it. The timer only runs while there are steps to send.
 void moveStepper(void *pvParameters) {
-  int acceleration   = maxStepperSpeed;
-  int targetPosition = 0;
+  FirmwareStepperDriver stepperDriver;
+  StepperMotion motion(stepGenerator, stepperDriver, {STEPPER_MAX_VELOCITY, STEPPER_MAX_ACCELERATION, STEPPER_MAX_JERK}, STEPPER_PLAN_INTERVAL, STEPPER_LOOKAHEAD,
+                       STEPPER_DISABLE_DELAY);
+  TickType_t lastWake = xTaskGetTickCount();
+
+  // Attached from here so the interrupt runs on this core.
+  stepTimer = timerBegin(STEPPER_TIMER, 80, true);  // 1 MHz
+  timerAttachInterrupt(stepTimer, &onStepTimer, true);
+  timerAlarmWrite(stepTimer, 1000000 / StepGenerator::TickRate, true);
 
   while (1) {
-    targetPosition = shifterPosition + (userConfig.getIncline() * userConfig.getInclineMultiplier());
-    //debugDirector("Cadence =" +String(userConfig.getSimulatedCad()),true,false);
-    if (stepperPosition == targetPosition) {
-      vTaskDelay(300 / portTICK_PERIOD_MS);
-      if (connectedClientCount() == 0) {
-        digitalWrite(ENABLE_PIN,
-                     HIGH);  // disable output FETs so stepper can cool
-      }
-      vTaskDelay(300 / portTICK_PERIOD_MS);
-    } else {
-      digitalWrite(ENABLE_PIN, LOW);
-      vTaskDelay(1);
-
-      if (stepperPosition < targetPosition) {
-        if (lastDir == false) {
-          vTaskDelay(100);  // Stepper was running in opposite
-                            // direction. Give it time to stop.
-        }
-        digitalWrite(DIR_PIN, HIGH);
-        digitalWrite(STEP_PIN, HIGH);
-        delayMicroseconds(acceleration);
-        digitalWrite(STEP_PIN, LOW);
-        delayMicroseconds(acceleration);
-        stepperPosition++;
-        lastDir = true;
-        
-      } else {  // must be (stepperPosition > targetPosition)
-        if (lastDir == true) {
-          vTaskDelay(100);  // Stepper was running in opposite
-                            // direction. Give it time to stop.
-        }
-        digitalWrite(DIR_PIN, LOW);
-        digitalWrite(STEP_PIN, HIGH);
-        delayMicroseconds(acceleration);
-        digitalWrite(STEP_PIN, LOW);
-        //delayMicroseconds(acceleration);
-        stepperPosition--;
-        lastDir = false;
-      }
+    vTaskDelayUntil(&lastWake, STEPPER_PLAN_INTERVAL / portTICK_PERIOD_MS);
+    stepperPosition = stepGenerator.getPosition();
+
+    uint32_t notification;
+    if (xTaskNotifyWait(0, 0, &notification, 0) == pdTRUE) {
+      motion.correct(static_cast<int32_t>(notification));
     }
+
+    motion.update(shifterPosition + (userConfig.getIncline() * userConfig.getInclineMultiplier()), millis(), connectedClientCount() > 0);
   }
 }
 
@@ -190,7 +210,7 @@ void IRAM_ATTR shiftUp() {  // Handle the shift up interrupt IRAM_ATTR is to kee
   if (deBounce()) {
     if (!digitalRead(SHIFT_UP_PIN)) {  // double checking to make sure the interrupt wasn't triggered by emf
       shifterPosition = (shifterPosition + userConfig.getShiftStep());
-      debugDirector("Shift UP: " + String(shifterPosition));
+      SS2K_LOG(STEPPER, INFO, "Shift UP: %d", shifterPosition);
     } else {
       lastDebounceTime = 0;
     }  // Probably Triggered by EMF, reset the debounce
@@ -201,7 +221,7 @@ void IRAM_ATTR shiftDown() {  // Handle the shift down interrupt
   if (deBounce()) {
     if (!digitalRead(SHIFT_DOWN_PIN)) {  // double checking to make sure the interrupt wasn't triggered by emf
       shifterPosition = (shifterPosition - userConfig.getShiftStep());
-      debugDirector("Shift DOWN: " + String(shifterPosition));
+      SS2K_LOG(STEPPER, INFO, "Shift DOWN: %d", shifterPosition);
     } else {
       lastDebounceTime = 0;
     }  // Probably Triggered by EMF, reset the debounce
@@ -228,9 +248,9 @@ void resetIfShiftersHeld() {
 
 void scanIfShiftersHeld() {
   if ((digitalRead(SHIFT_UP_PIN) == LOW) && (digitalRead(SHIFT_DOWN_PIN) == LOW)) {  // are both shifters held?
-    debugDirector("Shifters Held " + String(shiftersHoldForScan));
+    SS2K_LOG(STEPPER, INFO, "Shifters Held %d", shiftersHoldForScan);
     if (shiftersHoldForScan < 1) {  // have they been held for enough loops?
-      debugDirector("Shifters Held < 1 " + String(shiftersHoldForScan));
+      SS2K_LOG(STEPPER, INFO, "Shifters Held < 1 %d", shiftersHoldForScan);
       if ((millis() - scanDelayStart) >= scanDelayTime) {  // Has this already been done within 10 seconds?
         scanDelayStart += scanDelayTime;
         spinBLEClient.resetDevices();
@@ -239,7 +259,7 @@ void scanIfShiftersHeld() {
         digitalWrite(LED_PIN, LOW);
         debugDirector("Scan From Buttons");
       } else {
-        debugDirector("Shifters Held but timer not up " + String((millis() - scanDelayStart) >= scanDelayTime));
+        SS2K_LOG(STEPPER, INFO, "Shifters Held but timer not up %d", (millis() - scanDelayStart) >= scanDelayTime);
         shiftersHoldForScan = SHIFTERS_HOLD_FOR_SCAN;
         return;
       }
@@ -250,14 +270,9 @@ void scanIfShiftersHeld() {
 }
 
 // String Text to print, Optional Make newline, Optional Send to Telegram
+// Text that is already built. Queued for logDrainWorker() like logMessage().
 void debugDirector(String textToPrint, bool newline, bool telegram) {
-  if (newline) {
-    Serial.println(textToPrint);
-    debugToHTML += String("<br>") + textToPrint;
-  } else {
-    Serial.print(textToPrint);
-    debugToHTML += textToPrint;
-  }
+  logRing.logText(millis(), LogRing::Info, newline ? 0 : LogRing::NoNewline, textToPrint.c_str());
 #ifdef USE_TELEGRAM
   if (false) {
     sendTelegram(textToPrint);
@@ -265,6 +280,55 @@ void debugDirector(String textToPrint, bool newline, bool telegram) {
 #endif
 }
 
+// Prints the queued log messages, so neither formatting nor Serial holds up the task or interrupt that logged them.
+void logDrainWorker(void *pvParameters) {
+  LogRing::Record record;
+  char text[256];
+  uint32_t reportedDrops = 0;
+  bool lineStart         = true;
+  for (;;) {
+    while (logRing.read(record)) {
+      LogRing::format(record, text, sizeof(text));
+      if (lineStart) {
+        Serial.printf("[%lu] ", static_cast<unsigned long>(record.time));
+      }
+      lineStart = !(record.flags & LogRing::NoNewline);
+      if (lineStart) {
+        Serial.println(text);
+        debugToHTML += String("<br>") + text;
+      } else {
+        Serial.print(text);
+        debugToHTML += text;
+      }
+    }
+    if (logRing.getDropped() != reportedDrops) {
+      reportedDrops = logRing.getDropped();
+      Serial.printf("Log full, %u messages dropped\n", reportedDrops);
+    }
+    if (debugToHTML.length() > DEBUG_HTML_SIZE) {  // Clear up memory
+      debugToHTML = "<br>HTML Debug Truncated. Increase buffer if required.";
+    }
+    vTaskDelay(LOG_DRAIN_INTERVAL / portTICK_PERIOD_MS);
+  }
+}
+
+void setLogLevel(uint8_t category, int level) {
+  if (category < LOG_CATEGORIES) {
+    logLevels[category] = constrain(level, LOG_LEVEL_NONE, logLevelLimits[category]);
+  }
+}
+
+String returnLogLevelsJSON() {
+  DynamicJsonDocument doc(LOGLEVELS_JSON_SIZE);
+  for (int i = 0; i < LOG_CATEGORIES; i++) {
+    doc[logCategoryNames[i]]["level"]    = logLevels[i];
+    doc[logCategoryNames[i]]["maxLevel"] = logLevelLimits[i];
+  }
+  String output;
+  serializeJson(doc, output);
+  return output;
+}
+
 void setupTMCStepperDriver() {
   driver.begin();
   driver.pdn_disable(true);
@@ -280,8 +344,17 @@ void setupTMCStepperDriver() {
   driver.iholddelay(10);  // Controls the number of clock cycles for motor
                           // power down after standstill is detected
   driver.TPOWERDOWN(128);
+  fullRunCurrent       = driver.irun();
+  fullHoldCurrent      = driver.ihold();
   msread               = driver.microsteps();
   uint16_t currentread = driver.cs_actual();
+  // microsteps() is 0 in full step mode and when MRES can't be read. MSCNT can't be trusted then.
+  if (msread == 0) {
+    SS2K_LOG(STEPPER, ERROR, "Stepper microsteps unknown, drift correction disabled");
+  } else {
+    stepReconciler.setCountsPerStep(256 / msread);
+    reconcileSteps = true;
+  }
 
   debugDirector(" read:current=" + currentread);
   debugDirector(" read:ms=" + msread);
@@ -293,15 +366,93 @@ void setupTMCStepperDriver() {
   driver.pwm_autograd(t_bool);
 }
 
-void updateStepperPower() {
-  debugDirector("Stepper power is now " + String(userConfig.getStepperPower()));
-  driver.rms_current(userConfig.getStepperPower());
+void updateStepperPower() { xTaskNotify(stepperMonitorTask, StepperPowerChanged, eSetBits); }
+
+void updateStealthchop() { xTaskNotify(stepperMonitorTask, StealthchopChanged, eSetBits); }
+
+void applyStepperCurrent() {
+  driver.irun(fullRunCurrent * stepperMonitor.getRunCurrent() / 100);
+  driver.ihold(fullHoldCurrent * stepperMonitor.getHoldCurrent() / 100);
 }
 
-void updateStealthchop() {
-  bool t_bool = userConfig.getStealthchop();
-  driver.en_spreadCycle(!t_bool);
-  driver.pwm_autoscale(t_bool);
-  driver.pwm_autograd(t_bool);
-  debugDirector("Stealthchop is now " + String(t_bool));
+// Polls DRV_STATUS every STEPPER_TELEMETRY_INTERVAL and applies settings changes as they come.
+void stepperMonitorWorker(void *pvParameters) {
+  int32_t lastPosition = stepGenerator.getPosition();
+  for (;;) {
+    uint32_t changes = 0;
+    if (xTaskNotifyWait(0, ULONG_MAX, &changes, STEPPER_TELEMETRY_INTERVAL / portTICK_PERIOD_MS) == pdTRUE) {
+      if (changes & StepperPowerChanged) {
+        SS2K_LOG(STEPPER, INFO, "Stepper power is now %d", userConfig.getStepperPower());
+        driver.rms_current(userConfig.getStepperPower());
+        fullRunCurrent  = driver.irun();
+        fullHoldCurrent = driver.ihold();
+        applyStepperCurrent();
+      }
+      if (changes & StealthchopChanged) {
+        bool t_bool = userConfig.getStealthchop();
+        driver.en_spreadCycle(!t_bool);
+        driver.pwm_autoscale(t_bool);
+        driver.pwm_autograd(t_bool);
+        SS2K_LOG(STEPPER, INFO, "Stealthchop is now %d", t_bool);
+      }
+      continue;
+    }
+
+    const int32_t position = stepGenerator.getPosition();
+    const bool moving      = position != lastPosition || stepGenerator.isBusy();
+    lastPosition           = position;
+    const uint32_t status  = driver.DRV_STATUS();
+    if (driver.CRCerror) {
+      stepperMonitor.pollFailed();
+      continue;
+    }
+    if (stepperMonitor.update(status, moving, millis())) {
+      applyStepperCurrent();
+      SS2K_LOG(STEPPER, INFO, "Stepper current %d%% hold %d%%", stepperMonitor.getRunCurrent(), stepperMonitor.getHoldCurrent());
+    }
+
+    // Reconcile the position with the driver's microstep counter while nothing moves.
+    if (!moving && reconcileSteps) {
+      const uint16_t mscnt = driver.MSCNT();
+      if (driver.CRCerror) {
+        stepperMonitor.pollFailed();
+        continue;
+      }
+      // A move started since position was read would show up in MSCNT as drift, so the reading is checked against it.
+      const int32_t drift = stepReconciler.update(mscnt, position, stepGenerator.getPosition(), stepGenerator.isBusy());
+      if (drift != 0) {
+        SS2K_LOG(STEPPER, WARNING, "Stepper drifted %d steps, correcting", drift);
+        xTaskNotify(moveStepperTask, static_cast<uint32_t>(drift), eSetValueWithOverwrite);
+      }
+    }
+  }
+}
+
+String returnStepperStatsJSON() {
+  DynamicJsonDocument doc(STEPPERSTATS_JSON_SIZE);
+  const StepperMonitor::Metrics &metrics = stepperMonitor.getMetrics();
+  const StepperMonitor::Status status    = StepperMonitor::decode(metrics.lastStatus);
+  const StepReconciler::Metrics &drift   = stepReconciler.getMetrics();
+  doc["drvStatus"]          = metrics.lastStatus;
+  doc["temperatureC"]       = status.temperature;
+  doc["currentScale"]       = status.currentScale;
+  doc["standstill"]         = status.standstill;
+  doc["runCurrentPercent"]  = metrics.runCurrent;
+  doc["holdCurrentPercent"] = metrics.holdCurrent;
+  doc["polls"]              = metrics.polls;
+  doc["failedPolls"]        = metrics.failedPolls;
+  doc["warnings"]           = metrics.warnings;
+  doc["overtemperatures"]   = metrics.overtemperatures;
+  doc["shorts"]             = metrics.shorts;
+  doc["openLoads"]          = metrics.openLoads;
+  doc["thermalCuts"]        = metrics.thermalCuts;
+  doc["driftCorrection"]    = reconcileSteps;
+  doc["driftChecks"]        = drift.checks;
+  doc["driftChecksSkipped"] = drift.skipped;
+  doc["driftCorrections"]   = drift.corrections;
+  doc["lastDriftSteps"]     = drift.lastDrift;
+  doc["totalDriftSteps"]    = drift.totalDrift;
+  String output;
+  serializeJson(doc, output);
+  return output;
 }
@@ -185,11 +185,7 @@ void userParameters::printFile() {
     return;
   }
 
-  // Extract each characters by one by one
-  while (file.available()) {
-    debugDirector(String(static_cast<char>(file.read())), false);
-  }
-  debugDirector(String(" "));
+  debugDirector(file.readString());
   // Close the file
   file.close();
 }
@@ -292,11 +288,7 @@ void physicalWorkingCapacity::printFile() {
     return;
   }
 
-  // Extract each characters by one by one
-  while (file.available()) {
-    debugDirector(String(static_cast<char>(file.read())), false);
-  }
-  debugDirector(String(" "));
+  debugDirector(file.readString());
   // Close the file
   file.close();
 }
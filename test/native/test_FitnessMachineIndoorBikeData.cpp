@@ -32,11 +32,43 @@ void test_parses_power(void) {
   TEST_ASSERT_EQUAL(64, sensor.getPower());
 }
 
+void test_parses_speed(void) {
+  FitnessMachineIndoorBikeData sensor = FitnessMachineIndoorBikeData();
+  sensor.decode(data, 9);
+  TEST_ASSERT_TRUE(sensor.hasSpeed());
+  TEST_ASSERT_FLOAT_WITHIN(0.001, 22.9, sensor.getSpeed());
+}
+
+void test_ignores_fields_past_end_of_packet(void) {
+  FitnessMachineIndoorBikeData sensor = FitnessMachineIndoorBikeData();
+  sensor.decode(data, 5);
+  TEST_ASSERT_TRUE(sensor.hasSpeed());
+  TEST_ASSERT_FALSE(sensor.hasCadence());
+  TEST_ASSERT_FALSE(sensor.hasPower());
+  TEST_ASSERT_EQUAL(INT_MIN, sensor.getPower());
+}
+
+void test_extracts_signed_field_after_variable_fields(void) {
+  // Speed, cadence, total distance, resistance level (-5) and power present.
+  uint8_t packet[13] = {0x74, 0x00, 0xf2, 0x08, 0xb0, 0x00, 0x10, 0x27, 0x00, 0xfb, 0xff, 0x40, 0x00};
+  int32_t value      = 0;
+  TEST_ASSERT_TRUE(FitnessMachineIndoorBikeData::extract<FitnessMachineIndoorBikeData::Types::ResistanceLevel>(packet, 13, &value));
+  TEST_ASSERT_EQUAL(-5, value);
+  TEST_ASSERT_TRUE(FitnessMachineIndoorBikeData::extract<FitnessMachineIndoorBikeData::Types::TotalDistance>(packet, 13, &value));
+  TEST_ASSERT_EQUAL(10000, value);
+  TEST_ASSERT_TRUE(FitnessMachineIndoorBikeData::extract<FitnessMachineIndoorBikeData::Types::InstantaneousPower>(packet, 13, &value));
+  TEST_ASSERT_EQUAL(64, value);
+  TEST_ASSERT_FALSE(FitnessMachineIndoorBikeData::extract<FitnessMachineIndoorBikeData::Types::HeartRate>(packet, 13, &value));
+}
+
 void process() {
   UNITY_BEGIN();
   RUN_TEST(test_parses_heartrate);
   RUN_TEST(test_parses_cadence);
   RUN_TEST(test_parses_power);
+  RUN_TEST(test_parses_speed);
+  RUN_TEST(test_ignores_fields_past_end_of_packet);
+  RUN_TEST(test_extracts_signed_field_after_variable_fields);
   UNITY_END();
 }
 
@@ -0,0 +1,248 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+// Decode-path benchmark. Run with: pio test -e native -f native_benchmark
+// Reports ns/packet, allocations/packet and bytes allocated for every decoder
+// and fails if the hot path starts allocating.
+
+#include "sdkconfig.h"
+#include <unity.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <vector>
+#include <Constants.h>
+#include <sensors/CyclePowerData.h>
+#include <sensors/EchelonData.h>
+#include <sensors/FitnessMachineIndoorBikeData.h>
+#include <sensors/FlywheelData.h>
+#include <sensors/HeartRateData.h>
+#include <sensors/SensorDataFactory.h>
+
+static const int CORPUS_SIZE = 1000;
+static const int ITERATIONS  = 200;
+
+static size_t allocationCount = 0;
+static size_t allocationBytes = 0;
+
+void *operator new(size_t size) {
+  allocationCount++;
+  allocationBytes += size;
+  void *p = malloc(size == 0 ? 1 : size);
+  if (p == nullptr) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void operator delete(void *p) noexcept { free(p); }
+
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+struct Packet {
+  uint8_t sensorId;
+  uint8_t length;
+  uint8_t data[20];
+};
+
+// Keeps the optimizer from discarding decoded values.
+static volatile int sink = 0;
+
+static void consume(SensorData &sensorData) {
+  int result = 0;
+  if (sensorData.hasPower()) {
+    result += sensorData.getPower();
+  }
+  if (sensorData.hasCadence()) {
+    result += static_cast<int>(sensorData.getCadence());
+  }
+  if (sensorData.hasHeartRate()) {
+    result += sensorData.getHeartRate();
+  }
+  if (sensorData.hasSpeed()) {
+    result += static_cast<int>(sensorData.getSpeed());
+  }
+  sink = sink + result;
+}
+
+// ~90 rpm with pedal balance and crank data, four notifications per second like an Assioma.
+static std::vector<Packet> cyclePowerCorpus() {
+  std::vector<Packet> corpus;
+  uint16_t crankRev  = 65000;  // Rolls over during the corpus
+  uint16_t eventTime = 0;
+  for (int i = 0; i < CORPUS_SIZE; i++) {
+    if (i % 2 == 0) {
+      crankRev++;
+      eventTime += 683;  // 1024 * 60 / 90
+    }
+    uint16_t power = 150 + (i % 40);
+    Packet p       = {SensorDataFactory::Types::CyclePower, 9, {0x21, 0x00, static_cast<uint8_t>(power), static_cast<uint8_t>(power >> 8), 0x64, static_cast<uint8_t>(crankRev),
+                                                          static_cast<uint8_t>(crankRev >> 8), static_cast<uint8_t>(eventTime), static_cast<uint8_t>(eventTime >> 8)}};
+    corpus.push_back(p);
+  }
+  return corpus;
+}
+
+// Speed, cadence, power and heart rate, as sent by most FTMS bikes.
+static std::vector<Packet> indoorBikeCorpus() {
+  std::vector<Packet> corpus;
+  for (int i = 0; i < CORPUS_SIZE; i++) {
+    uint16_t speed   = 2500 + (i % 300);
+    uint16_t cadence = 170 + (i % 20);
+    uint16_t power   = 180 + (i % 50);
+    Packet p         = {SensorDataFactory::Types::FitnessMachineIndoorBike,
+                9,
+                {0x44, 0x02, static_cast<uint8_t>(speed), static_cast<uint8_t>(speed >> 8), static_cast<uint8_t>(cadence), static_cast<uint8_t>(cadence >> 8),
+                 static_cast<uint8_t>(power), static_cast<uint8_t>(power >> 8), static_cast<uint8_t>(120 + (i % 30))}};
+    corpus.push_back(p);
+  }
+  return corpus;
+}
+
+static std::vector<Packet> flywheelCorpus() {
+  std::vector<Packet> corpus;
+  for (int i = 0; i < CORPUS_SIZE; i++) {
+    uint16_t power = 200 + (i % 60);
+    Packet p       = {SensorDataFactory::Types::Flywheel, 16, {0xFF, 0x1F, 0x0C, static_cast<uint8_t>(power >> 8), static_cast<uint8_t>(power), 0, 0, 0, 0, 0, 0, 0, static_cast<uint8_t>(80 + (i % 20)), 0, 0, 0}};
+    corpus.push_back(p);
+  }
+  return corpus;
+}
+
+// Alternating cadence (0xD1) and resistance (0xD2) notifications.
+static std::vector<Packet> echelonCorpus() {
+  std::vector<Packet> corpus;
+  for (int i = 0; i < CORPUS_SIZE; i++) {
+    if (i % 2 == 0) {
+      uint16_t cadence = 70 + (i % 40);
+      Packet p         = {SensorDataFactory::Types::Echelon, 13, {0xF0, 0xD1, 0x09, 0, 0, 0, 0, 0, 0, static_cast<uint8_t>(cadence >> 8), static_cast<uint8_t>(cadence), 0, 0}};
+      corpus.push_back(p);
+    } else {
+      Packet p = {SensorDataFactory::Types::Echelon, 5, {0xF0, 0xD2, 0x01, static_cast<uint8_t>(10 + (i % 20)), 0}};
+      corpus.push_back(p);
+    }
+  }
+  return corpus;
+}
+
+static std::vector<Packet> heartRateCorpus() {
+  std::vector<Packet> corpus;
+  for (int i = 0; i < CORPUS_SIZE; i++) {
+    Packet p = {SensorDataFactory::Types::HeartRate, 2, {0x00, static_cast<uint8_t>(110 + (i % 60))}};
+    corpus.push_back(p);
+  }
+  return corpus;
+}
+
+// What a ride with a power meter and a heart rate strap looks like to the factory.
+static std::vector<Packet> mixedCorpus() {
+  std::vector<Packet> powerPackets = cyclePowerCorpus();
+  std::vector<Packet> hrPackets    = heartRateCorpus();
+  std::vector<Packet> corpus;
+  for (int i = 0; i < CORPUS_SIZE; i++) {
+    corpus.push_back(i % 4 == 3 ? hrPackets[i] : powerPackets[i]);
+  }
+  return corpus;
+}
+
+struct Result {
+  double nsPerPacket;
+  double allocationsPerPacket;
+  size_t bytesAllocated;
+};
+
+template <typename Decode>
+static Result measure(const char *name, std::vector<Packet> &corpus, Decode decode) {
+  for (auto &p : corpus) {  // Warm up, and let anything lazily created get created.
+    decode(p);
+  }
+  size_t startCount = allocationCount;
+  size_t startBytes = allocationBytes;
+  auto start        = std::chrono::steady_clock::now();
+  for (int i = 0; i < ITERATIONS; i++) {
+    for (auto &p : corpus) {
+      decode(p);
+    }
+  }
+  auto end       = std::chrono::steady_clock::now();
+  double packets = static_cast<double>(corpus.size()) * ITERATIONS;
+  Result result  = {std::chrono::duration<double, std::nano>(end - start).count() / packets, (allocationCount - startCount) / packets, allocationBytes - startBytes};
+
+  char message[150];
+  snprintf(message, sizeof(message), "%-34s %8.1f ns/packet %6.2f allocs/packet %8zu bytes", name, result.nsPerPacket, result.allocationsPerPacket, result.bytesAllocated);
+  TEST_MESSAGE(message);
+  return result;
+}
+
+template <typename T>
+static void benchmarkDecoder(const char *name, std::vector<Packet> corpus) {
+  T sensor;
+  Result result = measure(name, corpus, [&sensor](Packet &p) {
+    sensor.decode(p.data, p.length);
+    consume(sensor);
+  });
+  TEST_ASSERT_EQUAL(0, result.bytesAllocated);
+}
+
+void test_benchmark_cycle_power(void) { benchmarkDecoder<CyclePowerData>("CyclePowerData", cyclePowerCorpus()); }
+
+void test_benchmark_indoor_bike(void) { benchmarkDecoder<FitnessMachineIndoorBikeData>("FitnessMachineIndoorBikeData", indoorBikeCorpus()); }
+
+void test_benchmark_flywheel(void) { benchmarkDecoder<FlywheelData>("FlywheelData", flywheelCorpus()); }
+
+void test_benchmark_echelon(void) { benchmarkDecoder<EchelonData>("EchelonData", echelonCorpus()); }
+
+void test_benchmark_heart_rate(void) { benchmarkDecoder<HeartRateData>("HeartRateData", heartRateCorpus()); }
+
+void test_benchmark_factory_by_id(void) {
+  SensorDataFactory factory;
+  std::vector<Packet> corpus = mixedCorpus();
+  Result result              = measure("SensorDataFactory (sensor id)", corpus, [&factory](Packet &p) { consume(factory.getSensorData(p.sensorId, p.data, p.length)); });
+  TEST_ASSERT_EQUAL(0, result.bytesAllocated);
+}
+
+void test_benchmark_factory_by_uuid(void) {
+  SensorDataFactory factory;
+  std::vector<Packet> corpus = mixedCorpus();
+  const NimBLEUUID powerUUID = CYCLINGPOWERMEASUREMENT_UUID;
+  const NimBLEUUID hrUUID    = HEARTCHARACTERISTIC_UUID;
+  measure("SensorDataFactory (UUID)", corpus, [&](Packet &p) {
+    consume(factory.getSensorData(p.sensorId == SensorDataFactory::Types::HeartRate ? hrUUID : powerUUID, p.data, p.length));
+  });
+}
+
+void process() {
+  UNITY_BEGIN();
+  RUN_TEST(test_benchmark_cycle_power);
+  RUN_TEST(test_benchmark_indoor_bike);
+  RUN_TEST(test_benchmark_flywheel);
+  RUN_TEST(test_benchmark_echelon);
+  RUN_TEST(test_benchmark_heart_rate);
+  RUN_TEST(test_benchmark_factory_by_id);
+  RUN_TEST(test_benchmark_factory_by_uuid);
+  UNITY_END();
+}
+
+#ifdef ARDUINO
+
+#include <Arduino.h>
+void setup() {
+  delay(2000);
+  process();
+}
+
+void loop() {}
+
+#else
+
+int main(int argc, char **argv) {
+  process();
+  return 0;
+}
+
+#endif
@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include <unity.h>
+#include <ConnectionManager.h>
+
+void test_parameters_by_role(void) {
+  ConnectionParameters power = ConnectionManager::getParameters(ConnectionManager::PowerUplink, 0, 20);
+  TEST_ASSERT_EQUAL(12, power.minInterval);
+  TEST_ASSERT_EQUAL(24, power.maxInterval);
+  TEST_ASSERT_TRUE(power.prefer2M);
+  TEST_ASSERT_EQUAL(0, power.dataLength);  // 20 bytes fit the default payload
+
+  ConnectionParameters heartRate = ConnectionManager::getParameters(ConnectionManager::SensorUplink, 0, 40);
+  TEST_ASSERT_EQUAL(80, heartRate.maxInterval);
+  TEST_ASSERT_FALSE(heartRate.prefer2M);
+  TEST_ASSERT_EQUAL(47, heartRate.dataLength);
+  TEST_ASSERT_TRUE(heartRate.supervisionTimeout * 10 > heartRate.maxInterval * 1.25 * 2);
+
+  // Fast notifications shorten the interval, down to the 7.5 ms the spec allows.
+  ConnectionParameters app = ConnectionManager::getParameters(ConnectionManager::AppDownlink, 40, 20);
+  TEST_ASSERT_EQUAL(10, app.minInterval);
+  TEST_ASSERT_EQUAL(10, app.maxInterval);
+  app = ConnectionManager::getParameters(ConnectionManager::AppDownlink, 1000, 300);
+  TEST_ASSERT_EQUAL(6, app.maxInterval);
+  TEST_ASSERT_EQUAL(251, app.dataLength);
+}
+
+void test_links_wait_to_settle(void) {
+  ConnectionManager manager;
+  ConnectionManager::Link link;
+  TEST_ASSERT_TRUE(manager.addLink(1, ConnectionManager::AppDownlink, 0xFFFFFFFF - 1000));  // Across the micros() rollover
+  TEST_ASSERT_TRUE(manager.addLink(2, ConnectionManager::AppDownlink, 50000));
+  TEST_ASSERT_FALSE(manager.takePending(ConnectionManager::SettleTime - 1002, &link));
+
+  TEST_ASSERT_TRUE(manager.takePending(ConnectionManager::SettleTime - 1001, &link));
+  TEST_ASSERT_EQUAL(1, link.connHandle);
+  TEST_ASSERT_FALSE(manager.takePending(ConnectionManager::SettleTime - 1001, &link));
+
+  // A link that drops before it settles is never negotiated.
+  manager.removeLink(2);
+  TEST_ASSERT_FALSE(manager.takePending(1000000, &link));
+
+  manager.removeLink(1);
+  for (uint16_t handle = 10; handle < 10 + ConnectionManager::MaxLinks; handle++) {
+    TEST_ASSERT_TRUE(manager.addLink(handle, ConnectionManager::AppDownlink, 0));
+  }
+  TEST_ASSERT_FALSE(manager.addLink(100, ConnectionManager::AppDownlink, 0));
+}
+
+void process() {
+  UNITY_BEGIN();
+  RUN_TEST(test_parameters_by_role);
+  RUN_TEST(test_links_wait_to_settle);
+  UNITY_END();
+}
+
+#ifdef ARDUINO
+
+#include <Arduino.h>
+void setup() {
+  delay(2000);
+  process();
+}
+
+void loop() {}
+
+#else
+
+int main(int argc, char **argv) {
+  process();
+  return 0;
+}
+
+#endif
@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include <unity.h>
+#include <string.h>
+#include <FTMSControlPoint.h>
+
+static FTMSControlPoint::Command command(const uint8_t *data, uint8_t length) {
+  FTMSControlPoint::Command command;
+  command.connHandle = 1;
+  command.length     = length;
+  memcpy(command.data, data, length);
+  return command;
+}
+
+void test_validates_commands(void) {
+  const uint8_t requestControl[] = {0x00};
+  const uint8_t targetPower[]    = {0x05, 0xC8, 0x00};
+  const uint8_t shortPower[]     = {0x05, 0xC8};
+  const uint8_t simulation[]     = {0x11, 0x00, 0x00, 0xF4, 0x01, 0x28, 0x33};
+  const uint8_t targetSpeed[]    = {0x02, 0x10, 0x27};
+  TEST_ASSERT_EQUAL(FTMSControlPoint::Success, FTMSControlPoint::validate(command(requestControl, sizeof(requestControl))));
+  TEST_ASSERT_EQUAL(FTMSControlPoint::Success, FTMSControlPoint::validate(command(targetPower, sizeof(targetPower))));
+  TEST_ASSERT_EQUAL(FTMSControlPoint::InvalidParameter, FTMSControlPoint::validate(command(shortPower, sizeof(shortPower))));
+  TEST_ASSERT_EQUAL(FTMSControlPoint::Success, FTMSControlPoint::validate(command(simulation, sizeof(simulation))));
+  TEST_ASSERT_EQUAL(FTMSControlPoint::OpCodeNotSupported, FTMSControlPoint::validate(command(targetSpeed, sizeof(targetSpeed))));
+
+  uint8_t response[FTMSControlPoint::ResponseSize];
+  const uint8_t expected[] = {0x80, 0x05, 0x01};
+  TEST_ASSERT_EQUAL(sizeof(expected), FTMSControlPoint::encodeResponse(response, 0x05, FTMSControlPoint::Success));
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, response, sizeof(expected));
+}
+
+void test_collapses_simulation_bursts(void) {
+  const uint8_t simulation[] = {0x11, 0x00, 0x00, 0xF4, 0x01, 0x28, 0x33};
+  const uint8_t truncated[]  = {0x11, 0x00, 0x00};
+  const uint8_t power[]      = {0x05, 0xC8, 0x00};
+  FTMSControlPoint::Command batch[] = {command(simulation, sizeof(simulation)), command(simulation, sizeof(simulation)), command(power, sizeof(power)),
+                                       command(simulation, sizeof(simulation)), command(simulation, sizeof(simulation)), command(truncated, sizeof(truncated))};
+  const size_t count = sizeof(batch) / sizeof(batch[0]);
+  TEST_ASSERT_TRUE(FTMSControlPoint::isSuperseded(batch, count, 0));
+  TEST_ASSERT_FALSE(FTMSControlPoint::isSuperseded(batch, count, 1));  // Applied before the target power
+  TEST_ASSERT_FALSE(FTMSControlPoint::isSuperseded(batch, count, 2));
+  TEST_ASSERT_TRUE(FTMSControlPoint::isSuperseded(batch, count, 3));
+  TEST_ASSERT_FALSE(FTMSControlPoint::isSuperseded(batch, count, 4));  // A malformed write doesn't override it
+  TEST_ASSERT_FALSE(FTMSControlPoint::isSuperseded(batch, count, 5));
+}
+
+void process() {
+  UNITY_BEGIN();
+  RUN_TEST(test_validates_commands);
+  RUN_TEST(test_collapses_simulation_bursts);
+  UNITY_END();
+}
+
+#ifdef ARDUINO
+
+#include <Arduino.h>
+void setup() {
+  delay(2000);
+  process();
+}
+
+void loop() {}
+
+#else
+
+int main(int argc, char **argv) {
+  process();
+  return 0;
+}
+
+#endif
@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include <unity.h>
+#include <CrankSynthesizer.h>
+
+// Apps take cadence from consecutive events, so it must come out the same at any update rate.
+void test_cadence_independent_of_update_rate(void) {
+  const uint32_t periods[] = {1000000, 250000, 33000, 777};
+  for (uint32_t period : periods) {
+    CrankSynthesizer crank;
+    crank.update(90, 0);
+    for (uint32_t now = period; now < 20500000; now += period) {
+      crank.update(90, now);
+    }
+    crank.update(90, 20500000);
+    // 30 revolutions in 20.5 s, the 30th completed at 20 s.
+    TEST_ASSERT_EQUAL(30, crank.getRevolutions());
+    TEST_ASSERT_TRUE(crank.getEventTime() >= 20480 - 2 && crank.getEventTime() <= 20480 + 2);
+  }
+}
+
+void test_event_time_is_when_revolution_completed(void) {
+  CrankSynthesizer crank;
+  crank.update(60, 0);
+  crank.update(60, 2500000);  // Two revolutions, the last one 0.5 s ago
+  TEST_ASSERT_EQUAL(2, crank.getRevolutions());
+  TEST_ASSERT_EQUAL(2048, crank.getEventTime());
+
+  crank.update(0, 10000000);  // Stopped, no events
+  TEST_ASSERT_EQUAL(2, crank.getRevolutions());
+  TEST_ASSERT_EQUAL(2048, crank.getEventTime());
+  crank.update(120, 10400000);  // Picks up the half revolution left before the stop
+  TEST_ASSERT_EQUAL(3, crank.getRevolutions());
+  TEST_ASSERT_EQUAL(10 * 1024 + 256, crank.getEventTime());
+
+  // Rolls over with the 16 bit counters.
+  for (uint32_t now = 10400000; now <= 10400000 + 70000000; now += 100000) {
+    crank.update(120, now);
+  }
+  TEST_ASSERT_EQUAL(143, crank.getRevolutions());
+  TEST_ASSERT_EQUAL(static_cast<uint16_t>(80 * 1024 + 256), crank.getEventTime());
+}
+
+void test_passes_through_upstream_events(void) {
+  CrankSynthesizer crank;
+  crank.update(60, 0);
+  crank.update(60, 1000000);
+  TEST_ASSERT_EQUAL(1, crank.getRevolutions());
+
+  crank.passthrough(65530, 65000, 1100000);  // Baseline only
+  TEST_ASSERT_TRUE(crank.isPassthrough(1100000));
+  TEST_ASSERT_EQUAL(1, crank.getRevolutions());
+  crank.passthrough(2, 400, 2000000);  // 8 revolutions in 936 ticks, across the rollover
+  crank.update(60, 2000000);           // Ignored while passing through
+  TEST_ASSERT_EQUAL(9, crank.getRevolutions());
+  TEST_ASSERT_EQUAL(1024 + 936, crank.getEventTime());
+
+  // The power meter goes quiet, synthesis picks up from its last event: revolutions at 3, 4, 5 and 6 s.
+  TEST_ASSERT_FALSE(crank.isPassthrough(2000000 + CrankSynthesizer::PassthroughTimeout));
+  crank.update(60, 2000000 + CrankSynthesizer::PassthroughTimeout);
+  crank.update(60, 2000000 + CrankSynthesizer::PassthroughTimeout + 1000000);
+  TEST_ASSERT_EQUAL(13, crank.getRevolutions());
+  TEST_ASSERT_EQUAL(1024 + 936 + 4 * 1024, crank.getEventTime());
+}
+
+void process() {
+  UNITY_BEGIN();
+  RUN_TEST(test_cadence_independent_of_update_rate);
+  RUN_TEST(test_event_time_is_when_revolution_completed);
+  RUN_TEST(test_passes_through_upstream_events);
+  UNITY_END();
+}
+
+#ifdef ARDUINO
+
+#include <Arduino.h>
+void setup() {
+  delay(2000);
+  process();
+}
+
+void loop() {}
+
+#else
+
+int main(int argc, char **argv) {
+  process();
+  return 0;
+}
+
+#endif
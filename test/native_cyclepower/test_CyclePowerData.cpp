@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "sdkconfig.h"
+#include <unity.h>
+#include <sensors/CyclePowerData.h>
+
+// Power, pedal balance and crank revolution data, as sent by an Assioma.
+static void notify(CyclePowerData &sensor, uint16_t crankRev, uint16_t eventTime) {
+  uint8_t data[] = {0x21, 0x00, 0xC8, 0x00, 0x64, static_cast<uint8_t>(crankRev), static_cast<uint8_t>(crankRev >> 8), static_cast<uint8_t>(eventTime),
+                    static_cast<uint8_t>(eventTime >> 8)};
+  sensor.decode(data, sizeof(data));
+}
+
+void test_needs_two_crank_events(void) {
+  CyclePowerData sensor;
+  notify(sensor, 100, 5000);
+  TEST_ASSERT_FALSE(sensor.hasCadence());
+  notify(sensor, 101, 5000 + 683);
+  TEST_ASSERT_TRUE(sensor.hasCadence());
+  TEST_ASSERT_FLOAT_WITHIN(0.5, 90, sensor.getCadence());
+  TEST_ASSERT_EQUAL(200, sensor.getPower());
+
+  uint16_t crankRev, eventTime;
+  TEST_ASSERT_TRUE(sensor.getCrankEvent(&crankRev, &eventTime));
+  TEST_ASSERT_EQUAL(101, crankRev);
+  TEST_ASSERT_EQUAL(5000 + 683, eventTime);
+  uint8_t powerOnly[] = {0x00, 0x00, 0xC8, 0x00};
+  sensor.decode(powerOnly, sizeof(powerOnly));
+  TEST_ASSERT_FALSE(sensor.getCrankEvent(&crankRev, &eventTime));
+}
+
+void test_counters_roll_over(void) {
+  CyclePowerData sensor;
+  uint16_t crankRev  = 65533;
+  uint16_t eventTime = 64000;
+  for (int i = 0; i < 8; i++) {  // Both counters wrap in here
+    notify(sensor, crankRev++, eventTime);
+    eventTime += 683;
+    if (i > 0) {
+      TEST_ASSERT_FLOAT_WITHIN(0.5, 90, sensor.getCadence());
+    }
+  }
+}
+
+void test_follows_cadence_change_within_a_revolution(void) {
+  CyclePowerData sensor;
+  uint16_t crankRev  = 0;
+  uint16_t eventTime = 0;
+  for (int i = 0; i < 6; i++) {
+    notify(sensor, crankRev++, eventTime);
+    eventTime += 1024;  // 60 rpm
+  }
+  TEST_ASSERT_FLOAT_WITHIN(0.5, 60, sensor.getCadence());
+  notify(sensor, crankRev++, eventTime - 1024 + 512);  // One revolution at 120 rpm
+  TEST_ASSERT_GREATER_THAN(60, sensor.getCadence());
+}
+
+void test_repeated_events_hold_then_stop(void) {
+  CyclePowerData sensor;
+  notify(sensor, 10, 1000);
+  notify(sensor, 11, 1000 + 1536);  // 40 rpm, 1.5 s per revolution
+  TEST_ASSERT_FLOAT_WITHIN(0.5, 40, sensor.getCadence());
+  for (int i = 0; i < 6; i++) {  // 1.5 s at 4 Hz without a new revolution is still pedalling
+    notify(sensor, 11, 1000 + 1536);
+    TEST_ASSERT_FLOAT_WITHIN(0.5, 40, sensor.getCadence());
+  }
+  for (int i = 0; i < 3; i++) {
+    notify(sensor, 11, 1000 + 1536);
+  }
+  TEST_ASSERT_EQUAL(0, sensor.getCadence());
+
+  // Pedalling again measures from the first new stroke, not from before the stop.
+  notify(sensor, 12, 30000);
+  TEST_ASSERT_EQUAL(0, sensor.getCadence());
+  notify(sensor, 13, 30000 + 683);
+  TEST_ASSERT_FLOAT_WITHIN(0.5, 90, sensor.getCadence());
+}
+
+void process() {
+  UNITY_BEGIN();
+  RUN_TEST(test_needs_two_crank_events);
+  RUN_TEST(test_counters_roll_over);
+  RUN_TEST(test_follows_cadence_change_within_a_revolution);
+  RUN_TEST(test_repeated_events_hold_then_stop);
+  UNITY_END();
+}
+
+#ifdef ARDUINO
+
+#include <Arduino.h>
+void setup() {
+  delay(2000);
+  process();
+}
+
+void loop() {}
+
+#else
+
+int main(int argc, char **argv) {
+  process();
+  return 0;
+}
+
+#endif
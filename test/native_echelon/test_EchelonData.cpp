@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "sdkconfig.h"
+#include <unity.h>
+#include <cmath>
+#include <cstdlib>
+#include <sensors/EchelonData.h>
+
+static void notifyCadence(EchelonData &sensor, uint16_t cadence) {
+  uint8_t data[] = {0xF0, 0xD1, 0x09, 0, 0, 0, 0, 0, 0, static_cast<uint8_t>(cadence >> 8), static_cast<uint8_t>(cadence), 0, 0};
+  sensor.decode(data, sizeof(data));
+}
+
+static void notifyResistance(EchelonData &sensor, uint8_t resistance) {
+  uint8_t data[] = {0xF0, 0xD2, 0x01, resistance, 0};
+  sensor.decode(data, sizeof(data));
+}
+
+// The double precision model the table replaces.
+static int referencePower(int resistance, int cadence) { return pow(1.090112, resistance) * pow(1.015343, cadence) * 7.228958; }
+
+void test_needs_cadence_and_resistance(void) {
+  EchelonData sensor;
+  notifyCadence(sensor, 80);
+  TEST_ASSERT_TRUE(sensor.hasCadence());
+  TEST_ASSERT_FALSE(sensor.hasPower());
+  notifyResistance(sensor, 10);
+  TEST_ASSERT_TRUE(sensor.hasPower());
+  TEST_ASSERT_EQUAL(80, sensor.getCadence());
+  TEST_ASSERT_EQUAL(referencePower(10, 80), sensor.getPower());
+}
+
+void test_no_power_when_stopped(void) {
+  EchelonData sensor;
+  notifyResistance(sensor, 10);
+  notifyCadence(sensor, 0);
+  TEST_ASSERT_EQUAL(0, sensor.getPower());
+}
+
+void test_matches_reference_model(void) {
+  EchelonData sensor;
+  int worst = 0;
+  for (int resistance = 1; resistance <= 40; resistance++) {  // Past the table too
+    notifyResistance(sensor, resistance);
+    for (int cadence = 1; cadence <= 300; cadence++) {
+      notifyCadence(sensor, cadence);
+      int error = abs(sensor.getPower() - referencePower(resistance, cadence));
+      if (error > worst) {
+        worst = error;
+      }
+    }
+  }
+  TEST_ASSERT_LESS_OR_EQUAL(1, worst);  // Truncation of float vs double
+}
+
+void process() {
+  UNITY_BEGIN();
+  RUN_TEST(test_needs_cadence_and_resistance);
+  RUN_TEST(test_no_power_when_stopped);
+  RUN_TEST(test_matches_reference_model);
+  UNITY_END();
+}
+
+#ifdef ARDUINO
+
+#include <Arduino.h>
+void setup() {
+  delay(2000);
+  process();
+}
+
+void loop() {}
+
+#else
+
+int main(int argc, char **argv) {
+  process();
+  return 0;
+}
+
+#endif
@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include <unity.h>
+#include <ERG.h>
+
+static const ERGController::Gains gains   = {0.5f, 1.0f, 0, 1.0f};
+static const ERGController::Limits limits = {-2000, 4000, 1000, 50};
+static const uint32_t Period              = 100000;  // 10 Hz
+
+// A trainer that makes 100 W flat plus 2 W per incline unit at 90 rpm, reported by a power meter
+// that lags by about a second.
+struct Trainer {
+  float incline = 0;
+  float watts   = 100;
+
+  void step(float cadence) {
+    const float steady = cadence > 0 ? (100 + 2 * this->incline) * cadence / 90 : 0;
+    this->watts += (steady - this->watts) * 0.1f;
+  }
+};
+
+void test_settles_on_target_step(void) {
+  ERGController erg(gains, limits);
+  Trainer trainer;
+  uint32_t now = 0;
+  for (; now < 5000000; now += Period) {
+    trainer.step(90);
+    trainer.incline = erg.update(trainer.watts, 90, now);
+  }
+  erg.setTarget(250, trainer.incline, now);
+  for (; now < 40000000; now += Period) {
+    trainer.step(90);
+    trainer.incline = erg.update(trainer.watts, 90, now);
+  }
+  const ERGController::Metrics &metrics = erg.getMetrics();
+  TEST_ASSERT_TRUE(metrics.settled);
+  TEST_ASSERT_TRUE(metrics.settlingTime < 8000000);
+  TEST_ASSERT_TRUE(metrics.overshoot < 25);
+  TEST_ASSERT_TRUE(trainer.watts > 245 && trainer.watts < 255);
+  TEST_ASSERT_EQUAL(1, metrics.steps);
+}
+
+void test_releases_below_minimum_cadence(void) {
+  ERGController erg(gains, limits);
+  Trainer trainer;
+  erg.setTarget(200, 0, 0);
+  uint32_t now = 0;
+  for (; now < 20000000; now += Period) {
+    trainer.step(90);
+    trainer.incline = erg.update(trainer.watts, 90, now);
+  }
+  TEST_ASSERT_TRUE(trainer.incline > 40);
+  trainer.incline = erg.update(0, 30, now);
+  TEST_ASSERT_TRUE(trainer.incline == 0);
+  TEST_ASSERT_EQUAL(1, erg.getMetrics().gatedUpdates);
+}
+
+// A target the trainer can't reach must not wind up the integral, so it comes straight back when lowered.
+void test_no_windup_at_limit(void) {
+  const ERGController::Limits low = {-2000, 500, 1000, 50};  // 1100 W at most
+  ERGController erg(gains, low);
+  Trainer trainer;
+  erg.setTarget(1500, 0, 0);
+  uint32_t now = 0;
+  for (; now < 60000000; now += Period) {
+    trainer.step(90);
+    trainer.incline = erg.update(trainer.watts, 90, now);
+  }
+  TEST_ASSERT_TRUE(trainer.incline == low.maxIncline);
+  TEST_ASSERT_TRUE(erg.getMetrics().saturatedUpdates > 0);
+
+  erg.setTarget(300, trainer.incline, now);
+  const uint32_t lowered = now;
+  for (; now < lowered + 20000000; now += Period) {
+    trainer.step(90);
+    trainer.incline = erg.update(trainer.watts, 90, now);
+  }
+  TEST_ASSERT_TRUE(erg.getMetrics().settled);
+  TEST_ASSERT_TRUE(erg.getMetrics().settlingTime < 10000000);
+}
+
+void process() {
+  UNITY_BEGIN();
+  RUN_TEST(test_settles_on_target_step);
+  RUN_TEST(test_releases_below_minimum_cadence);
+  RUN_TEST(test_no_windup_at_limit);
+  UNITY_END();
+}
+
+#ifdef ARDUINO
+
+#include <Arduino.h>
+void setup() {
+  delay(2000);
+  process();
+}
+
+void loop() {}
+
+#else
+
+int main(int argc, char **argv) {
+  process();
+  return 0;
+}
+
+#endif
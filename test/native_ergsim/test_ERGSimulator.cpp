@@ -0,0 +1,265 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+// ERG against a simulated trainer, in virtual time. Run with: pio test -e native -f native_ergsim
+// Reports rise time, overshoot, steady-state error, settling time and stepper travel for each scripted
+// workout, with an empty and with a learned power map, and fails if ERG stops settling.
+
+#include <unity.h>
+#include <math.h>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <ERG.h>
+#include <PowerTable.h>
+#include <StepperMotion.h>
+#include <VirtualStepperDriver.h>
+#include "settings.h"
+
+static const uint32_t Tick             = 1000;  // us of virtual time per simulation step
+static const float InclineMultiplier   = 3;     // userConfig default, steps per incline unit
+static const float Pi                  = 3.14159265f;
+
+// A spin bike with an eddy current brake moved by the stepper, ridden by someone holding a cadence,
+// measured by a power meter that averages, reports at a fixed rate and arrives late.
+struct Trainer {
+  // Brake: torque = damping(position) * w + friction, damping following the magnets' S-shaped curve
+  // from fully out to FullEngagement steps.
+  static constexpr float Friction        = 2.1f;   // N m
+  static constexpr float MinDamping      = 0.9f;   // N m s/rad, about 100 W at 90 rpm
+  static constexpr float DampingRange    = 12.4f;  // About 1200 W at 90 rpm fully engaged
+  static constexpr float FullEngagement  = 30000;  // steps
+  static constexpr float Inertia         = 1.5f;   // kg m^2, flywheel as seen at the crank
+  // Rider: pushes what the brake takes plus a correction towards their cadence, through a lag.
+  static constexpr float RiderGain       = 20;     // N m per rad/s of cadence error
+  static constexpr float RiderLag        = 0.3f;   // s
+  static constexpr float MaxRiderTorque  = 120;    // N m
+  // Power meter.
+  static constexpr uint32_t ReportPeriod = 500000;  // 2 Hz
+  static constexpr uint32_t Latency      = 300000;
+  static constexpr float Noise           = 0.02f;  // Of the reading, either way
+
+  float riderCadence    = 90;  // rpm the rider aims for
+  float omega           = 90 * 2 * Pi / 60;
+  float riderTorque     = 0;
+  float targetPosition  = 0;   // steps
+  float energy          = 0;   // J since the last report
+  float revolutions     = 0;
+  uint32_t lastReport   = 0;
+  struct Report {
+    uint32_t at;
+    float watts;
+    float cadence;
+  };
+  std::vector<Report> inFlight;
+  float reportedWatts   = NAN;
+  float reportedCadence = NAN;
+  uint32_t reports      = 0;
+  uint32_t seed         = 1;
+
+  // The stepper, planned and stepped as moveStepper() does it.
+  StepGenerator generator;
+  VirtualStepperDriver driver{generator};
+  StepperMotion motion{generator, driver, {STEPPER_MAX_VELOCITY, STEPPER_MAX_ACCELERATION, STEPPER_MAX_JERK}, STEPPER_PLAN_INTERVAL, STEPPER_LOOKAHEAD,
+                       STEPPER_DISABLE_DELAY};
+
+  int32_t getPosition() const { return this->generator.getPosition(); }
+
+  uint32_t getTravel() const { return this->driver.getSteps().size(); }
+
+  float getDamping() const {
+    const float x = fminf(fmaxf(this->getPosition() / FullEngagement, 0), 1);
+    return MinDamping + DampingRange * x * x * (3 - 2 * x);
+  }
+
+  void step(uint32_t now) {
+    const float dt = Tick / 1000000.0f;
+    if (now % (STEPPER_PLAN_INTERVAL * 1000) == 0) {
+      this->motion.update(lroundf(this->targetPosition), now / 1000, true);
+    }
+    this->driver.advance(now + Tick);
+
+    const float brakeTorque = this->getDamping() * this->omega + Friction;
+    const float wanted      = brakeTorque + RiderGain * (this->riderCadence * 2 * Pi / 60 - this->omega);
+    this->riderTorque += (fminf(fmaxf(wanted, 0), MaxRiderTorque) - this->riderTorque) * dt / RiderLag;
+    this->omega = fmaxf(this->omega + (this->riderTorque - brakeTorque) / Inertia * dt, 0);
+    this->energy += this->riderTorque * this->omega * dt;
+    this->revolutions += this->omega / (2 * Pi) * dt;
+
+    if (now - this->lastReport >= ReportPeriod) {
+      const float period = (now - this->lastReport) / 1000000.0f;
+      this->seed         = this->seed * 1103515245 + 12345;
+      const float noise  = 1 + Noise * (static_cast<float>((this->seed >> 8) % 2001) / 1000 - 1);
+      this->inFlight.push_back({now + Latency, this->energy / period * noise, this->revolutions * 60 / period});
+      this->energy      = 0;
+      this->revolutions = 0;
+      this->lastReport  = now;
+    }
+    while (!this->inFlight.empty() && this->inFlight.front().at <= now) {
+      this->reportedWatts   = this->inFlight.front().watts;
+      this->reportedCadence = this->inFlight.front().cadence;
+      this->reports++;
+      this->inFlight.erase(this->inFlight.begin());
+    }
+  }
+};
+
+struct Segment {
+  uint32_t seconds;
+  int32_t watts;
+  float cadence;
+};
+
+struct Result {
+  float riseTime;      // s, worst step, from the target change until power first gets 90 % of the way there
+  float overshoot;     // W, worst step
+  float steadyError;   // W, worst mean absolute error over the last 5 s of a segment
+  float settlingTime;  // s, worst step, as ERGController measures it. INFINITY if a step never settled.
+  float travel;        // steps
+};
+
+// Runs a workout the way the firmware does: the power meter feeds the ERG task, which runs at ERG_UPDATE_RATE
+// and moves the stepper, while the power map learns from readings taken with the stepper at rest.
+static Result ride(const std::vector<Segment> &workout, PowerTable &table) {
+  const ERGController::Gains gains   = {ERG_PROPORTIONAL_GAIN, ERG_INTEGRAL_GAIN, ERG_DERIVATIVE_GAIN, ERG_FEED_FORWARD_GAIN};
+  const ERGController::Limits limits = {ERG_MIN_INCLINE, ERG_MAX_INCLINE, ERG_MAX_INCLINE_RATE, ERG_MIN_CADENCE};
+  const uint32_t ergPeriod           = 1000000 / ERG_UPDATE_RATE;
+  ERGController erg(gains, limits);
+  Trainer trainer;
+  Result result = {0, 0, 0, 0, 0};
+
+  uint32_t now           = 0;
+  uint32_t nextERG       = 0;
+  float incline          = 0;
+  uint32_t handled       = 0;
+  int restingPosition    = 0;
+  uint32_t restingSince  = 0;
+  int32_t previousTarget = 0;
+  for (const Segment &segment : workout) {
+    trainer.riderCadence = segment.cadence;
+    int32_t position;
+    float predicted = NAN;
+    if (table.getPosition(segment.watts, trainer.reportedCadence, &position)) {
+      predicted = position / InclineMultiplier;
+    }
+    erg.setTarget(segment.watts, incline, now, predicted);
+
+    const uint32_t start   = now;
+    const uint32_t end     = now + segment.seconds * 1000000;
+    const float stepSize   = segment.watts - previousTarget;
+    bool risen             = false;
+    float errorSum         = 0;
+    uint32_t errorCount    = 0;
+    for (; now < end; now += Tick) {
+      trainer.step(now);
+      if (isnan(trainer.reportedWatts)) {
+        continue;
+      }
+      if (now >= nextERG) {
+        nextERG += ergPeriod;
+        incline                = erg.update(trainer.reportedWatts, trainer.reportedCadence, now);
+        trainer.targetPosition = incline * InclineMultiplier;
+      }
+      if (trainer.reports == handled) {
+        continue;
+      }
+      // Once per power report, like BLESensorProcessing().
+      handled = trainer.reports;
+      if (abs(trainer.getPosition() - restingPosition) > POWER_TABLE_REST_BAND) {
+        restingPosition = trainer.getPosition();
+        restingSince    = now;
+      } else if (now - restingSince >= POWER_TABLE_SETTLE_TIME * 1000) {
+        table.addSample(restingPosition, trainer.reportedCadence, trainer.reportedWatts);
+      }
+      if (!risen && previousTarget > 0 && stepSize != 0 && (trainer.reportedWatts - previousTarget) / stepSize >= 0.9f) {
+        risen           = true;
+        result.riseTime = fmaxf(result.riseTime, (now - start) / 1000000.0f);
+      }
+      if (previousTarget > 0 && stepSize != 0) {
+        result.overshoot = fmaxf(result.overshoot, (trainer.reportedWatts - segment.watts) * (stepSize > 0 ? 1 : -1));
+      }
+      if (end - now <= 5000000) {
+        errorSum += fabsf(trainer.reportedWatts - segment.watts);
+        errorCount++;
+      }
+    }
+    if (previousTarget > 0 && stepSize != 0 && !risen) {
+      result.riseTime = INFINITY;
+    }
+    const ERGController::Metrics &metrics = erg.getMetrics();
+    result.settlingTime                   = fmaxf(result.settlingTime, metrics.settled ? metrics.settlingTime / 1000000.0f : INFINITY);
+    result.steadyError                    = fmaxf(result.steadyError, errorCount > 0 ? errorSum / errorCount : INFINITY);
+    previousTarget                        = segment.watts;
+  }
+  result.travel = trainer.getTravel();
+  return result;
+}
+
+static Result report(const char *name, const std::vector<Segment> &workout, PowerTable &table) {
+  const char *map = table.getSamples() > 0 ? "learned" : "cold";
+  Result result   = ride(workout, table);
+  printf("%-16s %-7s rise %5.1f s  overshoot %5.1f W  steady error %4.1f W  settling %5.1f s  travel %6.0f steps\n", name, map, result.riseTime, result.overshoot, result.steadyError, result.settlingTime, result.travel);
+  return result;
+}
+
+static std::vector<Segment> steps() { return {{30, 150, 90}, {40, 250, 90}, {40, 180, 90}, {40, 300, 90}, {40, 150, 90}}; }
+
+static std::vector<Segment> cadenceChanges() { return {{30, 200, 90}, {40, 200, 70}, {40, 200, 105}, {40, 200, 85}}; }
+
+static std::vector<Segment> intervals() {
+  std::vector<Segment> workout = {{30, 150, 90}};
+  for (int i = 0; i < 4; i++) {
+    workout.push_back({30, 320, 95});
+    workout.push_back({30, 140, 85});
+  }
+  return workout;
+}
+
+static void benchmark(const char *name, const std::vector<Segment> &workout, float maxSettling) {
+  PowerTable table(POWER_TABLE_MIN_POSITION, POWER_TABLE_POSITION_SPACING, POWER_TABLE_MIN_CADENCE, POWER_TABLE_CADENCE_SPACING);
+  const Result cold = report(name, workout, table);
+  // The second ride starts where the first ended, with what the map learned.
+  const Result learned = report(name, workout, table);
+  for (const Result &result : {cold, learned}) {
+    TEST_ASSERT_TRUE(result.settlingTime <= maxSettling);
+    TEST_ASSERT_TRUE(result.overshoot < 25);
+    TEST_ASSERT_TRUE(result.steadyError < 8);  // The power meter alone is good for about 3
+  }
+}
+
+void test_steps(void) { benchmark("steps", steps(), 8); }
+
+void test_cadence_changes(void) { benchmark("cadence changes", cadenceChanges(), 10); }
+
+void test_intervals(void) { benchmark("intervals", intervals(), 8); }
+
+void process() {
+  UNITY_BEGIN();
+  RUN_TEST(test_steps);
+  RUN_TEST(test_cadence_changes);
+  RUN_TEST(test_intervals);
+  UNITY_END();
+}
+
+#ifdef ARDUINO
+
+#include <Arduino.h>
+void setup() {
+  delay(2000);
+  process();
+}
+
+void loop() {}
+
+#else
+
+int main(int argc, char **argv) {
+  process();
+  return 0;
+}
+
+#endif
@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "sdkconfig.h"
+#include <unity.h>
+#include <sensors/SensorFusion.h>
+
+static const uint32_t TIMEOUT = 3000000;
+static const uint8_t PM       = 0;  // Client slots
+static const uint8_t BIKE     = 1;
+
+void test_power_meter_beats_trainer(void) {
+  SensorFusion fusion(TIMEOUT);
+  float value    = 0;
+  uint8_t source = 0xFF;
+  fusion.update(PM, SensorDataFactory::Types::CyclePower, SensorFusion::Power, 210, 1000);
+  fusion.update(BIKE, SensorDataFactory::Types::FitnessMachineIndoorBike, SensorFusion::Power, 250, 2000);  // Newer, but less trusted
+  TEST_ASSERT_TRUE(fusion.get(SensorFusion::Power, 3000, &value, &source));
+  TEST_ASSERT_EQUAL(210, value);
+  TEST_ASSERT_EQUAL(PM, source);
+
+  // The trainer is still the best source of speed.
+  fusion.update(BIKE, SensorDataFactory::Types::FitnessMachineIndoorBike, SensorFusion::Speed, 31.5, 2000);
+  TEST_ASSERT_TRUE(fusion.get(SensorFusion::Speed, 3000, &value, &source));
+  TEST_ASSERT_EQUAL(BIKE, source);
+}
+
+void test_freshest_source_wins_a_tie(void) {
+  SensorFusion fusion(TIMEOUT);
+  float value = 0;
+  fusion.update(0, SensorDataFactory::Types::HeartRate, SensorFusion::HeartRate, 120, 1000);
+  fusion.update(1, SensorDataFactory::Types::HeartRate, SensorFusion::HeartRate, 125, 2000);
+  TEST_ASSERT_TRUE(fusion.get(SensorFusion::HeartRate, 3000, &value));
+  TEST_ASSERT_EQUAL(125, value);
+  fusion.update(0, SensorDataFactory::Types::HeartRate, SensorFusion::HeartRate, 121, 2500);
+  TEST_ASSERT_TRUE(fusion.get(SensorFusion::HeartRate, 3000, &value));
+  TEST_ASSERT_EQUAL(121, value);
+}
+
+void test_silent_source_expires(void) {
+  SensorFusion fusion(TIMEOUT);
+  float value = 0;
+  fusion.update(PM, SensorDataFactory::Types::CyclePower, SensorFusion::Cadence, 90, 1000);
+  fusion.update(BIKE, SensorDataFactory::Types::Echelon, SensorFusion::Cadence, 88, 1000);
+  fusion.update(BIKE, SensorDataFactory::Types::Echelon, SensorFusion::Cadence, 87, 1000 + TIMEOUT);
+  TEST_ASSERT_TRUE(fusion.get(SensorFusion::Cadence, 1001 + TIMEOUT, &value));
+  TEST_ASSERT_EQUAL(87, value);  // The power meter went silent, fall back to the bike
+  TEST_ASSERT_FALSE(fusion.get(SensorFusion::Cadence, 1001 + 2 * TIMEOUT, &value));
+  TEST_ASSERT_FALSE(fusion.get(SensorFusion::Power, 1000, &value));
+}
+
+void test_survives_micros_rollover(void) {
+  SensorFusion fusion(TIMEOUT);
+  float value = 0;
+  fusion.update(PM, SensorDataFactory::Types::CyclePower, SensorFusion::Power, 200, 0xFFFFFF00);
+  TEST_ASSERT_TRUE(fusion.get(SensorFusion::Power, 0x100, &value));
+  TEST_ASSERT_EQUAL(200, value);
+  TEST_ASSERT_FALSE(fusion.get(SensorFusion::Power, TIMEOUT, &value));
+  // Expired for good, even once its age wraps around.
+  TEST_ASSERT_FALSE(fusion.get(SensorFusion::Power, 0xFFFFFF01, &value));
+}
+
+void process() {
+  UNITY_BEGIN();
+  RUN_TEST(test_power_meter_beats_trainer);
+  RUN_TEST(test_freshest_source_wins_a_tie);
+  RUN_TEST(test_silent_source_expires);
+  RUN_TEST(test_survives_micros_rollover);
+  UNITY_END();
+}
+
+#ifdef ARDUINO
+
+#include <Arduino.h>
+void setup() {
+  delay(2000);
+  process();
+}
+
+void loop() {}
+
+#else
+
+int main(int argc, char **argv) {
+  process();
+  return 0;
+}
+
+#endif
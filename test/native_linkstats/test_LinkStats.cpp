@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "sdkconfig.h"
+#include <unity.h>
+#include <LinkStats.h>
+
+void test_four_hz_sensor(void) {
+  LinkStats stats;
+  uint32_t timestamp = 0xFFFFFFFF - 600000;  // Rolls over
+  for (int i = 0; i < 41; i++) {
+    stats.recordPacket(timestamp, 9);
+    stats.recordDecode(20, true);
+    timestamp += (i % 2 == 0) ? 240000 : 260000;
+  }
+  TEST_ASSERT_EQUAL(41, stats.getPackets());
+  TEST_ASSERT_EQUAL(41 * 9, stats.getBytes());
+  TEST_ASSERT_EQUAL(0, stats.getDecodeFailures());
+  TEST_ASSERT_FLOAT_WITHIN(0.01, 4, stats.getRate());
+  TEST_ASSERT_FLOAT_WITHIN(100, 10000, stats.getJitter());
+  TEST_ASSERT_EQUAL(260000, stats.getMaxGap());
+  TEST_ASSERT_EQUAL(20, stats.getHistogramCount(1));  // <= 250 ms
+  TEST_ASSERT_EQUAL(20, stats.getHistogramCount(2));  // <= 500 ms
+  TEST_ASSERT_EQUAL(100, stats.getLastPacketAge(timestamp - 240000 + 100));
+}
+
+void test_gaps_and_failures(void) {
+  LinkStats stats;
+  TEST_ASSERT_EQUAL(UINT32_MAX, stats.getLastPacketAge(0));
+  stats.recordPacket(0, 2);
+  stats.recordPacket(1000000, 2);
+  stats.recordPacket(9000000, 2);  // Dropped out for 8 s
+  stats.recordDecode(10, true);
+  stats.recordDecode(30, false);
+  TEST_ASSERT_EQUAL(8000000, stats.getMaxGap());
+  TEST_ASSERT_EQUAL(1, stats.getHistogramCount(3));
+  TEST_ASSERT_EQUAL(1, stats.getHistogramCount(LinkStats::HistogramBins - 1));
+  TEST_ASSERT_EQUAL(1, stats.getDecodeFailures());
+  TEST_ASSERT_FLOAT_WITHIN(0.01, 20, stats.getMeanDecodeTime());
+  TEST_ASSERT_EQUAL(30, stats.getMaxDecodeTime());
+  stats.reset();
+  TEST_ASSERT_EQUAL(0, stats.getPackets());
+  TEST_ASSERT_EQUAL(0, stats.getHistogramCount(3));
+}
+
+void process() {
+  UNITY_BEGIN();
+  RUN_TEST(test_four_hz_sensor);
+  RUN_TEST(test_gaps_and_failures);
+  UNITY_END();
+}
+
+#ifdef ARDUINO
+
+#include <Arduino.h>
+void setup() {
+  delay(2000);
+  process();
+}
+
+void loop() {}
+
+#else
+
+int main(int argc, char **argv) {
+  process();
+  return 0;
+}
+
+#endif
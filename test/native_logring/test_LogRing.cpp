@@ -0,0 +1,164 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include <unity.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <vector>
+#include <LogRing.h>
+
+static std::string next(LogRing &ring) {
+  LogRing::Record record;
+  if (!ring.read(record)) {
+    return "<empty>";
+  }
+  char text[160];
+  LogRing::format(record, text, sizeof(text));
+  return text;
+}
+
+void test_formats_arguments_later(void) {
+  LogRing ring;
+  char name[] = "Wahoo KICKR";
+  TEST_ASSERT_TRUE(ring.log(1234, LogRing::Info, 0, "Shift UP: %d", -600));
+  TEST_ASSERT_TRUE(ring.log(1235, LogRing::Debug, 0, "%s at %5.1f W, %lu ms, %02x%%", name, 251.25f, 90000UL, 0xA));
+  strcpy(name, "gone");  // Copied when logged
+  // The argument's type wins over a conversion that doesn't match it, and missing ones are printed as written.
+  TEST_ASSERT_TRUE(ring.log(1236, LogRing::Warning, 0, "%d %s %d", 2.5, 7));
+
+  LogRing::Record record;
+  TEST_ASSERT_TRUE(ring.read(record));
+  TEST_ASSERT_EQUAL(1234, record.time);
+  TEST_ASSERT_EQUAL(LogRing::Info, record.level);
+  char text[64];
+  LogRing::format(record, text, sizeof(text));
+  TEST_ASSERT_EQUAL_STRING("Shift UP: -600", text);
+  TEST_ASSERT_EQUAL_STRING("Wahoo KICKR at 251.2 W, 90000 ms, 0a%", next(ring).c_str());
+  TEST_ASSERT_EQUAL_STRING("2.5 7 %d", next(ring).c_str());
+  TEST_ASSERT_EQUAL_STRING("<empty>", next(ring).c_str());
+
+  // Bytes as hex.
+  const uint8_t packet[] = {0x20, 0x00, 0xfa, 0x00};
+  ring.log(1237, LogRing::Verbose, 0, "%s<- %s", LogRing::Hex(packet, sizeof(packet)), "2a63");
+  TEST_ASSERT_EQUAL_STRING("20 00 fa 00 <- 2a63", next(ring).c_str());
+
+  // Cut short to the buffer.
+  ring.log(1237, LogRing::Info, 0, "Power %d", 123456);
+  TEST_ASSERT_TRUE(ring.read(record));
+  TEST_ASSERT_EQUAL(8, LogRing::format(record, text, 9));
+  TEST_ASSERT_EQUAL_STRING("Power 12", text);
+}
+
+void test_drops_when_full_and_splits_long_text(void) {
+  LogRing ring;
+  for (size_t i = 0; i < LogRing::Capacity; i++) {
+    TEST_ASSERT_TRUE(ring.log(i, LogRing::Info, 0, "%u", static_cast<unsigned int>(i)));
+  }
+  TEST_ASSERT_FALSE(ring.log(0, LogRing::Info, 0, "lost"));
+  TEST_ASSERT_EQUAL(1, ring.getDropped());
+  TEST_ASSERT_EQUAL_STRING("0", next(ring).c_str());
+  TEST_ASSERT_TRUE(ring.log(0, LogRing::Info, 0, "kept"));
+  for (size_t i = 1; i < LogRing::Capacity; i++) {
+    next(ring);
+  }
+  TEST_ASSERT_EQUAL_STRING("kept", next(ring).c_str());
+
+  // Text that doesn't fit a record continues in the next, and only the last one ends the line.
+  const std::string text(250, 'x');
+  TEST_ASSERT_TRUE(ring.logText(5, LogRing::Info, 0, text.c_str()));
+  std::string joined;
+  LogRing::Record record;
+  int records = 0;
+  while (ring.read(record)) {
+    char part[LogRing::PayloadSize];
+    LogRing::format(record, part, sizeof(part));
+    joined += part;
+    records++;
+    TEST_ASSERT_EQUAL(records < 3 ? LogRing::NoNewline : 0, record.flags);
+  }
+  TEST_ASSERT_EQUAL(3, records);
+  TEST_ASSERT_EQUAL_STRING(text.c_str(), joined.c_str());
+
+  // An argument that doesn't fit is marked, and those after it are left out.
+  ring.log(6, LogRing::Info, 0, "%s %d", text.c_str(), 1);
+  TEST_ASSERT_TRUE(ring.read(record));
+  TEST_ASSERT_TRUE(record.flags & LogRing::Truncated);
+  char cut[200];
+  LogRing::format(record, cut, sizeof(cut));
+  TEST_ASSERT_EQUAL(LogRing::PayloadSize - 2 + 3 + 3, strlen(cut));  // Text less type and terminator, " %d", "..."
+}
+
+// Writers on several threads and one reader. Every record arrives whole, and each writer's in order.
+void test_concurrent_writers(void) {
+  static const int Writers = 4;
+  static const int Count   = 20000;
+  LogRing ring;
+  std::vector<std::thread> writers;
+  for (int w = 0; w < Writers; w++) {
+    writers.push_back(std::thread([&ring, w]() {
+      for (int i = 0; i < Count; i++) {
+        while (!ring.log(i, LogRing::Debug, 0, "%d %d %s", w, i, "payload")) {
+          std::this_thread::yield();
+        }
+      }
+    }));
+  }
+  int expected[Writers] = {};
+  int received          = 0;
+  bool ordered          = true;
+  LogRing::Record record;
+  while (received < Writers * Count) {
+    if (!ring.read(record)) {
+      std::this_thread::yield();
+      continue;
+    }
+    char text[64];
+    LogRing::format(record, text, sizeof(text));
+    int w = -1;
+    int i = -1;
+    char payload[16];
+    if (sscanf(text, "%d %d %15s", &w, &i, payload) != 3 || w < 0 || w >= Writers || i != expected[w] || strcmp(payload, "payload") != 0) {
+      ordered = false;  // Keep reading so the writers can finish
+    } else {
+      expected[w]++;
+    }
+    received++;
+  }
+  for (size_t w = 0; w < writers.size(); w++) {
+    writers[w].join();
+  }
+  TEST_ASSERT_TRUE(ordered);
+  TEST_ASSERT_EQUAL(Writers * Count, received);
+}
+
+void process() {
+  UNITY_BEGIN();
+  RUN_TEST(test_formats_arguments_later);
+  RUN_TEST(test_drops_when_full_and_splits_long_text);
+  RUN_TEST(test_concurrent_writers);
+  UNITY_END();
+}
+
+#ifdef ARDUINO
+
+#include <Arduino.h>
+void setup() {
+  delay(2000);
+  process();
+}
+
+void loop() {}
+
+#else
+
+int main(int argc, char **argv) {
+  process();
+  return 0;
+}
+
+#endif
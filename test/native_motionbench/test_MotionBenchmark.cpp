@@ -0,0 +1,229 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+// Stepper motion in virtual time. Run with: pio test -e native -f native_motionbench
+// Plays target position streams through StepperMotion on a virtual driver and reports time-to-target, peak
+// step rate, reversals and steps for each motion strategy. A recorded stream can be added with
+//   SS2K_MOTION=motion.csv pio test -e native -f native_motionbench
+// where each line of motion.csv is "ms,target position".
+
+#include <unity.h>
+#include <math.h>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <StepperMotion.h>
+#include <VirtualStepperDriver.h>
+#include "settings.h"
+
+static const float InclineMultiplier = 3;  // userConfig default, steps per incline unit
+static const int32_t ShiftStep       = 600;
+
+struct Command {
+  uint32_t time;  // ms
+  int32_t target;
+};
+
+struct Strategy {
+  const char *name;
+  MotionPlanner::Limits limits;
+};
+
+// The bit-banged stepper this replaced was roughly a constant 800 steps/s.
+static const Strategy Strategies[] = {
+    {"constant 800/s", {800, 1e9f, 0}},
+    {"trapezoid", {STEPPER_MAX_VELOCITY, STEPPER_MAX_ACCELERATION, 0}},
+    {"stiff", {STEPPER_MAX_VELOCITY, STEPPER_MAX_ACCELERATION * 2, STEPPER_MAX_JERK * 10}},
+    {"settings.h", {STEPPER_MAX_VELOCITY, STEPPER_MAX_ACCELERATION, STEPPER_MAX_JERK}},
+};
+
+struct Result {
+  uint32_t commands;
+  uint32_t reached;  // Before the next command
+  float meanTime;    // To target, of the ones reached, ms
+  float maxTime;
+  float peakRate;  // steps/s
+  uint32_t reversals;
+  uint32_t steps;
+  bool finished;  // At the last target at the end
+};
+
+static Result play(const std::vector<Command> &commands, const MotionPlanner::Limits &limits) {
+  StepGenerator generator;
+  VirtualStepperDriver driver(generator);
+  StepperMotion motion(generator, driver, limits, STEPPER_PLAN_INTERVAL, STEPPER_LOOKAHEAD, STEPPER_DISABLE_DELAY);
+  Result result      = {};
+  float totalTime    = 0;
+  size_t next        = 0;
+  int32_t target     = 0;
+  uint32_t issuedAt  = 0;
+  bool waiting       = false;
+  const uint32_t end = commands.back().time + 10000;
+  for (uint32_t now = 0; now < end; now += STEPPER_PLAN_INTERVAL) {
+    while (next < commands.size() && commands[next].time <= now) {
+      if (commands[next].target != target) {
+        target   = commands[next].target;
+        issuedAt = commands[next].time;
+        waiting  = true;
+        result.commands++;
+      }
+      next++;
+    }
+    motion.update(target, now, true);
+    driver.advance((now + STEPPER_PLAN_INTERVAL) * 1000);
+    if (waiting && motion.isSettled() && generator.getPosition() == target) {
+      // Arrived with the last step.
+      const float time = driver.getSteps().back().time / 1000.0f - issuedAt;
+      totalTime += time;
+      result.maxTime = fmaxf(result.maxTime, time);
+      result.reached++;
+      waiting = false;
+    }
+  }
+  result.meanTime  = result.reached > 0 ? totalTime / result.reached : 0;
+  result.peakRate  = driver.getPeakStepRate();
+  result.reversals = driver.getReversals();
+  result.steps     = driver.getSteps().size();
+  result.finished  = generator.getPosition() == target;
+  return result;
+}
+
+static void report(const char *stream, const char *strategy, const Result &result) {
+  printf("%-10s %-15s %4u/%-4u reached  time to target mean %6.0f ms max %6.0f ms  peak %6.0f steps/s  %4u reversals  %7u steps\n", stream, strategy,
+         result.reached, result.commands, result.meanTime, result.maxTime, result.peakRate, result.reversals, result.steps);
+}
+
+// Direction changes the stream itself asks for. Anything more is overshoot.
+static uint32_t commandedReversals(const std::vector<Command> &commands) {
+  uint32_t reversals = 0;
+  int32_t position   = 0;
+  int direction      = 0;
+  for (size_t i = 0; i < commands.size(); i++) {
+    if (commands[i].target == position) {
+      continue;
+    }
+    const int next = commands[i].target > position ? 1 : -1;
+    if (direction != 0 && next != direction) {
+      reversals++;
+    }
+    direction = next;
+    position  = commands[i].target;
+  }
+  return reversals;
+}
+
+// Compares the strategies on a stream, and checks the one in settings.h against the old constant speed.
+// Mean times aren't compared, as a strategy that reaches fewer targets only averages the easy ones.
+static void compare(const char *stream, const std::vector<Command> &commands) {
+  Result results[sizeof(Strategies) / sizeof(Strategies[0])];
+  for (size_t i = 0; i < sizeof(Strategies) / sizeof(Strategies[0]); i++) {
+    results[i] = play(commands, Strategies[i].limits);
+    report(stream, Strategies[i].name, results[i]);
+  }
+  const Result &constant = results[0];
+  const Result &current  = results[sizeof(Strategies) / sizeof(Strategies[0]) - 1];
+  TEST_ASSERT_TRUE(current.finished);
+  TEST_ASSERT_TRUE(current.reached >= constant.reached);
+  TEST_ASSERT_TRUE(current.maxTime <= constant.maxTime);
+  TEST_ASSERT_TRUE(current.reversals <= commandedReversals(commands));
+  TEST_ASSERT_TRUE(current.peakRate <= StepGenerator::MaxStepRate);
+  TEST_ASSERT_TRUE(current.peakRate <= STEPPER_MAX_VELOCITY * 1.1f);
+}
+
+// Shifter presses: bursts up and down the gears, a few hundred ms apart.
+void test_shifting(void) {
+  std::vector<Command> commands;
+  int32_t position = 0;
+  uint32_t now     = 0;
+  for (int burst = 0; burst < 20; burst++) {
+    const int32_t direction = burst % 2 == 0 ? 1 : -1;
+    for (int press = 0; press < 1 + burst % 4; press++) {
+      position += direction * ShiftStep;
+      commands.push_back({now, position});
+      now += 250;
+    }
+    now += 2000;
+  }
+  compare("shifting", commands);
+}
+
+// Simulation mode: the app sends a new grade every few seconds along a hilly route.
+void test_simulation(void) {
+  std::vector<Command> commands;
+  srand(5);
+  float grade = 0;  // %
+  for (uint32_t now = 0; now < 300000; now += 2000 + rand() % 3000) {
+    grade = fmaxf(-5, fminf(12, grade + (rand() % 400 - 200) / 100.0f));
+    commands.push_back({now, static_cast<int32_t>(grade * 100 * InclineMultiplier)});
+  }
+  compare("sim", commands);
+}
+
+// ERG: the controller trims the incline at 10 Hz, with jumps at interval changes.
+void test_erg(void) {
+  std::vector<Command> commands;
+  srand(7);
+  float incline = 0;
+  for (uint32_t now = 0; now < 300000; now += 1000 / ERG_UPDATE_RATE) {
+    if (now % 60000 == 0) {
+      incline = (now / 60000) % 2 == 0 ? 2500 : 600;  // Hard and easy intervals
+    }
+    incline += (rand() % 200 - 100) / 10.0f;
+    commands.push_back({now, static_cast<int32_t>(incline * InclineMultiplier)});
+  }
+  compare("erg", commands);
+}
+
+void test_recorded_stream(void) {
+  const char *path = getenv("SS2K_MOTION");
+  if (path == nullptr) {
+    TEST_MESSAGE("SS2K_MOTION not set, no recorded stream to play");
+    return;
+  }
+  FILE *file = fopen(path, "r");
+  TEST_ASSERT_NOT_NULL(file);
+  if (file == nullptr) {
+    return;
+  }
+  std::vector<Command> commands;
+  unsigned long time;
+  long target;
+  while (fscanf(file, "%lu,%ld", &time, &target) == 2) {
+    commands.push_back({static_cast<uint32_t>(time), static_cast<int32_t>(target)});
+  }
+  fclose(file);
+  TEST_ASSERT_GREATER_THAN(0, commands.size());
+  compare("recorded", commands);
+}
+
+void process() {
+  UNITY_BEGIN();
+  RUN_TEST(test_shifting);
+  RUN_TEST(test_simulation);
+  RUN_TEST(test_erg);
+  RUN_TEST(test_recorded_stream);
+  UNITY_END();
+}
+
+#ifdef ARDUINO
+
+#include <Arduino.h>
+void setup() {
+  delay(2000);
+  process();
+}
+
+void loop() {}
+
+#else
+
+int main(int argc, char **argv) {
+  process();
+  return 0;
+}
+
+#endif
@@ -0,0 +1,139 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include <unity.h>
+#include <math.h>
+#include <MotionPlanner.h>
+
+static const MotionPlanner::Limits limits = {20000, 100000, 2000000};
+static const float dt                     = 0.005f;  // As the stepper task plans
+
+struct Run {
+  float time;
+  float maxVelocity;
+  float maxAcceleration;
+  float maxJerk;
+  float overshoot;  // Past the final target
+  float lowest;
+  float highest;
+};
+
+// Runs until settled, switching to the second target after switchAt s. The snap onto the target on the
+// last update is left out of the jerk.
+static Run runTo(MotionPlanner &planner, int32_t target, float switchAt = 0, int32_t nextTarget = 0) {
+  Run run            = {0, 0, 0, 0, 0, 0, 0};
+  float direction    = target >= planner.getPosition() ? 1 : -1;
+  float acceleration = 0;
+  run.lowest = run.highest = planner.getPosition();
+  planner.setTarget(target);
+  while (!planner.isSettled() && run.time < 10) {
+    if (switchAt > 0 && run.time >= switchAt) {
+      planner.setTarget(nextTarget);
+      direction = nextTarget >= planner.getPosition() ? 1 : -1;
+      switchAt  = 0;
+    }
+    planner.update(dt);
+    run.time += dt;
+    if (!planner.isSettled()) {
+      run.maxJerk = fmaxf(run.maxJerk, fabsf(planner.getAcceleration() - acceleration) / dt);
+    }
+    acceleration        = planner.getAcceleration();
+    run.maxVelocity     = fmaxf(run.maxVelocity, fabsf(planner.getVelocity()));
+    run.maxAcceleration = fmaxf(run.maxAcceleration, fabsf(acceleration));
+    run.overshoot       = fmaxf(run.overshoot, (planner.getPosition() - planner.getTarget()) * direction);
+    run.lowest          = fminf(run.lowest, planner.getPosition());
+    run.highest         = fmaxf(run.highest, planner.getPosition());
+  }
+  return run;
+}
+
+static void assertWithinLimits(const Run &run, const MotionPlanner::Limits &limits) {
+  TEST_ASSERT_TRUE(run.maxVelocity <= limits.maxVelocity * 1.001f);
+  TEST_ASSERT_TRUE(run.maxAcceleration <= limits.maxAcceleration * 1.001f);
+  TEST_ASSERT_TRUE(limits.maxJerk == 0 || run.maxJerk <= limits.maxJerk * 1.01f);
+  TEST_ASSERT_TRUE(run.overshoot <= 0.5f);
+}
+
+void test_moves_within_limits_without_overshoot(void) {
+  MotionPlanner planner(limits);
+  const int32_t targets[] = {18000, 17000, 15000, 18000, -3000, -2950, -3000};
+  for (int32_t target : targets) {
+    const float start = planner.getPosition();
+    const Run run     = runTo(planner, target);
+    TEST_ASSERT_TRUE(planner.isSettled());
+    TEST_ASSERT_EQUAL(target, planner.getPosition());
+    assertWithinLimits(run, limits);
+    // Never much slower than a trapezoid without the jerk limit.
+    const float distance  = fabsf(target - start);
+    const float cruise    = fmaxf(0, distance - limits.maxVelocity * limits.maxVelocity / limits.maxAcceleration) / limits.maxVelocity;
+    const float ramps     = 2 * sqrtf(fminf(distance, limits.maxVelocity * limits.maxVelocity / limits.maxAcceleration) / limits.maxAcceleration);
+    const float trapezoid = cruise + ramps;
+    TEST_ASSERT_TRUE(run.time <= trapezoid * 1.2f + 0.1f);
+  }
+  // The full ERG incline range at the default multiplier, which took over 20 s a step at a time.
+  planner.reset(-6000);
+  TEST_ASSERT_TRUE(runTo(planner, 12000).time < 1.2f);
+}
+
+void test_retargets_mid_move(void) {
+  MotionPlanner planner(limits);
+  // Turned round at full speed: no pause at zero speed and nothing below the new target.
+  Run run = runTo(planner, 10000, 0.3f, 0);
+  assertWithinLimits(run, limits);
+  TEST_ASSERT_TRUE(run.lowest >= -0.5f);
+  TEST_ASSERT_TRUE(run.highest < 10000);
+  TEST_ASSERT_TRUE(run.time < 1.1f);
+
+  // Pulled in while cruising, as far as it can still stop.
+  planner.reset(0);
+  run = runTo(planner, 10000, 0.3f, 6100);
+  assertWithinLimits(run, limits);
+  TEST_ASSERT_TRUE(run.time < 0.6f);
+
+  // Extended while braking carries on without stopping.
+  planner.reset(0);
+  run = runTo(planner, 1000, 0.2f, 3000);
+  assertWithinLimits(run, limits);
+  TEST_ASSERT_TRUE(run.time < 0.6f);
+}
+
+void test_trapezoid_without_jerk_limit(void) {
+  const MotionPlanner::Limits trapezoid = {20000, 100000, 0};
+  MotionPlanner planner(trapezoid);
+  const Run run = runTo(planner, 18000);
+  TEST_ASSERT_EQUAL(18000, planner.getPosition());
+  assertWithinLimits(run, trapezoid);
+  // 0.7 s cruising and 0.4 s ramping.
+  TEST_ASSERT_TRUE(run.time >= 1.1f && run.time < 1.15f);
+}
+
+void process() {
+  UNITY_BEGIN();
+  RUN_TEST(test_moves_within_limits_without_overshoot);
+  RUN_TEST(test_retargets_mid_move);
+  RUN_TEST(test_trapezoid_without_jerk_limit);
+  UNITY_END();
+}
+
+#ifdef ARDUINO
+
+#include <Arduino.h>
+void setup() {
+  delay(2000);
+  process();
+}
+
+void loop() {}
+
+#else
+
+int main(int argc, char **argv) {
+  process();
+  return 0;
+}
+
+#endif
@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include <unity.h>
+#include <NotifyFanout.h>
+
+static const uint8_t Power     = 0;
+static const uint8_t HeartRate = 1;
+
+void test_sends_to_subscribed_peers(void) {
+  NotifyFanout fanout;
+  uint16_t recipients[NotifyFanout::MaxPeers];
+  TEST_ASSERT_TRUE(fanout.addPeer(1));
+  fanout.setSubscribed(1, Power, true);
+  fanout.setSubscribed(2, Power, true);  // Subscribed before its connect was seen
+  fanout.setSubscribed(2, HeartRate, true);
+
+  TEST_ASSERT_EQUAL(2, fanout.getRecipients(Power, 0, recipients));
+  TEST_ASSERT_EQUAL(1, fanout.getRecipients(HeartRate, 0, recipients));
+  TEST_ASSERT_EQUAL(2, recipients[0]);
+
+  fanout.setSubscribed(2, HeartRate, false);
+  TEST_ASSERT_EQUAL(0, fanout.getRecipients(HeartRate, 0, recipients));
+  fanout.removePeer(1);
+  TEST_ASSERT_EQUAL(1, fanout.getRecipients(Power, 0, recipients));
+  TEST_ASSERT_EQUAL(2, recipients[0]);
+}
+
+// A peer that keeps failing is skipped for longer and longer, the other keeps getting everything.
+void test_backs_off_congested_peer(void) {
+  NotifyFanout fanout;
+  uint16_t recipients[NotifyFanout::MaxPeers];
+  fanout.setSubscribed(1, Power, true);
+  fanout.setSubscribed(2, Power, true);
+
+  uint32_t attempts[3] = {0, 0, 0};
+  for (uint32_t now = 0; now < 1000000; now += 10000) {
+    uint8_t count = fanout.getRecipients(Power, now, recipients);
+    for (uint8_t i = 0; i < count; i++) {
+      attempts[recipients[i]]++;
+      fanout.recordResult(recipients[i], recipients[i] == 1, now);
+    }
+  }
+  TEST_ASSERT_EQUAL(100, attempts[1]);
+  TEST_ASSERT_EQUAL(4, attempts[2]);  // At 0, 100, 300 and 700 ms
+
+  const NotifyFanout::Peer &primary = fanout.getPeer(0);
+  const NotifyFanout::Peer &flaky   = fanout.getPeer(1);
+  TEST_ASSERT_EQUAL(100, primary.sent);
+  TEST_ASSERT_EQUAL(0, primary.failed);
+  TEST_ASSERT_EQUAL(4, flaky.failed);
+  TEST_ASSERT_EQUAL(96, flaky.skipped);
+
+  // Recovers on the first notification that goes through.
+  TEST_ASSERT_EQUAL(2, fanout.getRecipients(Power, 700000 + 800000, recipients));
+  fanout.recordResult(2, true, 1500000);
+  TEST_ASSERT_EQUAL(0, flaky.failureStreak);
+  TEST_ASSERT_EQUAL(2, fanout.getRecipients(Power, 1510000, recipients));
+}
+
+void test_backoff_is_capped(void) {
+  NotifyFanout fanout;
+  uint16_t recipients[NotifyFanout::MaxPeers];
+  fanout.setSubscribed(1, Power, true);
+  for (int i = 0; i < 300; i++) {
+    fanout.recordResult(1, false, 0xFFFFFFFF - 1000);  // Across the micros() rollover
+  }
+  TEST_ASSERT_EQUAL(0, fanout.getRecipients(Power, NotifyFanout::MaxBackoff - 1002, recipients));
+  TEST_ASSERT_EQUAL(1, fanout.getRecipients(Power, NotifyFanout::MaxBackoff - 1001, recipients));
+}
+
+void process() {
+  UNITY_BEGIN();
+  RUN_TEST(test_sends_to_subscribed_peers);
+  RUN_TEST(test_backs_off_congested_peer);
+  RUN_TEST(test_backoff_is_capped);
+  UNITY_END();
+}
+
+#ifdef ARDUINO
+
+#include <Arduino.h>
+void setup() {
+  delay(2000);
+  process();
+}
+
+void loop() {}
+
+#else
+
+int main(int argc, char **argv) {
+  process();
+  return 0;
+}
+
+#endif
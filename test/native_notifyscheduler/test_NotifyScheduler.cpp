@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include <unity.h>
+#include <NotifyScheduler.h>
+
+static const uint8_t Power     = 0;
+static const uint8_t HeartRate = 1;
+
+void test_sends_fresh_data_immediately(void) {
+  NotifyScheduler scheduler;
+  scheduler.setMaxRate(Power, 4);
+  TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, scheduler.getTimeUntilDue(1000));
+  TEST_ASSERT_EQUAL_UINT8(0, scheduler.takeDue(1000));
+
+  scheduler.markDirty(NotifyScheduler::bit(Power));
+  TEST_ASSERT_EQUAL_UINT32(0, scheduler.getTimeUntilDue(1000));
+  TEST_ASSERT_EQUAL_UINT8(NotifyScheduler::bit(Power), scheduler.takeDue(1000));
+  TEST_ASSERT_EQUAL_UINT8(0, scheduler.takeDue(1001));
+}
+
+void test_coalesces_to_max_rate(void) {
+  NotifyScheduler scheduler;
+  scheduler.setMaxRate(Power, 4);
+  scheduler.setMaxRate(HeartRate, 1);
+  scheduler.markDirty(NotifyScheduler::bit(Power) | NotifyScheduler::bit(HeartRate));
+  TEST_ASSERT_EQUAL_UINT8(NotifyScheduler::bit(Power) | NotifyScheduler::bit(HeartRate), scheduler.takeDue(0));
+
+  // A 20 Hz sensor for one second, polled every millisecond.
+  int powerSends     = 0;
+  int heartRateSends = 0;
+  for (uint32_t now = 1000; now <= 1000000; now += 1000) {
+    if (now % 50000 == 0) {
+      scheduler.markDirty(NotifyScheduler::bit(Power) | NotifyScheduler::bit(HeartRate));
+    }
+    const uint8_t due = scheduler.takeDue(now);
+    powerSends += (due >> Power) & 0x01;
+    heartRateSends += (due >> HeartRate) & 0x01;
+  }
+  TEST_ASSERT_EQUAL(4, powerSends);
+  TEST_ASSERT_EQUAL(1, heartRateSends);
+
+  scheduler.markDirty(NotifyScheduler::bit(Power));
+  TEST_ASSERT_EQUAL_UINT32(100000, scheduler.getTimeUntilDue(1150000));  // Last sent at 1000000
+}
+
+void test_rate_limit_survives_rollover(void) {
+  NotifyScheduler scheduler;
+  scheduler.setMaxRate(Power, 4);
+  scheduler.markDirty(NotifyScheduler::bit(Power));
+  TEST_ASSERT_EQUAL_UINT8(NotifyScheduler::bit(Power), scheduler.takeDue(0xFFFFFFFF - 100000));
+  scheduler.markDirty(NotifyScheduler::bit(Power));
+  TEST_ASSERT_EQUAL_UINT8(0, scheduler.takeDue(100000));
+  TEST_ASSERT_EQUAL_UINT32(49999, scheduler.getTimeUntilDue(100000));
+  TEST_ASSERT_EQUAL_UINT8(NotifyScheduler::bit(Power), scheduler.takeDue(150000));
+}
+
+void process() {
+  UNITY_BEGIN();
+  RUN_TEST(test_sends_fresh_data_immediately);
+  RUN_TEST(test_coalesces_to_max_rate);
+  RUN_TEST(test_rate_limit_survives_rollover);
+  UNITY_END();
+}
+
+#ifdef ARDUINO
+
+#include <Arduino.h>
+void setup() {
+  delay(2000);
+  process();
+}
+
+void loop() {}
+
+#else
+
+int main(int argc, char **argv) {
+  process();
+  return 0;
+}
+
+#endif
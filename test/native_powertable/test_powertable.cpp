@@ -0,0 +1,145 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <unity.h>
+#include <PowerTable.h>
+
+// 100 W at rest plus 0.02 W per step, at 90 rpm. Power scales with cadence.
+static float trainerWatts(int32_t position, float cadence) { return (100 + 0.02f * position) * cadence / 90; }
+
+static void learn(PowerTable &table, uint32_t count) {
+  uint32_t seed = 1;
+  for (uint32_t i = 0; i < count; i++) {
+    seed                   = seed * 1103515245 + 12345;
+    const int32_t position = static_cast<int32_t>((seed >> 8) % 20000);
+    const float cadence    = 60 + static_cast<float>((seed >> 4) % 50);
+    table.addSample(position, cadence, trainerWatts(position, cadence));
+  }
+}
+
+void test_learns_watts_and_positions(void) {
+  PowerTable table(-6000, 2000, 50, 10);
+  learn(table, 3000);
+  TEST_ASSERT_EQUAL(3000, table.getSamples());
+
+  float watts;
+  TEST_ASSERT_TRUE(table.getWatts(5000, 90, &watts));
+  TEST_ASSERT_TRUE(fabsf(watts - trainerWatts(5000, 90)) < 5);
+  TEST_ASSERT_TRUE(table.getWatts(12345, 75, &watts));
+  TEST_ASSERT_TRUE(fabsf(watts - trainerWatts(12345, 75)) < 5);
+
+  int32_t position;
+  TEST_ASSERT_TRUE(table.getPosition(250, 90, &position));
+  TEST_ASSERT_TRUE(abs(position - 7500) < 300);
+  TEST_ASSERT_TRUE(table.getPosition(250, 100, &position));
+  TEST_ASSERT_TRUE(position < 7500);  // Less resistance for the same power when spinning faster
+}
+
+void test_only_answers_what_it_has_learned(void) {
+  PowerTable table(-6000, 2000, 50, 10);
+  float watts;
+  int32_t position;
+  TEST_ASSERT_FALSE(table.getWatts(0, 90, &watts));
+  TEST_ASSERT_FALSE(table.getPosition(200, 90, &position));
+
+  table.addSample(4000, 90, 180);
+  TEST_ASSERT_TRUE(table.getWatts(4000, 90, &watts));
+  TEST_ASSERT_TRUE(fabsf(watts - 180) < 0.01f);
+  TEST_ASSERT_FALSE(table.getWatts(12000, 90, &watts));
+  TEST_ASSERT_FALSE(table.getWatts(-7000, 90, &watts));  // Outside the grid
+  table.addSample(50000, 90, 500);                       // Dropped
+  TEST_ASSERT_EQUAL(1, table.getSamples());
+  TEST_ASSERT_FALSE(table.getPosition(180, 90, &position));  // Needs a rising span
+}
+
+void test_serializes_to_flash_format(void) {
+  PowerTable table(-6000, 2000, 50, 10);
+  learn(table, 1000);
+  uint8_t data[PowerTable::SerializedSize];
+  TEST_ASSERT_EQUAL(0, table.serialize(data, sizeof(data) - 1));
+  TEST_ASSERT_EQUAL(PowerTable::SerializedSize, table.serialize(data, sizeof(data)));
+
+  PowerTable loaded(-6000, 2000, 50, 10);
+  TEST_ASSERT_FALSE(loaded.deserialize(data, sizeof(data) - 1));
+  TEST_ASSERT_TRUE(loaded.deserialize(data, sizeof(data)));
+  float expected, watts;
+  TEST_ASSERT_TRUE(table.getWatts(9000, 80, &expected));
+  TEST_ASSERT_TRUE(loaded.getWatts(9000, 80, &watts));
+  TEST_ASSERT_TRUE(fabsf(watts - expected) < 0.1f);
+
+  PowerTable otherGrid(-6000, 1000, 50, 10);
+  TEST_ASSERT_FALSE(otherGrid.deserialize(data, sizeof(data)));
+  TEST_ASSERT_FALSE(otherGrid.getWatts(9000, 80, &watts));
+}
+
+// Positions restart at 0 on every boot, so a loaded table is only used once it matches the trainer.
+void test_checks_the_position_origin(void) {
+  PowerTable table(-6000, 2000, 50, 10);
+  learn(table, 1000);
+  uint8_t data[PowerTable::SerializedSize];
+  table.serialize(data, sizeof(data));
+
+  PowerTable loaded(-6000, 2000, 50, 10);
+  TEST_ASSERT_TRUE(loaded.deserialize(data, sizeof(data)));
+  TEST_ASSERT_FALSE(loaded.isTrusted());
+  int32_t position;
+  TEST_ASSERT_FALSE(loaded.getPosition(250, 90, &position));
+  for (uint8_t i = 0; i < PowerTable::MatchSamples; i++) {
+    loaded.addSample(7000 + i * 10, 90, trainerWatts(7000 + i * 10, 90));
+  }
+  TEST_ASSERT_TRUE(loaded.isTrusted());
+  TEST_ASSERT_TRUE(loaded.getPosition(250, 90, &position));
+  TEST_ASSERT_TRUE(abs(position - 7500) < 300);
+
+  // Powered up 5000 steps further on. Samples are held while untrusted, and the table starts over once
+  // they keep disagreeing.
+  TEST_ASSERT_TRUE(loaded.deserialize(data, sizeof(data)));
+  for (uint8_t i = 0; i < PowerTable::MatchSamples - 1; i++) {
+    loaded.addSample(2000, 90, trainerWatts(7000, 90));
+  }
+  TEST_ASSERT_EQUAL(0, loaded.getSamples());
+  float watts;
+  TEST_ASSERT_TRUE(loaded.getWatts(2000, 90, &watts));
+  TEST_ASSERT_TRUE(fabsf(watts - trainerWatts(2000, 90)) < 5);
+  loaded.addSample(2000, 90, trainerWatts(7000, 90));
+  TEST_ASSERT_TRUE(loaded.isTrusted());
+  TEST_ASSERT_EQUAL(1, loaded.getDiscarded());
+  TEST_ASSERT_EQUAL(1, loaded.getSamples());
+  TEST_ASSERT_FALSE(loaded.getWatts(8000, 90, &watts));  // Forgotten
+  TEST_ASSERT_TRUE(loaded.getWatts(2000, 90, &watts));
+  TEST_ASSERT_TRUE(fabsf(watts - trainerWatts(7000, 90)) < 0.01f);
+}
+
+void process() {
+  UNITY_BEGIN();
+  RUN_TEST(test_learns_watts_and_positions);
+  RUN_TEST(test_only_answers_what_it_has_learned);
+  RUN_TEST(test_serializes_to_flash_format);
+  RUN_TEST(test_checks_the_position_origin);
+  UNITY_END();
+}
+
+#ifdef ARDUINO
+
+#include <Arduino.h>
+void setup() {
+  delay(2000);
+  process();
+}
+
+void loop() {}
+
+#else
+
+int main(int argc, char **argv) {
+  process();
+  return 0;
+}
+
+#endif
@@ -0,0 +1,257 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+// Sensor trace round trip and replay. To replay a trace downloaded from /sensortrace run:
+//   SS2K_TRACE=sensortrace.bin pio test -e native -f native_replay
+
+#include "sdkconfig.h"
+#include <unity.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+#include <Constants.h>
+#include <ERG.h>
+#include <SensorTrace.h>
+#include <ServerEncoders.h>
+#include <sensors/SensorDataFactory.h>
+#include "settings.h"
+
+// What the firmware does with a notification: decode it, run ERG, and encode what the server would notify.
+// The ERG task runs at ERG_UPDATE_RATE off the latest samples, here in the trace's time.
+struct Pipeline {
+  static const uint32_t ERGPeriod = 1000000 / ERG_UPDATE_RATE;
+  SensorDataFactory factory;
+  ERGController erg{{ERG_PROPORTIONAL_GAIN, ERG_INTEGRAL_GAIN, ERG_DERIVATIVE_GAIN, ERG_FEED_FORWARD_GAIN},
+                    {ERG_MIN_INCLINE, ERG_MAX_INCLINE, ERG_MAX_INCLINE_RATE, ERG_MIN_CADENCE}};
+  bool started        = false;
+  uint32_t nextUpdate = 0;
+  float cadence = 0;
+  int watts     = 0;
+  int heartRate = 0;
+  float speed   = 0;
+  float incline = 0;
+  int setPoint  = 200;
+  uint8_t indoorBikeData[IndoorBikeDataEncoder::Size];
+  uint8_t cyclingPowerMeasurement[CyclingPowerMeasurementEncoder::Size];
+  uint8_t heartRateMeasurement[HeartRateMeasurementEncoder::Size];
+
+  void handle(SensorTracePacket &packet) {
+    SensorData &sensorData = this->factory.getSensorData(packet.sensorId, packet.data, packet.length);
+    if (sensorData.hasHeartRate()) {
+      this->heartRate = sensorData.getHeartRate();
+    }
+    if (sensorData.hasCadence()) {
+      this->cadence = sensorData.getCadence();
+    }
+    if (sensorData.hasPower()) {
+      this->watts = sensorData.getPower();
+    }
+    if (sensorData.hasSpeed()) {
+      this->speed = sensorData.getSpeed();
+    }
+    if (!this->started) {
+      this->erg.setTarget(this->setPoint, this->incline, packet.timestamp);
+      this->nextUpdate = packet.timestamp;
+      this->started    = true;
+    }
+    while (static_cast<int32_t>(packet.timestamp - this->nextUpdate) >= 0) {
+      this->incline = this->erg.update(this->watts, this->cadence, this->nextUpdate);
+      this->nextUpdate += ERGPeriod;
+    }
+    encodeIndoorBikeData(this->indoorBikeData, this->cadence, this->watts, this->heartRate, this->speed);
+    encodeCyclingPowerMeasurement(this->cyclingPowerMeasurement, this->watts, 0, 0);
+    encodeHeartRateMeasurement(this->heartRateMeasurement, this->heartRate);
+  }
+};
+
+static void append(std::vector<uint8_t> &trace, SensorTraceWriter &writer, uint32_t timestamp, const NimBLEUUID &uuid, const uint8_t *data, size_t length) {
+  uint8_t record[SensorTraceWriter::MaxRecordSize];
+  size_t size = writer.writePacket(record, sizeof(record), timestamp, uuid, data, length);
+  TEST_ASSERT_GREATER_THAN(0, size);
+  trace.insert(trace.end(), record, record + size);
+}
+
+// A power meter at 4 Hz with the rider at 120 rpm and a heart rate strap at 1 Hz, starting just before the micros() rollover.
+static std::vector<uint8_t> rideTrace(int seconds) {
+  SensorTraceWriter writer;
+  std::vector<uint8_t> trace(SensorTraceWriter::HeaderSize);
+  writer.writeHeader(trace.data(), trace.size());
+  uint32_t timestamp = 0xFFFFFFFF - 500000;
+  for (int i = 0; i < seconds * 4; i++) {
+    uint16_t power     = 180 + (i % 40);
+    uint16_t crankTime = (i / 2) * 512;  // 120 rpm, in 1/1024 s
+    uint8_t cps[]      = {0x21, 0x00, static_cast<uint8_t>(power), static_cast<uint8_t>(power >> 8), 0x64, static_cast<uint8_t>(i / 2), 0, static_cast<uint8_t>(crankTime),
+                          static_cast<uint8_t>(crankTime >> 8)};
+    append(trace, writer, timestamp, CYCLINGPOWERMEASUREMENT_UUID, cps, sizeof(cps));
+    if (i % 4 == 0) {
+      uint8_t hr[] = {0x00, static_cast<uint8_t>(120 + (i % 30))};
+      append(trace, writer, timestamp + 1000, HEARTCHARACTERISTIC_UUID, hr, sizeof(hr));
+    }
+    timestamp += 250000;
+  }
+  return trace;
+}
+
+void test_round_trips_packets(void) {
+  SensorTraceWriter writer;
+  std::vector<uint8_t> trace(SensorTraceWriter::HeaderSize);
+  TEST_ASSERT_EQUAL(SensorTraceWriter::HeaderSize, writer.writeHeader(trace.data(), trace.size()));
+  uint8_t flywheel[] = {0xFF, 0x1F, 0x0C, 0x00, 0xC8, 0, 0, 0, 0, 0, 0, 0, 0x5A, 0, 0, 0};
+  uint8_t hr[]       = {0x00, 0x8C};
+  append(trace, writer, 1000, FLYWHEEL_UART_TX_UUID, flywheel, sizeof(flywheel));
+  append(trace, writer, 2000, HEARTCHARACTERISTIC_UUID, hr, sizeof(hr));
+  append(trace, writer, 3000, FLYWHEEL_UART_TX_UUID, flywheel, sizeof(flywheel));
+
+  // Only the first notification of a characteristic carries its UUID.
+  TEST_ASSERT_EQUAL(SensorTraceWriter::HeaderSize + (3 + 16 + 7 + 16) + (3 + 2 + 7 + 2) + (7 + 16), trace.size());
+
+  SensorTraceReader reader(trace.data(), trace.size());
+  SensorTracePacket packet;
+  TEST_ASSERT_TRUE(reader.isValid());
+  TEST_ASSERT_TRUE(reader.next(&packet));
+  TEST_ASSERT_EQUAL_UINT32(1000, packet.timestamp);
+  TEST_ASSERT_TRUE(packet.charUUID == FLYWHEEL_UART_TX_UUID);
+  TEST_ASSERT_EQUAL(SensorDataFactory::Types::Flywheel, packet.sensorId);
+  TEST_ASSERT_EQUAL(sizeof(flywheel), packet.length);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(flywheel, packet.data, sizeof(flywheel));
+  TEST_ASSERT_TRUE(reader.next(&packet));
+  TEST_ASSERT_EQUAL_UINT32(2000, packet.timestamp);
+  TEST_ASSERT_EQUAL(SensorDataFactory::Types::HeartRate, packet.sensorId);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(hr, packet.data, sizeof(hr));
+  TEST_ASSERT_TRUE(reader.next(&packet));
+  TEST_ASSERT_EQUAL_UINT32(3000, packet.timestamp);
+  TEST_ASSERT_EQUAL(SensorDataFactory::Types::Flywheel, packet.sensorId);
+  TEST_ASSERT_FALSE(reader.next(&packet));
+}
+
+void test_stops_at_truncated_record(void) {
+  std::vector<uint8_t> trace = rideTrace(1);
+  SensorTracePacket packet;
+
+  SensorTraceReader truncated(trace.data(), trace.size() - 1);
+  int count = 0;
+  while (truncated.next(&packet)) {
+    count++;
+  }
+  TEST_ASSERT_EQUAL(4, count);  // 4 power + 1 heart rate, minus the cut one
+
+  trace[0] = 'X';
+  SensorTraceReader corrupt(trace.data(), trace.size());
+  TEST_ASSERT_FALSE(corrupt.isValid());
+  TEST_ASSERT_FALSE(corrupt.next(&packet));
+}
+
+void test_replays_faster_than_real_time(void) {
+  std::vector<uint8_t> trace = rideTrace(60);
+  SensorTraceReplay replay(trace.data(), trace.size());
+  Pipeline pipeline;
+
+  auto start     = std::chrono::steady_clock::now();
+  size_t packets = replay.run([&pipeline](SensorTracePacket &packet) { pipeline.handle(packet); }, 1000,
+                              [](uint32_t microseconds) { std::this_thread::sleep_for(std::chrono::microseconds(microseconds)); });
+  double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  TEST_ASSERT_EQUAL(60 * 4 + 60, packets);
+  TEST_ASSERT_EQUAL(59750000, replay.getTraceDuration());  // Across the micros() rollover
+  TEST_ASSERT_TRUE(elapsed >= 0.059);                      // 60 s at 1000x
+  TEST_ASSERT_TRUE(elapsed < 1.0);
+
+  TEST_ASSERT_EQUAL(219, pipeline.watts);
+  TEST_ASSERT_EQUAL(219, pipeline.indoorBikeData[6]);
+  TEST_ASSERT_EQUAL(219, pipeline.cyclingPowerMeasurement[2]);
+  TEST_ASSERT_EQUAL(120 + (236 % 30), pipeline.heartRateMeasurement[1]);
+  TEST_ASSERT_FLOAT_WITHIN(1, 120, pipeline.cadence);
+  TEST_ASSERT_EQUAL(598, pipeline.erg.getMetrics().updates);          // 59.75 s at ERG_UPDATE_RATE, from the first packet
+  TEST_ASSERT_LESS_THAN(10, pipeline.erg.getMetrics().gatedUpdates);  // Until the crank events give a cadence
+}
+
+// Reads a trace the way it comes off /sensortrace, as one binary file.
+static std::vector<uint8_t> readTrace(FILE *file) {
+  std::vector<uint8_t> trace;
+  uint8_t buffer[4096];
+  size_t read;
+  while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+    trace.insert(trace.end(), buffer, buffer + read);
+  }
+  return trace;
+}
+
+void test_replays_trace_file(void) {
+  std::vector<uint8_t> written = rideTrace(10);
+  FILE *file                   = tmpfile();
+  TEST_ASSERT_NOT_NULL(file);
+  if (file == nullptr) {
+    return;
+  }
+  TEST_ASSERT_EQUAL(written.size(), fwrite(written.data(), 1, written.size(), file));
+  rewind(file);
+  std::vector<uint8_t> trace = readTrace(file);
+  fclose(file);
+
+  SensorTraceReplay replay(trace.data(), trace.size());
+  Pipeline pipeline;
+  TEST_ASSERT_EQUAL(10 * 4 + 10, replay.run([&pipeline](SensorTracePacket &packet) { pipeline.handle(packet); }));
+  TEST_ASSERT_EQUAL(219, pipeline.watts);
+}
+
+void test_replays_recorded_trace(void) {
+  const char *path = getenv("SS2K_TRACE");
+  if (path == nullptr) {
+    TEST_MESSAGE("SS2K_TRACE not set, no recorded trace to replay");
+    return;
+  }
+  FILE *file = fopen(path, "rb");
+  TEST_ASSERT_NOT_NULL(file);
+  if (file == nullptr) {
+    return;
+  }
+  std::vector<uint8_t> trace = readTrace(file);
+  fclose(file);
+
+  SensorTraceReplay replay(trace.data(), trace.size());
+  Pipeline pipeline;
+  auto start     = std::chrono::steady_clock::now();
+  size_t packets = replay.run([&pipeline](SensorTracePacket &packet) { pipeline.handle(packet); });
+  double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  TEST_ASSERT_GREATER_THAN(0, packets);
+
+  char message[150];
+  snprintf(message, sizeof(message), "%zu notifications, %.0f s of riding replayed in %.3f s (%.0fx)", packets, replay.getTraceDuration() / 1e6, elapsed,
+           replay.getTraceDuration() / 1e6 / elapsed);
+  TEST_MESSAGE(message);
+}
+
+void process() {
+  UNITY_BEGIN();
+  RUN_TEST(test_round_trips_packets);
+  RUN_TEST(test_stops_at_truncated_record);
+  RUN_TEST(test_replays_faster_than_real_time);
+  RUN_TEST(test_replays_trace_file);
+  RUN_TEST(test_replays_recorded_trace);
+  UNITY_END();
+}
+
+#ifdef ARDUINO
+
+#include <Arduino.h>
+void setup() {
+  delay(2000);
+  process();
+}
+
+void loop() {}
+
+#else
+
+int main(int argc, char **argv) {
+  process();
+  return 0;
+}
+
+#endif
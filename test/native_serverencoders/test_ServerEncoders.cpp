@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include <unity.h>
+#include <ServerEncoders.h>
+#include <sensors/FitnessMachineIndoorBikeData.h>
+
+void test_encodes_server_characteristics(void) {
+  uint8_t indoorBikeData[IndoorBikeDataEncoder::Size];
+  uint8_t expectedIndoorBikeData[] = {0x44, 0x02, 0xC4, 0x09, 0xB4, 0x00, 0xFA, 0x00, 0x8C};
+  TEST_ASSERT_EQUAL(sizeof(expectedIndoorBikeData), encodeIndoorBikeData(indoorBikeData, 90, 250, 140, 25));
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(expectedIndoorBikeData, indoorBikeData, sizeof(expectedIndoorBikeData));
+
+  uint8_t cyclingPowerMeasurement[CyclingPowerMeasurementEncoder::Size];
+  uint8_t expectedCyclingPowerMeasurement[] = {0x23, 0x00, 0xFA, 0x00, 0x00, 0x2C, 0x01, 0xE8, 0x03};
+  TEST_ASSERT_EQUAL(sizeof(expectedCyclingPowerMeasurement), encodeCyclingPowerMeasurement(cyclingPowerMeasurement, 250, 300, 1000));
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(expectedCyclingPowerMeasurement, cyclingPowerMeasurement, sizeof(expectedCyclingPowerMeasurement));
+
+  uint8_t heartRateMeasurement[HeartRateMeasurementEncoder::Size];
+  uint8_t expectedHeartRateMeasurement[] = {0x00, 0x8C};
+  TEST_ASSERT_EQUAL(sizeof(expectedHeartRateMeasurement), encodeHeartRateMeasurement(heartRateMeasurement, 140));
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(expectedHeartRateMeasurement, heartRateMeasurement, sizeof(expectedHeartRateMeasurement));
+}
+
+// Fields a decoder finds where the encoder put them, whatever else is sent.
+void test_derives_flags_from_fields(void) {
+  typedef IndoorBikeDataLayout::Types Types;
+  typedef CharacteristicEncoder<IndoorBikeDataLayout, Types::InstantaneousCadence, Types::TotalDistance, Types::InstantaneousPower, Types::TotalEnergy, Types::EnergyPerHour,
+                                Types::EnergyPerMinute, Types::ElapsedTime>
+      Encoder;
+  TEST_ASSERT_EQUAL_UINT32(0x0955, Encoder::Flags);  // No speed sets More Data
+  TEST_ASSERT_EQUAL(2 + 2 + 3 + 2 + 2 + 2 + 1 + 2, Encoder::Size);
+
+  uint8_t packet[Encoder::Size];
+  Encoder(packet)
+      .set<Types::InstantaneousCadence>(180)
+      .set<Types::TotalDistance>(123456)
+      .set<Types::InstantaneousPower>(-5)
+      .set<Types::TotalEnergy>(300)
+      .set<Types::EnergyPerHour>(900)
+      .set<Types::EnergyPerMinute>(15)
+      .set<Types::ElapsedTime>(3600);
+
+  int32_t value;
+  TEST_ASSERT_FALSE(FitnessMachineIndoorBikeData::extract<Types::InstantaneousSpeed>(packet, sizeof(packet), &value));
+  TEST_ASSERT_TRUE(FitnessMachineIndoorBikeData::extract<Types::InstantaneousCadence>(packet, sizeof(packet), &value));
+  TEST_ASSERT_EQUAL(180, value);
+  TEST_ASSERT_TRUE(FitnessMachineIndoorBikeData::extract<Types::TotalDistance>(packet, sizeof(packet), &value));
+  TEST_ASSERT_EQUAL(123456, value);
+  TEST_ASSERT_TRUE(FitnessMachineIndoorBikeData::extract<Types::InstantaneousPower>(packet, sizeof(packet), &value));
+  TEST_ASSERT_EQUAL(-5, value);
+  TEST_ASSERT_TRUE(FitnessMachineIndoorBikeData::extract<Types::EnergyPerMinute>(packet, sizeof(packet), &value));
+  TEST_ASSERT_EQUAL(15, value);
+  TEST_ASSERT_TRUE(FitnessMachineIndoorBikeData::extract<Types::ElapsedTime>(packet, sizeof(packet), &value));
+  TEST_ASSERT_EQUAL(3600, value);
+  TEST_ASSERT_FALSE(FitnessMachineIndoorBikeData::extract<Types::HeartRate>(packet, sizeof(packet), &value));
+}
+
+void process() {
+  UNITY_BEGIN();
+  RUN_TEST(test_encodes_server_characteristics);
+  RUN_TEST(test_derives_flags_from_fields);
+  UNITY_END();
+}
+
+#ifdef ARDUINO
+
+#include <Arduino.h>
+void setup() {
+  delay(2000);
+  process();
+}
+
+void loop() {}
+
+#else
+
+int main(int argc, char **argv) {
+  process();
+  return 0;
+}
+
+#endif
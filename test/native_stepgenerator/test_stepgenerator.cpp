@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include <unity.h>
+#include <StepGenerator.h>
+
+// Runs the generator until it is idle, checking the pulses on the way. Returns the ticks taken.
+static uint32_t runUntilIdle(StepGenerator &generator, uint32_t *steps, uint32_t *longestGap, uint32_t *shortestGap) {
+  uint32_t ticks    = 0;
+  uint32_t lastStep = 0;
+  uint8_t previous  = 0;
+  *steps            = 0;
+  *longestGap       = 0;
+  *shortestGap      = UINT32_MAX;
+  while (generator.isBusy() && ticks < 10000000) {
+    const uint8_t pins = generator.tick();
+    ticks++;
+    if (pins & StepGenerator::StepPin) {
+      // One tick high, and direction held while it is.
+      TEST_ASSERT_FALSE(previous & StepGenerator::StepPin);
+      TEST_ASSERT_TRUE(*steps == 0 || (previous & StepGenerator::DirectionPin) == (pins & StepGenerator::DirectionPin));
+      if (*steps > 0) {
+        const uint32_t gap = ticks - lastStep;
+        *longestGap        = gap > *longestGap ? gap : *longestGap;
+        *shortestGap       = gap < *shortestGap ? gap : *shortestGap;
+      }
+      lastStep = ticks;
+      (*steps)++;
+    }
+    previous = pins;
+  }
+  return ticks;
+}
+
+void test_steps_at_requested_rate(void) {
+  StepGenerator generator;
+  TEST_ASSERT_TRUE(generator.push(1000, 1000));
+  uint32_t steps, longest, shortest;
+  const uint32_t ticks = runUntilIdle(generator, &steps, &longest, &shortest);
+  TEST_ASSERT_EQUAL(1000, steps);
+  TEST_ASSERT_EQUAL(1000, generator.getPosition());
+  // 50 ticks apart exactly, the last one after 1 s.
+  TEST_ASSERT_EQUAL(50, longest);
+  TEST_ASSERT_EQUAL(50, shortest);
+  TEST_ASSERT_TRUE(ticks >= StepGenerator::TickRate && ticks <= StepGenerator::TickRate + 2);
+
+  // A rate that doesn't divide the tick rate averages out exactly.
+  TEST_ASSERT_TRUE(generator.push(-3000, 3000));
+  runUntilIdle(generator, &steps, &longest, &shortest);
+  TEST_ASSERT_EQUAL(3000, steps);
+  TEST_ASSERT_EQUAL(-2000, generator.getPosition());
+  TEST_ASSERT_EQUAL(17, longest);
+  TEST_ASSERT_EQUAL(16, shortest);
+}
+
+void test_segments_follow_without_gap(void) {
+  StepGenerator generator;
+  TEST_ASSERT_TRUE(generator.push(100, 100000));  // Limited to MaxStepRate
+  TEST_ASSERT_TRUE(generator.push(100, StepGenerator::MaxStepRate));
+  TEST_ASSERT_TRUE(generator.push(100, StepGenerator::MaxStepRate / 2));
+  TEST_ASSERT_EQUAL(3, generator.getQueued());
+  uint32_t steps, longest, shortest;
+  const uint32_t ticks = runUntilIdle(generator, &steps, &longest, &shortest);
+  TEST_ASSERT_EQUAL(300, steps);
+  TEST_ASSERT_EQUAL(2, shortest);
+  TEST_ASSERT_EQUAL(4, longest);
+  TEST_ASSERT_TRUE(ticks <= 200 * 2 + 100 * 4 + 2);
+}
+
+void test_reverses_and_rejects_when_full(void) {
+  StepGenerator generator;
+  uint8_t previous = generator.tick();  // Idle
+  TEST_ASSERT_TRUE(generator.push(10, StepGenerator::MaxStepRate));
+  TEST_ASSERT_TRUE(generator.push(-10, StepGenerator::MaxStepRate));
+  while (generator.isBusy()) {
+    const uint8_t pins = generator.tick();
+    if ((pins ^ previous) & StepGenerator::DirectionPin) {
+      // The direction never changes with a step, and a step never follows it at once.
+      TEST_ASSERT_FALSE(pins & StepGenerator::StepPin);
+      TEST_ASSERT_FALSE(generator.tick() & StepGenerator::StepPin);
+    }
+    previous = pins;
+  }
+  TEST_ASSERT_EQUAL(0, generator.getPosition());
+
+  TEST_ASSERT_TRUE(generator.push(0, 1000));  // Nothing to do
+  TEST_ASSERT_EQUAL(0, generator.getQueued());
+  for (size_t i = 0; i < StepGenerator::QueueLength; i++) {
+    TEST_ASSERT_TRUE(generator.push(1, 1000));
+  }
+  TEST_ASSERT_FALSE(generator.push(1, 1000));
+  TEST_ASSERT_EQUAL(StepGenerator::QueueLength, generator.getQueued());
+}
+
+void process() {
+  UNITY_BEGIN();
+  RUN_TEST(test_steps_at_requested_rate);
+  RUN_TEST(test_segments_follow_without_gap);
+  RUN_TEST(test_reverses_and_rejects_when_full);
+  UNITY_END();
+}
+
+#ifdef ARDUINO
+
+#include <Arduino.h>
+void setup() {
+  delay(2000);
+  process();
+}
+
+void loop() {}
+
+#else
+
+int main(int argc, char **argv) {
+  process();
+  return 0;
+}
+
+#endif
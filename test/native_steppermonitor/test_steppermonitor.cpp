@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include <unity.h>
+#include <StepperMonitor.h>
+
+static const StepperMonitor::Limits limits = {10, 10000, 50, 60000, 50, 30000};
+
+static const uint32_t Warning = 0x00000101;  // otpw and t120
+static const uint32_t Cool    = 0x00100000;  // CS_ACTUAL 16
+
+void test_decodes_drv_status(void) {
+  StepperMonitor::Status status = StepperMonitor::decode(0x801F0F2D);
+  TEST_ASSERT_TRUE(status.overtemperatureWarning);
+  TEST_ASSERT_FALSE(status.overtemperature);
+  TEST_ASSERT_TRUE(status.shortToGround);
+  TEST_ASSERT_TRUE(status.shortToSupply);
+  TEST_ASSERT_FALSE(status.openLoad);
+  TEST_ASSERT_TRUE(status.standstill);
+  TEST_ASSERT_EQUAL(31, status.currentScale);
+  TEST_ASSERT_EQUAL(157, status.temperature);
+
+  status = StepperMonitor::decode(0x000800C2);
+  TEST_ASSERT_FALSE(status.overtemperatureWarning);
+  TEST_ASSERT_TRUE(status.overtemperature);
+  TEST_ASSERT_FALSE(status.shortToGround);
+  TEST_ASSERT_TRUE(status.openLoad);
+  TEST_ASSERT_FALSE(status.standstill);
+  TEST_ASSERT_EQUAL(8, status.currentScale);
+  TEST_ASSERT_EQUAL(0, status.temperature);
+}
+
+void test_cuts_current_while_hot_and_restores_when_cool(void) {
+  StepperMonitor monitor(limits);
+  uint32_t now = 0;
+  TEST_ASSERT_FALSE(monitor.update(Cool, true, now));
+  TEST_ASSERT_EQUAL(100, monitor.getRunCurrent());
+
+  // A step every 10 s while warm, down to 50 %.
+  for (now = 1000; now <= 100000; now += 1000) {
+    monitor.update(Warning, true, now);
+    if (now == 10000) {
+      TEST_ASSERT_EQUAL(90, monitor.getRunCurrent());
+      TEST_ASSERT_EQUAL(90, monitor.getHoldCurrent());
+    }
+  }
+  TEST_ASSERT_EQUAL(50, monitor.getRunCurrent());
+  TEST_ASSERT_EQUAL(5, monitor.getMetrics().thermalCuts);
+  TEST_ASSERT_EQUAL(100, monitor.getMetrics().warnings);
+
+  // Held for the cool down, then back a step every 10 s.
+  for (; now < 159000; now += 1000) {
+    monitor.update(Cool, true, now);
+  }
+  TEST_ASSERT_EQUAL(50, monitor.getRunCurrent());
+  for (; now <= 220000; now += 1000) {
+    monitor.update(Cool, true, now);
+  }
+  TEST_ASSERT_EQUAL(100, monitor.getRunCurrent());
+
+  // Warm again, the cool down starts over.
+  monitor.update(Warning, true, now);
+  TEST_ASSERT_EQUAL(90, monitor.getRunCurrent());
+  monitor.update(Cool, true, now + 50000);
+  TEST_ASSERT_EQUAL(90, monitor.getRunCurrent());
+}
+
+void test_cuts_hold_current_on_long_holds(void) {
+  StepperMonitor monitor(limits);
+  monitor.update(Cool, true, 0);
+  TEST_ASSERT_FALSE(monitor.update(Cool, false, 29000));
+  TEST_ASSERT_EQUAL(100, monitor.getHoldCurrent());
+  TEST_ASSERT_TRUE(monitor.update(Cool, false, 30000));
+  TEST_ASSERT_EQUAL(50, monitor.getHoldCurrent());
+  TEST_ASSERT_EQUAL(100, monitor.getRunCurrent());
+
+  // Back at once for a move, and counting faults.
+  TEST_ASSERT_TRUE(monitor.update(Cool | 0xC4, true, 31000));
+  TEST_ASSERT_EQUAL(100, monitor.getHoldCurrent());
+  monitor.update(Cool | 0xC2, false, 32000);  // Overtemperature shutdown is as good as a warning
+  TEST_ASSERT_EQUAL(90, monitor.getRunCurrent());
+  monitor.pollFailed();
+  const StepperMonitor::Metrics &metrics = monitor.getMetrics();
+  TEST_ASSERT_EQUAL(1, metrics.openLoads);
+  TEST_ASSERT_EQUAL(1, metrics.shorts);
+  TEST_ASSERT_EQUAL(1, metrics.overtemperatures);
+  TEST_ASSERT_EQUAL(5, metrics.polls);
+  TEST_ASSERT_EQUAL(1, metrics.failedPolls);
+  TEST_ASSERT_EQUAL(Cool | 0xC2, metrics.lastStatus);
+}
+
+void process() {
+  UNITY_BEGIN();
+  RUN_TEST(test_decodes_drv_status);
+  RUN_TEST(test_cuts_current_while_hot_and_restores_when_cool);
+  RUN_TEST(test_cuts_hold_current_on_long_holds);
+  UNITY_END();
+}
+
+#ifdef ARDUINO
+
+#include <Arduino.h>
+void setup() {
+  delay(2000);
+  process();
+}
+
+void loop() {}
+
+#else
+
+int main(int argc, char **argv) {
+  process();
+  return 0;
+}
+
+#endif
@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include <unity.h>
+#include <StepReconciler.h>
+
+// What MSCNT reads after the driver took steps from a count.
+static uint16_t counter(int32_t start, int32_t steps, int32_t countsPerStep) {
+  int32_t count = (start + steps * countsPerStep) % StepReconciler::CounterRange;
+  return count < 0 ? count + StepReconciler::CounterRange : count;
+}
+
+void test_finds_lost_steps(void) {
+  StepReconciler reconciler(1);  // 256 microsteps
+  TEST_ASSERT_EQUAL(0, reconciler.update(100, 0));
+  TEST_ASSERT_EQUAL(0, reconciler.update(counter(100, 30, 1), 30));  // Too short to tell the direction
+  TEST_ASSERT_EQUAL(0, reconciler.getMetrics().direction);
+  TEST_ASSERT_EQUAL(0, reconciler.update(counter(100, 2000, 1), 2000));
+  TEST_ASSERT_EQUAL(1, reconciler.getMetrics().direction);
+
+  // 3 of 500 steps lost on the way to 2500. The position is corrected to 2497.
+  TEST_ASSERT_EQUAL(-3, reconciler.update(counter(100, 2497, 1), 2500));
+  // Checked again before the correction is applied, and after.
+  TEST_ASSERT_EQUAL(0, reconciler.update(counter(100, 2497, 1), 2497));
+  TEST_ASSERT_EQUAL(0, reconciler.update(counter(100, 1000, 1), 1000));
+  // Extra steps the other way, and the counter wrapping many times in between.
+  TEST_ASSERT_EQUAL(5, reconciler.update(counter(100, -9995, 1), -10000));
+
+  const StepReconciler::Metrics &metrics = reconciler.getMetrics();
+  TEST_ASSERT_EQUAL(7, metrics.checks);
+  TEST_ASSERT_EQUAL(2, metrics.corrections);
+  TEST_ASSERT_EQUAL(5, metrics.lastDrift);
+  TEST_ASSERT_EQUAL(8, metrics.totalDrift);
+}
+
+void test_counter_running_backwards_with_coarse_microsteps(void) {
+  StepReconciler reconciler(16);  // 16 microsteps, the counter counting down as the position goes up
+  reconciler.update(1000, 0);
+  TEST_ASSERT_EQUAL(0, reconciler.update(counter(1000, -100, 16), 100));
+  TEST_ASSERT_EQUAL(-1, reconciler.getMetrics().direction);
+  TEST_ASSERT_EQUAL(2, reconciler.update(counter(1000, -302, 16), 300));
+  TEST_ASSERT_EQUAL(0, reconciler.update(counter(1000, -302, 16), 302));
+
+  // Starts over on a new microstep setting.
+  reconciler.setCountsPerStep(8);
+  TEST_ASSERT_EQUAL(0, reconciler.getMetrics().direction);
+  TEST_ASSERT_EQUAL(0, reconciler.getMetrics().checks);
+}
+
+// A move that starts between reading the position and MSCNT isn't drift.
+void test_skips_readings_taken_while_moving(void) {
+  StepReconciler reconciler(1);
+  reconciler.update(100, 0);
+  reconciler.update(counter(100, 2000, 1), 2000);
+  TEST_ASSERT_EQUAL(1, reconciler.getMetrics().direction);
+
+  // 40 steps of a new move were sent before MSCNT was read.
+  TEST_ASSERT_EQUAL(0, reconciler.update(counter(100, 2040, 1), 2000, 2040, true));
+  TEST_ASSERT_EQUAL(0, reconciler.update(counter(100, 2040, 1), 2000, 2000, true));
+  TEST_ASSERT_EQUAL(0, reconciler.update(counter(100, 2040, 1), 2000, 2040, false));
+  TEST_ASSERT_EQUAL(3, reconciler.getMetrics().skipped);
+  TEST_ASSERT_EQUAL(0, reconciler.getMetrics().corrections);
+
+  // The reference is untouched, so the next reading at rest still finds lost steps.
+  TEST_ASSERT_EQUAL(0, reconciler.update(counter(100, 2500, 1), 2500, 2500, false));
+  TEST_ASSERT_EQUAL(-2, reconciler.update(counter(100, 2998, 1), 3000, 3000, false));
+  TEST_ASSERT_EQUAL(4, reconciler.getMetrics().checks);
+}
+
+void process() {
+  UNITY_BEGIN();
+  RUN_TEST(test_finds_lost_steps);
+  RUN_TEST(test_counter_running_backwards_with_coarse_microsteps);
+  RUN_TEST(test_skips_readings_taken_while_moving);
+  UNITY_END();
+}
+
+#ifdef ARDUINO
+
+#include <Arduino.h>
+void setup() {
+  delay(2000);
+  process();
+}
+
+void loop() {}
+
+#else
+
+int main(int argc, char **argv) {
+  process();
+  return 0;
+}
+
+#endif